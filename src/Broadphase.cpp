@@ -0,0 +1,154 @@
+#include "Broadphase.h"
+
+#include "EntityStore.h"
+#include "Physics.h"
+#include "Utils.h"
+
+#include <algorithm>
+
+Broadphase::Broadphase() :
+    m_sorted(),
+    m_pairs(),
+    m_parents(),
+    m_islandOf(),
+    m_islandPairs(),
+    m_islandStarts(1, 0),
+    m_islandCursors(),
+    m_pairsTested(0),
+    m_totalPairsTested(0)
+{
+}
+
+void Broadphase::findPairs(EntityStore * store, std::vector<int> & slots, double margin)
+{
+    // the entity list is rebuilt every frame, but it's usually the same list.
+    // if it is, keep last frame's order as a head start. if it isn't, last
+    // frame's order is no help, and insertion sort on unsorted input is
+    // quadratic, so sort from scratch.
+    bool reseed = m_sorted.size() != slots.size();
+    if (reseed) {
+        m_sorted.resize(slots.size());
+        for (unsigned int i = 0; i < m_sorted.size(); i++)
+            m_sorted[i].index = i;
+    }
+    for (unsigned int i = 0; i < m_sorted.size(); i++) {
+        Bounds & bounds = m_sorted[i];
+        int slot = slots[bounds.index];
+        double extent = store->radius(slot) + margin;
+        double vx = store->velocityX(slot), vy = store->velocityY(slot);
+        double x = store->centerX(slot) + vx;
+        double y = store->centerY(slot) + vy;
+        bounds.left = x - extent;
+        bounds.right = x + extent;
+        bounds.top = y - extent;
+        bounds.bottom = y + extent;
+        if (vx * vx + vy * vy > Physics::sweepDistance * Physics::sweepDistance) {
+            bounds.left = Utils::min(bounds.left, bounds.left - vx);
+            bounds.right = Utils::max(bounds.right, bounds.right - vx);
+            bounds.top = Utils::min(bounds.top, bounds.top - vy);
+            bounds.bottom = Utils::max(bounds.bottom, bounds.bottom - vy);
+        }
+        bounds.layer = store->layer(slot);
+    }
+
+    if (reseed)
+        std::sort(m_sorted.begin(), m_sorted.end(), boundsLessThan);
+
+    // insertion sort. nearly sorted input makes this linear
+    for (unsigned int i = 1; i < m_sorted.size(); i++) {
+        Bounds bounds = m_sorted[i];
+        int j = i - 1;
+        while (j >= 0 && m_sorted[j].left > bounds.left) {
+            m_sorted[j + 1] = m_sorted[j];
+            j--;
+        }
+        m_sorted[j + 1] = bounds;
+    }
+
+    // sweep
+    m_pairs.clear();
+    m_pairsTested = 0;
+    for (unsigned int i = 0; i < m_sorted.size(); i++) {
+        Bounds & bounds1 = m_sorted[i];
+        for (unsigned int j = i + 1; j < m_sorted.size(); j++) {
+            Bounds & bounds2 = m_sorted[j];
+            if (bounds2.left > bounds1.right)
+                break; // nothing further along can overlap either
+            m_pairsTested++;
+            if (bounds1.layer != bounds2.layer)
+                continue;
+            if (bounds2.top > bounds1.bottom || bounds2.bottom < bounds1.top)
+                continue;
+            Pair pair;
+            pair.first = Utils::min(bounds1.index, bounds2.index);
+            pair.second = bounds1.index + bounds2.index - pair.first;
+            m_pairs.push_back(pair);
+        }
+    }
+    m_totalPairsTested += m_pairsTested;
+
+    // visit them in the same order as the naive loop
+    std::sort(m_pairs.begin(), m_pairs.end(), pairLessThan);
+}
+
+bool Broadphase::boundsLessThan(const Bounds & bounds1, const Bounds & bounds2)
+{
+    if (bounds1.left != bounds2.left)
+        return bounds1.left < bounds2.left;
+    return bounds1.index < bounds2.index;
+}
+
+bool Broadphase::pairLessThan(const Pair & pair1, const Pair & pair2)
+{
+    if (pair1.first != pair2.first)
+        return pair1.first < pair2.first;
+    return pair1.second < pair2.second;
+}
+
+void Broadphase::findIslands()
+{
+    int entityCount = m_sorted.size();
+    m_parents.resize(entityCount);
+    for (int i = 0; i < entityCount; i++)
+        m_parents[i] = i;
+    for (unsigned int i = 0; i < m_pairs.size(); i++) {
+        int root1 = findRoot(m_pairs[i].first), root2 = findRoot(m_pairs[i].second);
+        if (root1 != root2)
+            m_parents[Utils::max(root1, root2)] = Utils::min(root1, root2);
+    }
+
+    // number the islands that have pairs in them, and count their pairs
+    m_islandOf.assign(entityCount, -1);
+    m_islandStarts.clear();
+    for (unsigned int i = 0; i < m_pairs.size(); i++) {
+        int root = findRoot(m_pairs[i].first);
+        if (m_islandOf[root] == -1) {
+            m_islandOf[root] = m_islandStarts.size();
+            m_islandStarts.push_back(0);
+        }
+        m_islandStarts[m_islandOf[root]]++;
+    }
+    // counts -> starts
+    int total = 0;
+    for (unsigned int i = 0; i < m_islandStarts.size(); i++) {
+        int count = m_islandStarts[i];
+        m_islandStarts[i] = total;
+        total += count;
+    }
+    m_islandStarts.push_back(total);
+
+    // stable, so each island keeps the original order
+    m_islandPairs.resize(m_pairs.size());
+    m_islandCursors.assign(m_islandStarts.begin(), m_islandStarts.end() - 1);
+    for (unsigned int i = 0; i < m_pairs.size(); i++)
+        m_islandPairs[m_islandCursors[m_islandOf[findRoot(m_pairs[i].first)]]++] = i;
+}
+
+int Broadphase::findRoot(int index)
+{
+    while (m_parents[index] != index) {
+        m_parents[index] = m_parents[m_parents[index]];
+        index = m_parents[index];
+    }
+    return index;
+}
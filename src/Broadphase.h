@@ -0,0 +1,80 @@
+#ifndef _BROADPHASE_H_
+#define _BROADPHASE_H_
+
+#include <vector>
+
+class EntityStore;
+
+// Broadphase finds the pairs of entities that might be touching, so that
+// Entity::resolveCollision doesn't have to look at every pair.
+// It's a sweep and prune on the x axis over the bounding boxes of where the
+// entities intend to go. Fast ones get swept, so their boxes cover where they
+// are too. The sort order is kept between frames, so when things don't move
+// much, sorting is close to free.
+class Broadphase
+{
+public:
+    // indexes into the entity list. first < second
+    typedef struct {
+        int first, second;
+    } Pair;
+
+    Broadphase();
+
+    // find the pairs of entities on the same layer whose bounds, expanded by
+    // margin, overlap. slots are the entities' slots in the store, and the
+    // pairs are indexes into slots. pairs come out in the same order the
+    // naive double loop would visit them. that gives the same results as
+    // testing every pair only as long as pushes don't move anything further
+    // than margin. a push that goes further, like one passed along a long
+    // chain of entities, can move an entity into one it wasn't paired with,
+    // and that overlap waits until next frame.
+    void findPairs(EntityStore * store, std::vector<int> & slots, double margin);
+    std::vector<Pair> * pairs() { return &m_pairs; }
+
+    // how many pairs were tested for overlap during the last findPairs
+    int pairsTested() { return m_pairsTested; }
+    // how many pairs passed the test during the last findPairs
+    int candidateCount() { return m_pairs.size(); }
+    // running total of pairsTested
+    long long totalPairsTested() { return m_totalPairsTested; }
+
+    // group the last pairs into islands: sets of entities that touch each
+    // other, directly or through others. pairs in different islands never
+    // share an entity, so islands can be resolved independently.
+    void findIslands();
+    int islandCount() { return m_islandStarts.size() - 1; }
+    // pair indexes, island by island. within an island they keep their order
+    std::vector<int> * islandPairs() { return &m_islandPairs; }
+    // where each island starts in islandPairs, plus one past the end
+    std::vector<int> * islandStarts() { return &m_islandStarts; }
+    // the same entity index for everything in the island the entity is in.
+    // an entity without pairs is an island by itself
+    int islandRoot(int index) { return findRoot(index); }
+
+private: //variables
+    typedef struct {
+        double left, right;
+        double top, bottom;
+        int layer;
+        int index;
+    } Bounds;
+
+    static bool boundsLessThan(const Bounds & bounds1, const Bounds & bounds2);
+    static bool pairLessThan(const Pair & pair1, const Pair & pair2);
+    // union find over entity indexes
+    int findRoot(int index);
+
+    // sorted by left edge
+    std::vector<Bounds> m_sorted;
+    std::vector<Pair> m_pairs;
+    std::vector<int> m_parents;
+    std::vector<int> m_islandOf;
+    std::vector<int> m_islandPairs;
+    std::vector<int> m_islandStarts;
+    std::vector<int> m_islandCursors;
+    int m_pairsTested;
+    long long m_totalPairsTested;
+};
+
+#endif
@@ -46,6 +46,51 @@ bool Config::fullscreen()
     return ! Utils::stringToBool(m_configManager->value("windowed", Utils::boolToString(false)));
 }
 
+bool Config::verticalSync()
+{
+    return Utils::stringToBool(m_configManager->value("display.vsync", Utils::boolToString(true)));
+}
+
+int Config::maxDisplayFps()
+{
+    return Utils::stringToInt(m_configManager->value("display.max_fps", Utils::intToString(0)));
+}
+
+bool Config::renderThread()
+{
+    return Utils::stringToBool(m_configManager->value("display.render_thread", Utils::boolToString(true)));
+}
+
+int Config::streamRadius()
+{
+    return Utils::stringToInt(m_configManager->value("stream.radius", Utils::intToString(2000)));
+}
+
+int Config::simulationThreads()
+{
+    return Utils::stringToInt(m_configManager->value("simulation.threads", Utils::intToString(-1)));
+}
+
+bool Config::sleepEntities()
+{
+    return Utils::stringToBool(m_configManager->value("simulation.sleep", Utils::boolToString(true)));
+}
+
+std::string Config::recordFile()
+{
+    return m_configManager->value("record");
+}
+
+std::string Config::replayFile()
+{
+    return m_configManager->value("replay");
+}
+
+std::string Config::profileOutFile()
+{
+    return m_configManager->value("profile-out");
+}
+
 Input::KeyCode Config::keyNorth()
 {
     return (Input::KeyCode) Utils::stringToInt(
@@ -21,6 +21,26 @@ public:
 
     // settings. priority: 1. command line argument 2. config file 3. default
     bool fullscreen();
+    bool verticalSync();
+    // most frames drawn per second. 0 for no limit besides vertical sync
+    int maxDisplayFps();
+    // draw on a separate thread, when there's more than one processor
+    bool renderThread();
+    // maps within this many pixels of the player are kept in memory
+    int streamRadius();
+    // how many threads help with the simulation besides the main one.
+    // -1 uses every processor
+    int simulationThreads();
+    // stop simulating entities that have sat still for a while, until
+    // something touches them
+    bool sleepEntities();
+    // save the input to this file, or play it back from this file.
+    // empty for neither
+    std::string recordFile();
+    std::string replayFile();
+    // write a Chrome trace of the profiler's zones to this file on the way
+    // out. empty for none
+    std::string profileOutFile();
 
     // keys
     Input::KeyCode keyNorth();
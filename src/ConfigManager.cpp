@@ -82,7 +82,7 @@ bool ConfigManager::addArgs(int argc, char * argv[])
             } else {
                 std::string param = arg.substr(2, pos - 2);
                 std::string value = arg.substr(pos + 1, arg.size() - (pos+1));
-                m_map[param] = "true";
+                m_map[param] = value;
             }
         } else if( arg.size() == 2) {
             // short parameter
@@ -0,0 +1,167 @@
+#include "DrawQueue.h"
+
+#include "Entity.h"
+#include "Map.h"
+#include "RenderCommandBuffer.h"
+
+#include <algorithm>
+
+DrawQueue::DrawQueue() :
+    m_layers(),
+    m_listedEntity(),
+    m_listedLayer(),
+    m_seenStamp(),
+    m_stamp(0),
+    m_added(),
+    m_merged(),
+    m_cursors()
+{
+}
+
+void DrawQueue::update(std::vector<Entity *> & entities)
+{
+    m_stamp++;
+
+    // find the entities that are new or changed layers
+    m_added.clear();
+    for (unsigned int i = 0; i < entities.size(); i++) {
+        Entity * entity = entities[i];
+        EntityStore::Handle handle = entity->handle();
+        int layer = entity->layer();
+        if (handle >= (int)m_seenStamp.size()) {
+            m_listedEntity.resize(handle + 1, NULL);
+            m_listedLayer.resize(handle + 1, -1);
+            m_seenStamp.resize(handle + 1, 0);
+        }
+        m_seenStamp[handle] = m_stamp;
+        if (m_listedEntity[handle] == entity && m_listedLayer[handle] == layer)
+            continue;
+        m_listedEntity[handle] = entity;
+        m_listedLayer[handle] = layer;
+        if (layer >= (int)m_layers.size())
+            m_layers.resize(layer + 1);
+        Item item;
+        item.entity = entity;
+        item.handle = handle;
+        m_added.push_back(item);
+    }
+
+    for (unsigned int layer = 0; layer < m_layers.size(); layer++) {
+        std::vector<Item> & items = m_layers[layer];
+
+        // drop what's gone or moved, keeping the order of the rest
+        unsigned int kept = 0;
+        for (unsigned int i = 0; i < items.size(); i++) {
+            Item item = items[i];
+            if (m_seenStamp[item.handle] != m_stamp) {
+                // deleted, or just not around this frame. either way
+                // nobody is using the handle right now
+                m_listedEntity[item.handle] = NULL;
+                m_listedLayer[item.handle] = -1;
+                continue;
+            }
+            if (m_listedEntity[item.handle] != item.entity || m_listedLayer[item.handle] != (int)layer)
+                continue;
+            item.depth = item.entity->centerY();
+            items[kept++] = item;
+        }
+        items.resize(kept);
+
+        for (unsigned int i = 0; i < m_added.size(); i++) {
+            Item item = m_added[i];
+            if (m_listedLayer[item.handle] != (int)layer)
+                continue;
+            item.depth = item.entity->centerY();
+            items.push_back(item);
+        }
+
+        sortLayer(items, kept);
+    }
+}
+
+void DrawQueue::sortLayer(std::vector<Item> & items, int firstAdded)
+{
+    // insertion sort the ones that were here last frame. they're nearly
+    // sorted already, so this is close to linear
+    for (int i = 1; i < firstAdded; i++) {
+        Item item = items[i];
+        int j = i - 1;
+        while (j >= 0 && itemLessThan(item, items[j])) {
+            items[j + 1] = items[j];
+            j--;
+        }
+        items[j + 1] = item;
+    }
+
+    // the new ones are in no particular order. sort them and merge them in
+    if (firstAdded == (int)items.size())
+        return;
+    std::sort(items.begin() + firstAdded, items.end(), itemLessThan);
+    if (firstAdded == 0)
+        return;
+    m_merged.resize(items.size());
+    std::merge(items.begin(), items.begin() + firstAdded, items.begin() + firstAdded, items.end(),
+               m_merged.begin(), itemLessThan);
+    items.swap(m_merged);
+}
+
+bool DrawQueue::itemLessThan(const Item & item1, const Item & item2)
+{
+    // break ties by handle so the order doesn't depend on how we got here
+    if (item1.depth != item2.depth)
+        return item1.depth < item2.depth;
+    return item1.handle < item2.handle;
+}
+
+void DrawQueue::draw(RenderCommandBuffer * commands, int layer, std::vector<Map *> & maps,
+                     double screenX, double screenY, double screenWidth, double screenHeight)
+{
+    m_cursors.clear();
+    for (unsigned int i = 0; i < maps.size(); i++) {
+        Map * map = maps[i];
+        if (layer >= map->layerCount())
+            continue;
+        TileCursor cursor;
+        cursor.map = map;
+        map->tallTileRange(screenY, screenHeight, layer, cursor.next, cursor.end);
+        if (cursor.next < cursor.end)
+            m_cursors.push_back(cursor);
+    }
+
+    commands->beginSorted();
+    std::vector<Item> * items = layer < (int)m_layers.size() ? &m_layers[layer] : NULL;
+    unsigned int itemIndex = 0;
+    while (true) {
+        // each map's tiles are already sorted, and so are the entities.
+        // draw whichever is highest up
+        int best = -1;
+        double bestDepth = 0.0;
+        for (unsigned int i = 0; i < m_cursors.size(); i++) {
+            TileCursor & cursor = m_cursors[i];
+            if (cursor.next >= cursor.end)
+                continue;
+            double depth = cursor.map->top() + (*cursor.map->tallTiles(layer))[cursor.next].depth;
+            if (best == -1 || depth < bestDepth) {
+                best = i;
+                bestDepth = depth;
+            }
+        }
+
+        if (items != NULL && itemIndex < items->size() && (best == -1 || (*items)[itemIndex].depth < bestDepth)) {
+            (*items)[itemIndex].entity->draw(commands);
+            itemIndex++;
+            continue;
+        }
+        if (best == -1)
+            break;
+
+        TileCursor & cursor = m_cursors[best];
+        Map::TallTile & tallTile = (*cursor.map->tallTiles(layer))[cursor.next];
+        cursor.next++;
+        double x = cursor.map->left() + tallTile.x;
+        double y = cursor.map->top() + tallTile.y;
+        if (x + tallTile.tile->graphicWidth() < screenX || x > screenX + screenWidth)
+            continue;
+        tallTile.tile->draw(commands, x, y);
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef _DRAW_QUEUE_H_
+#define _DRAW_QUEUE_H_
+
+#include "EntityStore.h"
+
+#include <vector>
+
+class Entity;
+class Map;
+class RenderCommandBuffer;
+
+// DrawQueue keeps the entities on each layer sorted by how far down the
+// screen they are, so that the ones in front get drawn last. The lists stay
+// around between frames and only change when an entity shows up, goes away,
+// or changes layers. Since things don't move far in one frame, last frame's
+// order is nearly right and re-sorting it is close to linear.
+// Tall tiles (see Tile::isTall) are drawn in the same order as the entities.
+class DrawQueue
+{
+public:
+    DrawQueue();
+
+    // bring the lists up to date with the entities that exist this frame
+    void update(std::vector<Entity *> & entities);
+
+    // one more than the highest layer an entity is on
+    int layerCount() { return m_layers.size(); }
+
+    // record the entities on a layer, along with the tall tiles of maps, in
+    // the order they have to be drawn
+    void draw(RenderCommandBuffer * commands, int layer, std::vector<Map *> & maps,
+              double screenX, double screenY, double screenWidth, double screenHeight);
+
+private: //variables
+    typedef struct {
+        // centerY. the sort key
+        double depth;
+        Entity * entity;
+        EntityStore::Handle handle;
+    } Item;
+
+    typedef struct {
+        Map * map;
+        int next, end;
+    } TileCursor;
+
+    static bool itemLessThan(const Item & item1, const Item & item2);
+
+    std::vector<std::vector<Item> > m_layers;
+
+    // indexed by handle. where the entity is listed, and the last update
+    // that saw it. entities are deleted without telling us, so an item only
+    // counts if all of these still agree with it.
+    std::vector<Entity *> m_listedEntity;
+    std::vector<int> m_listedLayer;
+    std::vector<unsigned int> m_seenStamp;
+    unsigned int m_stamp;
+
+    // scratch space
+    std::vector<Item> m_added;
+    std::vector<Item> m_merged;
+    std::vector<TileCursor> m_cursors;
+
+private: //methods
+    // re-sort one layer, with the new items merged in
+    void sortLayer(std::vector<Item> & items, int firstAdded);
+};
+
+#endif
@@ -1,28 +1,29 @@
 #include "Entity.h"
 
 #include "ResourceManager.h"
-#include "Gameplay.h"
-#include "Physics.h"
+#include "RenderCommandBuffer.h"
 
 #include "Utils.h"
 
-#include <cmath>
-
 Entity::Entity():
-    m_shape(Shapeless),
-    m_centerX(0.0), m_centerY(0.0), m_radius(0),
-    m_velocityX(0.0), m_velocityY(0.0),
-    m_layer(0),
+    m_handle(store()->add(this)),
     m_altitude(0.0), m_altitudeVelocity(0.0),
-    m_speed(0), m_mass(1),
-    m_direction(Center), m_movementMode(Stand),
+    m_previousAltitude(0.0),
+    m_direction(Center),
     m_centerOffsetX(0), m_centerOffsetY(0),
-    m_currentSequence(None), m_sequencePosition(0)
+    m_currentSequence(None), m_sequencePosition(0),
+    m_hasGoal(false), m_goalX(0.0), m_goalY(0.0)
 {
     memset(m_standing, 0, sizeof(m_standing));
     memset(m_walking, 0, sizeof(m_walking));
     memset(m_running, 0, sizeof(m_running));
-    memset(m_sword, 0, sizeof(m_running));
+    memset(m_sword, 0, sizeof(m_sword));
+
+    int s = slot();
+    store()->shape(s) = Shapeless;
+    store()->mass(s) = 1;
+    store()->movementMode(s) = Stand;
+    store()->updateIndex(s);
 }
 
 Entity * Entity::load(const char *buffer) {
@@ -72,24 +73,55 @@ Entity * Entity::load(const char *buffer) {
 }
 
 Entity::Entity(Shape shape, double radius, double centerOffsetX, double centerOffsetY, double speed, double mass) :
-    m_shape(shape),
-    m_centerX(0.0), m_centerY(0.0), m_radius(radius),
-    m_velocityX(0.0), m_velocityY(0.0),
-    m_layer(0),
+    m_handle(store()->add(this)),
     m_altitude(0.0), m_altitudeVelocity(0.0),
-    m_speed(speed), m_mass(mass),
-    m_direction(Center), m_movementMode(Stand),
+    m_previousAltitude(0.0),
+    m_direction(Center),
     m_centerOffsetX(centerOffsetX), m_centerOffsetY(centerOffsetY),
-    m_currentSequence(None), m_sequencePosition(0)
+    m_currentSequence(None), m_sequencePosition(0),
+    m_hasGoal(false), m_goalX(0.0), m_goalY(0.0)
 {
     memset(m_standing, 0, sizeof(m_standing));
     memset(m_walking, 0, sizeof(m_walking));
     memset(m_running, 0, sizeof(m_running));
-    memset(m_sword, 0, sizeof(m_running));
+    memset(m_sword, 0, sizeof(m_sword));
+
+    int s = slot();
+    store()->shape(s) = shape;
+    store()->radius(s) = radius;
+    store()->speed(s) = speed;
+    store()->mass(s) = mass;
+    store()->movementMode(s) = Stand;
+}
+
+Entity::~Entity()
+{
+    Graphic** movementGraphics[] = { m_standing, m_walking, m_running, m_sword };
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 9; j++) {
+            if (movementGraphics[i][j] != NULL)
+                ResourceManager::releaseGraphic(movementGraphics[i][j]);
+        }
+    }
+    store()->remove(m_handle);
+}
+
+void Entity::setCenter(double x, double y) {
+    int s = slot();
+    store()->wake(s);
+    store()->centerX(s) = x;
+    store()->centerY(s) = y;
+    store()->previousX(s) = x;
+    store()->previousY(s) = y;
+    store()->updateIndex(s);
 }
 
 Tile::PhysicalPresence Entity::minPhysicalPresence() {
-    switch (m_movementMode) {
+    return minPhysicalPresence(movementMode());
+}
+
+Tile::PhysicalPresence Entity::minPhysicalPresence(MovementMode movementMode) {
+    switch (movementMode) {
     case Stand:
     case Walk:
     case Run:
@@ -103,70 +135,12 @@ Tile::PhysicalPresence Entity::minPhysicalPresence() {
 }
 
 void Entity::resolveCollision(Entity * other) {
-    Entity * entity1 = NULL, * entity2 = NULL;
-    double dx = 0.0, dy = 0.0;
-    switch (this->m_shape) {
-    case Shapeless:
-        return;
-    case Circle:
-        switch (other->m_shape) {
-        case Shapeless:
-            return;
-        case Circle:
-            entity1 = this;
-            entity2 = other;
-            Physics::circleAndCircle(entity1->intendedCenterX(), entity1->intendedCenterY(), entity1->radius(), entity2->intendedCenterX(), entity2->intendedCenterY(), entity2->radius(), dx, dy);
-            break;
-        case Square:
-            entity1 = other;
-            entity2 = this;
-            Physics::squareAndCircle(entity1->intendedCenterX(), entity1->intendedCenterY(), entity1->radius(), entity2->intendedCenterX(), entity2->intendedCenterY(), entity2->radius(), dx, dy);
-            break;
-        default:
-            assert(false);
-            break;
-        }
-        break;
-    case Square:
-        switch (other->m_shape) {
-        case Shapeless:
-            return;
-        case Circle:
-            entity1 = this;
-            entity2 = other;
-            Physics::squareAndCircle(entity1->intendedCenterX(), entity1->intendedCenterY(), entity1->radius(), entity2->intendedCenterX(), entity2->intendedCenterY(), entity2->radius(), dx, dy);
-            break;
-        case Square:
-            entity1 = this;
-            entity2 = other;
-            Physics::squareAndSquare(entity1->intendedCenterX(), entity1->intendedCenterY(), entity1->radius(), entity2->intendedCenterX(), entity2->intendedCenterY(), entity2->radius(), dx, dy);
-            break;
-        default:
-            assert(false);
-            break;
-        }
-        break;
-    default:
-        assert(false);
-        break;
-    }
-
-    if (Utils::isZero(dx) && Utils::isZero(dy))
-        return;
-
-    // resolve momentum collision
-    double distance = std::sqrt(dx * dx + dy * dy);
-    double normalX = dx / distance, normalY = dy / distance;
-    double mass1 = entity1->mass(), mass2 = entity2->mass();
-    double totalMass = mass1 + mass2;
-    double push1 = -distance * mass2 / totalMass, push2 = distance * mass1 / totalMass;
-    entity1->setVelocity(entity1->velocityX() + push1 * normalX, entity1->velocityY() + push1 * normalY);
-    entity2->setVelocity(entity2->velocityX() + push2 * normalX, entity2->velocityY() + push2 * normalY);
+    store()->resolveCollision(slot(), other->slot());
 }
 
-void Entity::draw(double screenX, double screenY) {
+void Entity::draw(RenderCommandBuffer * commands) {
     Graphic** graphicList;
-    switch (m_movementMode) {
+    switch (movementMode()) {
     case Stand: graphicList = m_standing; break;
     case Walk: graphicList = m_walking; break;
     case Run: graphicList = m_running; break;
@@ -181,8 +155,11 @@ void Entity::draw(double screenX, double screenY) {
     default: assert(false);
     }
 
-    graphicList[m_direction]->draw(Gameplay::instance()->screen(),
-                                   (int)(m_centerX - m_centerOffsetX - screenX),
-                                   (int)(m_centerY - m_centerOffsetY - m_altitude - screenY));
+    int s = slot();
+    commands->add(graphicList[m_direction],
+                  store()->previousX(s) - m_centerOffsetX,
+                  store()->previousY(s) - m_centerOffsetY - m_previousAltitude,
+                  store()->centerX(s) - m_centerOffsetX,
+                  store()->centerY(s) - m_centerOffsetY - m_altitude);
 }
 
@@ -3,11 +3,15 @@
 
 #include "Tile.h"
 #include "Graphic.h"
+#include "EntityStore.h"
+
+class RenderCommandBuffer;
 
 // entities are responsible for:
 //  * specs (health, speed, defense, etc.)
 //  * animations for moving
 //  * where they are in the world
+// the state the simulation touches every frame lives in the EntityStore.
 class Entity
 {
 public:
@@ -37,40 +41,48 @@ public:
         None,
         Sword,
     };
+    enum Shape {
+        Shapeless = 0,
+        Circle = 1,
+        Square = 2,
+    };
 
     static Entity * load(const char * buffer);
+    ~Entity();
 
     // world location of the player's contact zone
-    double centerX() { return m_centerX; }
-    double centerY() { return m_centerY; }
-    void setCenter(double x, double y) { m_centerX = x; m_centerY = y; }
+    double centerX() { return store()->centerX(slot()); }
+    double centerY() { return store()->centerY(slot()); }
+    // moves it without drawing it sliding there. wakes it up
+    void setCenter(double x, double y);
     // radius of the hitbox (actually a circle)
-    double radius() { return m_radius; }
+    double radius() { return store()->radius(slot()); }
 
-    double velocityX() { return m_velocityX; }
-    double velocityY() { return m_velocityY; }
-    void setVelocity(double x, double y) { m_velocityX = x; m_velocityY = y; }
-    double intendedCenterX() { return m_centerX + m_velocityX; }
-    double intendedCenterY() { return m_centerY + m_velocityY; }
+    double velocityX() { return store()->velocityX(slot()); }
+    double velocityY() { return store()->velocityY(slot()); }
+    // wakes it up
+    void setVelocity(double x, double y) { int s = slot(); store()->wake(s); store()->velocityX(s) = x; store()->velocityY(s) = y; }
+    double intendedCenterX() { int s = slot(); return store()->centerX(s) + store()->velocityX(s); }
+    double intendedCenterY() { int s = slot(); return store()->centerY(s) + store()->velocityY(s); }
 
-    int layer() { return m_layer; }
-    void setLayer(int layer) { m_layer = layer; }
+    int layer() { return store()->layer(slot()); }
+    void setLayer(int layer) { int s = slot(); store()->wake(s); store()->layer(s) = layer; store()->updateIndex(s); }
 
     // altitude is for jumping and is equivalent to negative y
     double altitude() { return m_altitude; }
-    void setAltitude(double value) { m_altitude = value; }
+    void setAltitude(double value) { m_altitude = value; m_previousAltitude = value; }
     double altitudeVelocity() { return m_altitudeVelocity; }
     void setAltitudeVelocity(double value) { m_altitudeVelocity = value; }
-    void applyAltitudeVelocity() { m_altitude += m_altitudeVelocity; }
+    void applyAltitudeVelocity() { m_previousAltitude = m_altitude; m_altitude += m_altitudeVelocity; }
 
-    double speed() { return m_speed; }
-    double mass() { return m_mass; }
+    double speed() { return store()->speed(slot()); }
+    double mass() { return store()->mass(slot()); }
 
     Direction orientation() { return m_direction; }
     void setOrientation(Direction direction) { m_direction = direction; }
 
-    MovementMode movementMode() { return m_movementMode; }
-    void setMovementMode(MovementMode movementMode) { m_movementMode = movementMode; }
+    MovementMode movementMode() { return (MovementMode)store()->movementMode(slot()); }
+    void setMovementMode(MovementMode movementMode) { store()->movementMode(slot()) = movementMode; }
 
     Sequence currentSequence() { return m_currentSequence; }
     void setCurrentSequence(Sequence value) { m_currentSequence = value; }
@@ -78,29 +90,36 @@ public:
     // returns the next position
     int incrementSequencePosition() { return ++m_sequencePosition; }
 
+    // where it's heading on its own, for entities that don't take input.
+    // they steer there along a flow field
+    bool hasGoal() { return m_hasGoal; }
+    double goalX() { return m_goalX; }
+    double goalY() { return m_goalY; }
+    void setGoal(double x, double y) { m_hasGoal = true; m_goalX = x; m_goalY = y; wake(); }
+    void clearGoal() { m_hasGoal = false; }
+
+    // entities that have sat still for a while stop being simulated until
+    // something touches them or wakes them. see EntityStore::asleep
+    bool isAsleep() { return store()->asleep(slot()); }
+    void wake() { store()->wake(slot()); }
+
     Tile::PhysicalPresence minPhysicalPresence();
+    static Tile::PhysicalPresence minPhysicalPresence(MovementMode movementMode);
     void resolveCollision(Entity * other);
-    void draw(double screenX, double screenY);
+    // record it, moving from where it was last logic frame to
+    // where it is now
+    void draw(RenderCommandBuffer * commands);
 
-private:
-    enum Shape {
-        Shapeless = 0,
-        Circle = 1,
-        Square = 2,
-    };
+    EntityStore::Handle handle() { return m_handle; }
+    // where this entity is in the store's arrays right now
+    int slot() { return store()->slot(m_handle); }
 
-    Shape m_shape;
-    double m_centerX, m_centerY;
-    double m_radius;
-    double m_velocityX, m_velocityY;
-    int m_layer;
+private:
+    EntityStore::Handle m_handle;
     double m_altitude, m_altitudeVelocity;
-
-    double m_speed;
-    double m_mass;
+    double m_previousAltitude;
 
     Direction m_direction;
-    MovementMode m_movementMode;
 
     // hit box (actually a circle)
     double m_centerOffsetX, m_centerOffsetY;
@@ -109,6 +128,9 @@ private:
     Sequence m_currentSequence;
     int m_sequencePosition;
 
+    bool m_hasGoal;
+    double m_goalX, m_goalY;
+
     // animations for various visible activities indexed by direction
     Graphic * m_standing[9];
     Graphic * m_walking[9];
@@ -117,6 +139,11 @@ private:
 
     Entity(Shape shape, double radius, double centerOffsetX, double centerOffsetY, double speed, double mass);
     Entity();
+    // entities own a slot in the store, so they can't be copied
+    Entity(const Entity &);
+    Entity & operator=(const Entity &);
+
+    static EntityStore * store() { return EntityStore::instance(); }
 };
 
 #endif
@@ -0,0 +1,341 @@
+#include "EntityIndex.h"
+
+#include "Utils.h"
+#include "Debug.h"
+
+#include <cmath>
+
+// a few tiles. most entities are a lot smaller than this, so the grid is
+// barely loose at all
+const double EntityIndex::c_cellSize = 64.0;
+const int EntityIndex::c_initialCells = 1024;
+
+EntityIndex::EntityIndex() :
+    m_cells(),
+    m_usedCells(0),
+    m_minCellX(0), m_minCellY(0), m_maxCellX(-1), m_maxCellY(-1),
+    m_maxRadius(0.0),
+    m_count(0),
+    m_x(), m_y(), m_radius(),
+    m_cellOf(),
+    m_next(), m_previous(),
+    m_queryCells(),
+    m_nearestDistances()
+{
+    rehash(c_initialCells);
+}
+
+void EntityIndex::insert(Handle handle, double x, double y, double radius, int layer)
+{
+    if (handle >= (int)m_cellOf.size()) {
+        int size = handle + 1;
+        m_x.resize(size, 0.0);
+        m_y.resize(size, 0.0);
+        m_radius.resize(size, 0.0);
+        m_cellOf.resize(size, -1);
+        m_next.resize(size, -1);
+        m_previous.resize(size, -1);
+    }
+    assert(m_cellOf[handle] == -1);
+
+    m_x[handle] = x;
+    m_y[handle] = y;
+    m_radius[handle] = radius;
+    m_maxRadius = Utils::max(m_maxRadius, radius);
+    link(handle, findOrAddCell(layer, cellCoordinate(x), cellCoordinate(y)));
+    m_count++;
+}
+
+void EntityIndex::remove(Handle handle)
+{
+    assert(m_cellOf[handle] != -1);
+    unlink(handle);
+    m_count--;
+}
+
+void EntityIndex::move(Handle handle, double x, double y, double radius, int layer)
+{
+    m_x[handle] = x;
+    m_y[handle] = y;
+    m_radius[handle] = radius;
+    m_maxRadius = Utils::max(m_maxRadius, radius);
+
+    int cellX = cellCoordinate(x), cellY = cellCoordinate(y);
+    Cell & cell = m_cells[m_cellOf[handle]];
+    if (cell.x == cellX && cell.y == cellY && cell.layer == layer)
+        return;
+    unlink(handle);
+    link(handle, findOrAddCell(layer, cellX, cellY));
+}
+
+void EntityIndex::inRadius(std::vector<Handle> & results, double x, double y, double radius, int layer)
+{
+    findCells(x - radius, y - radius, x + radius, y + radius, layer);
+    for (unsigned int i = 0; i < m_queryCells.size(); i++) {
+        for (Handle handle = m_cells[m_queryCells[i]].first; handle != -1; handle = m_next[handle]) {
+            double reach = radius + m_radius[handle];
+            if (Utils::distance2(x, y, m_x[handle], m_y[handle]) < reach * reach)
+                results.push_back(handle);
+        }
+    }
+}
+
+void EntityIndex::inRectangle(std::vector<Handle> & results, double left, double top,
+                              double width, double height, int layer)
+{
+    double right = left + width, bottom = top + height;
+    findCells(left, top, right, bottom, layer);
+    for (unsigned int i = 0; i < m_queryCells.size(); i++) {
+        for (Handle handle = m_cells[m_queryCells[i]].first; handle != -1; handle = m_next[handle]) {
+            double radius = m_radius[handle];
+            if (m_x[handle] - radius < right && m_x[handle] + radius > left &&
+                m_y[handle] - radius < bottom && m_y[handle] + radius > top)
+            {
+                results.push_back(handle);
+            }
+        }
+    }
+}
+
+void EntityIndex::nearest(std::vector<Handle> & results, double x, double y, int count, int layer)
+{
+    int first = results.size();
+    m_nearestDistances.clear();
+    if (count <= 0 || m_count == 0)
+        return;
+
+    // look at rings of cells further and further out, until what's left
+    // can't be any closer than what's been found
+    int centerX = cellCoordinate(x), centerY = cellCoordinate(y);
+    int lastRing = Utils::max(Utils::max(centerX - m_minCellX, m_maxCellX - centerX),
+                              Utils::max(centerY - m_minCellY, m_maxCellY - centerY));
+    for (int ring = 0; ring <= lastRing; ring++) {
+        // once the rings cover more cells than the table has, it's quicker
+        // to go through the table
+        int side = ring * 2 + 1;
+        if ((double)side * side > m_cells.size()) {
+            results.resize(first);
+            m_nearestDistances.clear();
+            for (unsigned int i = 0; i < m_cells.size(); i++) {
+                if (m_cells[i].layer != layer || m_cells[i].count <= 0)
+                    continue;
+                for (Handle handle = m_cells[i].first; handle != -1; handle = m_next[handle])
+                    addNearest(results, first, count, handle, Utils::distance2(x, y, m_x[handle], m_y[handle]));
+            }
+            return;
+        }
+
+        for (int cellY = centerY - ring; cellY <= centerY + ring; cellY++) {
+            // the top and bottom rows of the ring, and the ends of the rows
+            // in between
+            bool wholeRow = cellY == centerY - ring || cellY == centerY + ring;
+            int step = wholeRow ? 1 : Utils::max(ring * 2, 1);
+            for (int cellX = centerX - ring; cellX <= centerX + ring; cellX += step) {
+                int cell = findCell(layer, cellX, cellY);
+                if (cell == -1)
+                    continue;
+                for (Handle handle = m_cells[cell].first; handle != -1; handle = m_next[handle])
+                    addNearest(results, first, count, handle, Utils::distance2(x, y, m_x[handle], m_y[handle]));
+            }
+        }
+
+        // everything closer than this is in the rings done so far. something
+        // further out could still be exactly this far and win a tie by
+        // handle, so only stop when the last one found is strictly closer
+        double reach = Utils::min(Utils::min(x - (centerX - ring) * c_cellSize, (centerX + ring + 1) * c_cellSize - x),
+                                  Utils::min(y - (centerY - ring) * c_cellSize, (centerY + ring + 1) * c_cellSize - y));
+        if ((int)m_nearestDistances.size() == count && m_nearestDistances.back() < reach * reach)
+            return;
+    }
+}
+
+int EntityIndex::cellCoordinate(double value)
+{
+    return (int)std::floor(value / c_cellSize);
+}
+
+unsigned int EntityIndex::hash(int layer, int x, int y)
+{
+    unsigned int hash = (unsigned int)x * 73856093u ^ (unsigned int)y * 19349663u ^ (unsigned int)layer * 83492791u;
+    // the low bits pick the spot, so mix the high ones down
+    hash ^= hash >> 16;
+    hash *= 0x45d9f3bu;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+int EntityIndex::findCell(int layer, int x, int y)
+{
+    unsigned int mask = m_cells.size() - 1;
+    for (unsigned int i = hash(layer, x, y) & mask; ; i = (i + 1) & mask) {
+        Cell & cell = m_cells[i];
+        if (cell.count == -1)
+            return -1;
+        if (cell.x == x && cell.y == y && cell.layer == layer)
+            return i;
+    }
+}
+
+int EntityIndex::findOrAddCell(int layer, int x, int y)
+{
+    int found = findCell(layer, x, y);
+    if (found != -1)
+        return found;
+
+    // keep the table at most half full. if it's mostly empty cells, the
+    // same size will do once they're gone
+    if ((m_usedCells + 1) * 2 > (int)m_cells.size()) {
+        int filled = 0;
+        for (unsigned int i = 0; i < m_cells.size(); i++) {
+            if (m_cells[i].count > 0)
+                filled++;
+        }
+        rehash(filled * 4 > (int)m_cells.size() ? m_cells.size() * 2 : m_cells.size());
+    }
+
+    unsigned int mask = m_cells.size() - 1;
+    unsigned int i = hash(layer, x, y) & mask;
+    while (m_cells[i].count != -1)
+        i = (i + 1) & mask;
+    Cell & cell = m_cells[i];
+    cell.layer = layer;
+    cell.x = x;
+    cell.y = y;
+    cell.first = -1;
+    cell.count = 0;
+    m_usedCells++;
+    addToBounds(x, y);
+    return i;
+}
+
+void EntityIndex::rehash(int size)
+{
+    Cell unused;
+    unused.layer = 0;
+    unused.x = 0;
+    unused.y = 0;
+    unused.first = -1;
+    unused.count = -1;
+    std::vector<Cell> old(size, unused);
+    old.swap(m_cells);
+    m_usedCells = 0;
+    m_minCellX = m_minCellY = 0;
+    m_maxCellX = m_maxCellY = -1;
+    m_maxRadius = 0.0;
+
+    unsigned int mask = m_cells.size() - 1;
+    for (unsigned int i = 0; i < old.size(); i++) {
+        if (old[i].count <= 0)
+            continue;
+        unsigned int spot = hash(old[i].layer, old[i].x, old[i].y) & mask;
+        while (m_cells[spot].count != -1)
+            spot = (spot + 1) & mask;
+        m_cells[spot] = old[i];
+        m_usedCells++;
+        addToBounds(old[i].x, old[i].y);
+        for (Handle handle = old[i].first; handle != -1; handle = m_next[handle]) {
+            m_cellOf[handle] = spot;
+            m_maxRadius = Utils::max(m_maxRadius, m_radius[handle]);
+        }
+    }
+}
+
+void EntityIndex::addToBounds(int x, int y)
+{
+    if (m_usedCells == 1) {
+        m_minCellX = m_maxCellX = x;
+        m_minCellY = m_maxCellY = y;
+        return;
+    }
+    m_minCellX = Utils::min(m_minCellX, x);
+    m_minCellY = Utils::min(m_minCellY, y);
+    m_maxCellX = Utils::max(m_maxCellX, x);
+    m_maxCellY = Utils::max(m_maxCellY, y);
+}
+
+void EntityIndex::link(Handle handle, int cell)
+{
+    Cell & into = m_cells[cell];
+    m_previous[handle] = -1;
+    m_next[handle] = into.first;
+    if (into.first != -1)
+        m_previous[into.first] = handle;
+    into.first = handle;
+    into.count++;
+    m_cellOf[handle] = cell;
+}
+
+void EntityIndex::unlink(Handle handle)
+{
+    Cell & from = m_cells[m_cellOf[handle]];
+    if (m_previous[handle] != -1)
+        m_next[m_previous[handle]] = m_next[handle];
+    else
+        from.first = m_next[handle];
+    if (m_next[handle] != -1)
+        m_previous[m_next[handle]] = m_previous[handle];
+    from.count--;
+    m_cellOf[handle] = -1;
+}
+
+void EntityIndex::findCells(double left, double top, double right, double bottom, int layer)
+{
+    m_queryCells.clear();
+    if (m_count == 0)
+        return;
+
+    // cells are by center, so anything within the biggest radius of the
+    // rectangle could reach into it
+    int startX = Utils::max(cellCoordinate(left - m_maxRadius), m_minCellX);
+    int startY = Utils::max(cellCoordinate(top - m_maxRadius), m_minCellY);
+    int endX = Utils::min(cellCoordinate(right + m_maxRadius), m_maxCellX);
+    int endY = Utils::min(cellCoordinate(bottom + m_maxRadius), m_maxCellY);
+    if (startX > endX || startY > endY)
+        return;
+
+    // a big enough rectangle covers more cells than the table has
+    if ((double)(endX - startX + 1) * (endY - startY + 1) > m_cells.size()) {
+        for (unsigned int i = 0; i < m_cells.size(); i++) {
+            Cell & cell = m_cells[i];
+            if (cell.count > 0 && cell.layer == layer &&
+                startX <= cell.x && cell.x <= endX && startY <= cell.y && cell.y <= endY)
+            {
+                m_queryCells.push_back(i);
+            }
+        }
+        return;
+    }
+
+    for (int y = startY; y <= endY; y++) {
+        for (int x = startX; x <= endX; x++) {
+            int cell = findCell(layer, x, y);
+            if (cell != -1 && m_cells[cell].count > 0)
+                m_queryCells.push_back(cell);
+        }
+    }
+}
+
+void EntityIndex::addNearest(std::vector<Handle> & results, int first, int count, Handle handle, double distance2)
+{
+    // insertion sort into the short list, dropping whatever falls off the end
+    int found = m_nearestDistances.size();
+    int place = found;
+    while (place > 0 && (m_nearestDistances[place - 1] > distance2 ||
+                         (m_nearestDistances[place - 1] == distance2 && results[first + place - 1] > handle)))
+    {
+        place--;
+    }
+    if (place >= count)
+        return;
+    if (found < count) {
+        m_nearestDistances.push_back(0.0);
+        results.push_back(-1);
+        found++;
+    }
+    for (int i = found - 1; i > place; i--) {
+        m_nearestDistances[i] = m_nearestDistances[i - 1];
+        results[first + i] = results[first + i - 1];
+    }
+    m_nearestDistances[place] = distance2;
+    results[first + place] = handle;
+}
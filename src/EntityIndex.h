@@ -0,0 +1,100 @@
+#ifndef _ENTITY_INDEX_H_
+#define _ENTITY_INDEX_H_
+
+#include <vector>
+
+// EntityIndex answers "which entities are near here" without looking at
+// every one of them. it's a loose grid: each entity is filed under the cell
+// its center is in, and queries look at the cells around the query area,
+// widened by the biggest radius in the index so that nothing reaching in
+// from a neighboring cell gets missed.
+// only cells with something in them take up memory, so it covers the whole
+// world however big that is. moving an entity within its cell costs next to
+// nothing and moving it to another cell is a couple of list operations;
+// neither touches the heap unless a lot of new cells show up at once.
+// entities are known by their EntityStore handle.
+class EntityIndex
+{
+public:
+    typedef int Handle;
+
+    EntityIndex();
+
+    void insert(Handle handle, double x, double y, double radius, int layer);
+    void remove(Handle handle);
+    // call when an entity moves, changes size or changes layer
+    void move(Handle handle, double x, double y, double radius, int layer);
+
+    // the queries add handles to results without clearing it first.
+    // entities on layer whose circle overlaps the circle at x, y. in no
+    // particular order
+    void inRadius(std::vector<Handle> & results, double x, double y, double radius, int layer);
+    // entities on layer whose bounding box overlaps the rectangle. in no
+    // particular order
+    void inRectangle(std::vector<Handle> & results, double left, double top,
+                     double width, double height, int layer);
+    // the count entities on layer with their centers closest to x, y,
+    // closest first. fewer if there aren't that many. ties go to the lower
+    // handle
+    void nearest(std::vector<Handle> & results, double x, double y, int count, int layer);
+
+    // how many entities are in the index
+    int count() { return m_count; }
+
+private: //variables
+    typedef struct {
+        int layer, x, y;
+        // -1 when the cell is empty. empty cells stay in the table until the
+        // next rehash, since taking them out would break the probe chains
+        Handle first;
+        // -1 when nothing has ever used this spot in the table
+        int count;
+    } Cell;
+
+    static const double c_cellSize;
+    static const int c_initialCells;
+
+    // hash table of cells. linear probing, size is a power of 2
+    std::vector<Cell> m_cells;
+    // spots in m_cells in use, empty cells included
+    int m_usedCells;
+    // the cells ever used since the last rehash, for nearest to know when
+    // to stop looking
+    int m_minCellX, m_minCellY, m_maxCellX, m_maxCellY;
+    double m_maxRadius;
+    int m_count;
+
+    // indexed by handle
+    std::vector<double> m_x, m_y, m_radius;
+    // where in m_cells it's filed, or -1 if it's not in the index
+    std::vector<int> m_cellOf;
+    // the list of handles in each cell
+    std::vector<Handle> m_next, m_previous;
+
+    // query scratch
+    std::vector<int> m_queryCells;
+    std::vector<double> m_nearestDistances;
+
+private: //methods
+    static int cellCoordinate(double value);
+    static unsigned int hash(int layer, int x, int y);
+
+    // index in m_cells, or -1 if it's not there
+    int findCell(int layer, int x, int y);
+    int findOrAddCell(int layer, int x, int y);
+    // rebuild the table with size spots, dropping empty cells
+    void rehash(int size);
+    // widen the bounds to take in a new cell. the first one sets them
+    void addToBounds(int x, int y);
+    void link(Handle handle, int cell);
+    void unlink(Handle handle);
+
+    // fill m_queryCells with the cells on layer that could have entities
+    // whose centers are in the rectangle
+    void findCells(double left, double top, double right, double bottom, int layer);
+    // add the handle to the count nearest so far in results, which start
+    // at first
+    void addNearest(std::vector<Handle> & results, int first, int count, Handle handle, double distance2);
+};
+
+#endif
@@ -0,0 +1,330 @@
+#include "EntityStore.h"
+
+#include "Entity.h"
+#include "Physics.h"
+#include "Utils.h"
+
+#include <cmath>
+
+EntityStore * EntityStore::s_inst = NULL;
+
+EntityStore::EntityStore() :
+    m_slots(),
+    m_freeHandles(),
+    m_handles(),
+    m_owners(),
+    m_centerX(), m_centerY(),
+    m_previousX(), m_previousY(),
+    m_velocityX(), m_velocityY(),
+    m_radius(),
+    m_mass(),
+    m_speed(),
+    m_layer(),
+    m_shape(),
+    m_movementMode(),
+    m_stillFrames(),
+    m_asleep(),
+    m_islandNext(),
+    m_index()
+{
+}
+
+EntityStore::CollisionScratch::CollisionScratch() :
+    circles(),
+    squares(),
+    runStamps(),
+    runStamp(0)
+{
+}
+
+EntityStore::Handle EntityStore::add(Entity * owner)
+{
+    Handle handle;
+    if (m_freeHandles.size() > 0) {
+        handle = m_freeHandles.back();
+        m_freeHandles.pop_back();
+    } else {
+        handle = m_slots.size();
+        m_slots.push_back(0);
+    }
+
+    m_slots[handle] = m_owners.size();
+    m_handles.push_back(handle);
+    m_owners.push_back(owner);
+    m_centerX.push_back(0.0);
+    m_centerY.push_back(0.0);
+    m_previousX.push_back(0.0);
+    m_previousY.push_back(0.0);
+    m_velocityX.push_back(0.0);
+    m_velocityY.push_back(0.0);
+    m_radius.push_back(0.0);
+    m_mass.push_back(0.0);
+    m_speed.push_back(0.0);
+    m_layer.push_back(0);
+    m_shape.push_back(0);
+    m_movementMode.push_back(0);
+    m_stillFrames.push_back(0);
+    m_asleep.push_back(0);
+    m_islandNext.push_back(handle);
+    m_index.insert(handle, 0.0, 0.0, 0.0, 0);
+    return handle;
+}
+
+void EntityStore::remove(Handle handle)
+{
+    int hole = m_slots[handle];
+    // take it out of its island's loop
+    if (m_islandNext[hole] != handle) {
+        int previous = hole;
+        while (m_islandNext[previous] != handle)
+            previous = m_slots[m_islandNext[previous]];
+        m_islandNext[previous] = m_islandNext[hole];
+    }
+
+    int last = m_owners.size() - 1;
+    if (hole != last) {
+        moveSlot(last, hole);
+        m_slots[m_handles[hole]] = hole;
+    }
+
+    m_handles.pop_back();
+    m_owners.pop_back();
+    m_centerX.pop_back();
+    m_centerY.pop_back();
+    m_previousX.pop_back();
+    m_previousY.pop_back();
+    m_velocityX.pop_back();
+    m_velocityY.pop_back();
+    m_radius.pop_back();
+    m_mass.pop_back();
+    m_speed.pop_back();
+    m_layer.pop_back();
+    m_shape.pop_back();
+    m_movementMode.pop_back();
+    m_stillFrames.pop_back();
+    m_asleep.pop_back();
+    m_islandNext.pop_back();
+
+    m_slots[handle] = -1;
+    m_freeHandles.push_back(handle);
+    m_index.remove(handle);
+}
+
+void EntityStore::updateIndex()
+{
+    for (unsigned int slot = 0; slot < m_owners.size(); slot++)
+        updateIndex(slot);
+}
+
+void EntityStore::moveSlot(int from, int to)
+{
+    m_handles[to] = m_handles[from];
+    m_owners[to] = m_owners[from];
+    m_centerX[to] = m_centerX[from];
+    m_centerY[to] = m_centerY[from];
+    m_previousX[to] = m_previousX[from];
+    m_previousY[to] = m_previousY[from];
+    m_velocityX[to] = m_velocityX[from];
+    m_velocityY[to] = m_velocityY[from];
+    m_radius[to] = m_radius[from];
+    m_mass[to] = m_mass[from];
+    m_speed[to] = m_speed[from];
+    m_layer[to] = m_layer[from];
+    m_shape[to] = m_shape[from];
+    m_movementMode[to] = m_movementMode[from];
+    m_stillFrames[to] = m_stillFrames[from];
+    m_asleep[to] = m_asleep[from];
+    m_islandNext[to] = m_islandNext[from];
+}
+
+void EntityStore::sleep(const int * slots, int count)
+{
+    for (int i = 0; i < count; i++) {
+        int slot = slots[i];
+        m_asleep[slot] = 1;
+        m_islandNext[slot] = m_handles[slots[(i + 1) % count]];
+        m_velocityX[slot] = 0.0;
+        m_velocityY[slot] = 0.0;
+        // so it isn't drawn sliding the last little bit
+        m_previousX[slot] = m_centerX[slot];
+        m_previousY[slot] = m_centerY[slot];
+    }
+}
+
+void EntityStore::wakeIsland(int slot)
+{
+    Handle handle = m_handles[slot];
+    do {
+        Handle next = m_islandNext[slot];
+        m_asleep[slot] = 0;
+        m_stillFrames[slot] = 0;
+        m_islandNext[slot] = m_handles[slot];
+        slot = m_slots[next];
+    } while (m_handles[slot] != handle);
+}
+
+bool EntityStore::orderPair(int & slot1, int & slot2)
+{
+    // squares are always the first argument to the physics functions
+    if (m_shape[slot1] == Entity::Shapeless || m_shape[slot2] == Entity::Shapeless)
+        return false;
+    if (m_shape[slot1] == Entity::Circle && m_shape[slot2] == Entity::Square) {
+        int tmp = slot1;
+        slot1 = slot2;
+        slot2 = tmp;
+    }
+    return true;
+}
+
+void EntityStore::resolveCollision(int slot1, int slot2)
+{
+    if (! orderPair(slot1, slot2))
+        return;
+
+    double dx = 0.0, dy = 0.0;
+    if (! sweepCollision(slot1, slot2, dx, dy)) {
+        double x1 = m_centerX[slot1] + m_velocityX[slot1], y1 = m_centerY[slot1] + m_velocityY[slot1];
+        double x2 = m_centerX[slot2] + m_velocityX[slot2], y2 = m_centerY[slot2] + m_velocityY[slot2];
+        if (m_shape[slot1] == Entity::Circle)
+            Physics::circleAndCircle(x1, y1, m_radius[slot1], x2, y2, m_radius[slot2], dx, dy);
+        else if (m_shape[slot2] == Entity::Circle)
+            Physics::squareAndCircle(x1, y1, m_radius[slot1], x2, y2, m_radius[slot2], dx, dy);
+        else
+            Physics::squareAndSquare(x1, y1, m_radius[slot1], x2, y2, m_radius[slot2], dx, dy);
+    }
+    applyPush(slot1, slot2, dx, dy);
+}
+
+bool EntityStore::sweeps(int slot1, int slot2)
+{
+    double vx = m_velocityX[slot2] - m_velocityX[slot1], vy = m_velocityY[slot2] - m_velocityY[slot1];
+    return vx * vx + vy * vy > Physics::sweepDistance * Physics::sweepDistance;
+}
+
+bool EntityStore::sweepCollision(int slot1, int slot2, double & dx, double & dy)
+{
+    // no sweep for two squares
+    if (m_shape[slot2] != Entity::Circle || ! sweeps(slot1, slot2))
+        return false;
+    // from slot1's point of view
+    double vx = m_velocityX[slot2] - m_velocityX[slot1], vy = m_velocityY[slot2] - m_velocityY[slot1];
+    double t, normalX, normalY;
+    bool hit;
+    if (m_shape[slot1] == Entity::Circle) {
+        hit = Physics::sweepCircleAndCircle(m_centerX[slot1], m_centerY[slot1], m_radius[slot1],
+                                            m_centerX[slot2], m_centerY[slot2], m_radius[slot2],
+                                            vx, vy, t, normalX, normalY);
+    } else {
+        hit = Physics::sweepSquareAndCircle(m_centerX[slot1], m_centerY[slot1], m_radius[slot1],
+                                            m_centerX[slot2], m_centerY[slot2], m_radius[slot2],
+                                            vx, vy, t, normalX, normalY);
+    }
+    // already overlapping is what the plain version is for
+    if (! hit || t == 0.0)
+        return false;
+    // they touch partway through. push back the part of the rest of the
+    // move that goes into the other one
+    double into = (1.0 - t) * (vx * normalX + vy * normalY);
+    dx = -into * normalX;
+    dy = -into * normalY;
+    return true;
+}
+
+void EntityStore::applyPush(int slot1, int slot2, double dx, double dy)
+{
+    if (Utils::isZero(dx) && Utils::isZero(dy))
+        return;
+
+    // resolve momentum collision
+    double distance = std::sqrt(dx * dx + dy * dy);
+    double normalX = dx / distance, normalY = dy / distance;
+    double mass1 = m_mass[slot1], mass2 = m_mass[slot2];
+    double totalMass = mass1 + mass2;
+    double push1 = -distance * mass2 / totalMass, push2 = distance * mass1 / totalMass;
+    m_velocityX[slot1] += push1 * normalX;
+    m_velocityY[slot1] += push1 * normalY;
+    m_velocityX[slot2] += push2 * normalX;
+    m_velocityY[slot2] += push2 * normalY;
+}
+
+void EntityStore::resolveCollisions(std::vector<int> & slots1, std::vector<int> & slots2, int begin, int end,
+                                    CollisionScratch & scratch)
+{
+    std::vector<unsigned int> & stamps = scratch.runStamps;
+    if (stamps.size() != m_owners.size())
+        stamps.assign(m_owners.size(), scratch.runStamp);
+
+    int i = begin;
+    while (i < end) {
+        // grow the run until a pair touches an entity that's already in it
+        int start = i;
+        unsigned int stamp = ++scratch.runStamp;
+        while (i < end && stamps[slots1[i]] != stamp && stamps[slots2[i]] != stamp) {
+            stamps[slots1[i]] = stamp;
+            stamps[slots2[i]] = stamp;
+            i++;
+        }
+        resolveRun(slots1, slots2, start, i, scratch);
+    }
+}
+
+void EntityStore::resolveRun(std::vector<int> & slots1, std::vector<int> & slots2, int start, int end,
+                             CollisionScratch & scratch)
+{
+    if (end - start == 1) {
+        // not worth gathering
+        resolveCollision(slots1[start], slots2[start]);
+        return;
+    }
+
+    CollisionScratch::Batch * batches[] = { &scratch.circles, &scratch.squares };
+    for (int b = 0; b < 2; b++) {
+        CollisionScratch::Batch & batch = *batches[b];
+        batch.slot1.clear(); batch.slot2.clear();
+        batch.x1.clear(); batch.y1.clear(); batch.r1.clear();
+        batch.x2.clear(); batch.y2.clear(); batch.r2.clear();
+    }
+    for (int i = start; i < end; i++) {
+        int slot1 = slots1[i], slot2 = slots2[i];
+        if (! orderPair(slot1, slot2))
+            continue;
+        if (sweeps(slot1, slot2))
+            resolveCollision(slot1, slot2); // no batch version of sweeping
+        else if (m_shape[slot1] == Entity::Circle)
+            addToBatch(scratch.circles, slot1, slot2);
+        else if (m_shape[slot2] == Entity::Circle)
+            addToBatch(scratch.squares, slot1, slot2);
+        else
+            resolveCollision(slot1, slot2); // no batch version of this one
+    }
+
+    for (int b = 0; b < 2; b++) {
+        CollisionScratch::Batch & batch = *batches[b];
+        int count = batch.slot1.size();
+        if (count == 0)
+            continue;
+        batch.dx.resize(count);
+        batch.dy.resize(count);
+        if (b == 0) {
+            Physics::circleAndCircle(&batch.x1[0], &batch.y1[0], &batch.r1[0], &batch.x2[0], &batch.y2[0], &batch.r2[0],
+                                     &batch.dx[0], &batch.dy[0], count);
+        } else {
+            Physics::squareAndCircle(&batch.x1[0], &batch.y1[0], &batch.r1[0], &batch.x2[0], &batch.y2[0], &batch.r2[0],
+                                     &batch.dx[0], &batch.dy[0], count);
+        }
+        for (int i = 0; i < count; i++)
+            applyPush(batch.slot1[i], batch.slot2[i], batch.dx[i], batch.dy[i]);
+    }
+}
+
+void EntityStore::addToBatch(CollisionScratch::Batch & batch, int slot1, int slot2)
+{
+    batch.slot1.push_back(slot1);
+    batch.slot2.push_back(slot2);
+    batch.x1.push_back(m_centerX[slot1] + m_velocityX[slot1]);
+    batch.y1.push_back(m_centerY[slot1] + m_velocityY[slot1]);
+    batch.r1.push_back(m_radius[slot1]);
+    batch.x2.push_back(m_centerX[slot2] + m_velocityX[slot2]);
+    batch.y2.push_back(m_centerY[slot2] + m_velocityY[slot2]);
+    batch.r2.push_back(m_radius[slot2]);
+}
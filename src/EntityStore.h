@@ -0,0 +1,150 @@
+#ifndef _ENTITY_STORE_H_
+#define _ENTITY_STORE_H_
+
+#include "EntityIndex.h"
+
+#include <vector>
+#include <cstddef>
+
+class Entity;
+
+// EntityStore keeps the parts of entities that the simulation touches every
+// frame (position, velocity, size, mass, layer, movement mode) in parallel
+// arrays, so that looping over thousands of entities walks through memory in
+// order instead of jumping from one heap object to the next.
+// Entity itself keeps the rarely touched stuff, like graphics, and a handle
+// into the store.
+//
+// handles are stable for the life of an entity. slots are indexes into the
+// arrays and change when another entity is removed, so only hold on to a
+// slot for as long as nothing is added or removed.
+class EntityStore
+{
+public:
+    typedef int Handle;
+
+    // scratch space for resolveCollisions. each thread needs its own.
+    class CollisionScratch {
+    public:
+        CollisionScratch();
+    private:
+        friend class EntityStore;
+        // one for circle on circle pairs, one for square on circle pairs
+        typedef struct {
+            std::vector<int> slot1, slot2;
+            std::vector<double> x1, y1, r1;
+            std::vector<double> x2, y2, r2;
+            std::vector<double> dx, dy;
+        } Batch;
+        Batch circles;
+        Batch squares;
+        // which slots the current run of pairs has touched
+        std::vector<unsigned int> runStamps;
+        unsigned int runStamp;
+    };
+
+    static EntityStore * instance() { if (s_inst == NULL) s_inst = new EntityStore(); return s_inst; }
+
+    // make room for a new entity. everything starts at zero.
+    Handle add(Entity * owner);
+    // the last slot moves into the hole
+    void remove(Handle handle);
+
+    int slot(Handle handle) { return m_slots[handle]; }
+    int count() { return m_owners.size(); }
+    Entity * owner(int slot) { return m_owners[slot]; }
+
+    // hot data, indexed by slot
+    double & centerX(int slot) { return m_centerX[slot]; }
+    double & centerY(int slot) { return m_centerY[slot]; }
+    // where the center was before the last logic frame moved it. drawing
+    // goes somewhere in between
+    double & previousX(int slot) { return m_previousX[slot]; }
+    double & previousY(int slot) { return m_previousY[slot]; }
+    double & velocityX(int slot) { return m_velocityX[slot]; }
+    double & velocityY(int slot) { return m_velocityY[slot]; }
+    double & radius(int slot) { return m_radius[slot]; }
+    double & mass(int slot) { return m_mass[slot]; }
+    double & speed(int slot) { return m_speed[slot]; }
+    int & layer(int slot) { return m_layer[slot]; }
+    int & shape(int slot) { return m_shape[slot]; }
+    int & movementMode(int slot) { return m_movementMode[slot]; }
+    // frames in a row it's barely moved
+    int & stillFrames(int slot) { return m_stillFrames[slot]; }
+
+    // asleep entities aren't simulated. entities that touch go to sleep
+    // together as an island, and waking any of them wakes the whole island,
+    // since whatever moves one is about to push the rest
+    bool asleep(int slot) { return m_asleep[slot] != 0; }
+    // put the entities to sleep as one island. they stop where they are
+    void sleep(const int * slots, int count);
+    // does nothing if it's awake
+    void wake(int slot) { if (m_asleep[slot]) wakeIsland(slot); }
+
+    // where everything is, for asking what's near a spot. it's kept up to
+    // date by Entity and by calling updateIndex after moving things directly
+    EntityIndex * index() { return &m_index; }
+    // tell the index where the entity in slot is now
+    void updateIndex(int slot) { m_index.move(m_handles[slot], m_centerX[slot], m_centerY[slot], m_radius[slot], m_layer[slot]); }
+    // the same for every slot
+    void updateIndex();
+
+    // push two entities apart, changing their velocities. if they're moving
+    // fast enough to pass through each other, they're swept
+    void resolveCollision(int slot1, int slot2);
+    // same as calling resolveCollision on pairs [begin, end) in order. runs
+    // of pairs that don't share an entity don't depend on each other, so
+    // those go through the batched Physics functions.
+    // it's safe to call this from several threads at once as long as the
+    // pairs given to each thread don't share entities.
+    void resolveCollisions(std::vector<int> & slots1, std::vector<int> & slots2, int begin, int end,
+                           CollisionScratch & scratch);
+
+private: //variables
+    static EntityStore * s_inst;
+
+    // indexed by handle
+    std::vector<int> m_slots;
+    std::vector<Handle> m_freeHandles;
+
+    // indexed by slot
+    std::vector<Handle> m_handles;
+    std::vector<Entity *> m_owners;
+    std::vector<double> m_centerX, m_centerY;
+    std::vector<double> m_previousX, m_previousY;
+    std::vector<double> m_velocityX, m_velocityY;
+    std::vector<double> m_radius;
+    std::vector<double> m_mass;
+    std::vector<double> m_speed;
+    std::vector<int> m_layer;
+    std::vector<int> m_shape;
+    std::vector<int> m_movementMode;
+    std::vector<int> m_stillFrames;
+    std::vector<char> m_asleep;
+    // the next entity in its island, in a loop. itself when it's awake
+    std::vector<Handle> m_islandNext;
+
+    EntityIndex m_index;
+
+private: //methods
+    EntityStore();
+    // copy slot "from" over slot "to"
+    void moveSlot(int from, int to);
+    void wakeIsland(int slot);
+
+    // put the pair in the right order for the physics functions.
+    // returns false if they can't collide.
+    bool orderPair(int & slot1, int & slot2);
+    // push them apart by the vector that slot2 has to move
+    void applyPush(int slot1, int slot2, double dx, double dy);
+    // moving fast enough relative to each other to need sweeping
+    bool sweeps(int slot1, int slot2);
+    // the push for an ordered pair that sweeping finds. false if it doesn't
+    // apply, and the end positions are what count
+    bool sweepCollision(int slot1, int slot2, double & dx, double & dy);
+    void addToBatch(CollisionScratch::Batch & batch, int slot1, int slot2);
+    void resolveRun(std::vector<int> & slots1, std::vector<int> & slots2, int start, int end,
+                    CollisionScratch & scratch);
+};
+
+#endif
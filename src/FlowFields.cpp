@@ -0,0 +1,360 @@
+#include "FlowFields.h"
+
+#include "World.h"
+#include "Map.h"
+#include "Utils.h"
+#include "Debug.h"
+
+#include <algorithm>
+#include <functional>
+#include <cmath>
+#include <cstdlib>
+
+// 129 tiles across is a few screens in every direction
+const int FlowFields::c_fieldRadius = 64;
+const int FlowFields::c_fieldSize = c_fieldRadius * 2 + 1;
+const float FlowFields::c_diagonalCost = 1.41421356f;
+// a field is about 3 steps a tile, so this is a few frames per field
+const int FlowFields::c_updateSteps = 20000;
+const int FlowFields::c_maxFields = 16;
+const int FlowFields::c_idleFrames = 120;
+const int FlowFields::c_standInDistance = 8;
+
+FlowFields::FlowFields(World * world, Tile::PhysicalPresence minPresence) :
+    m_world(world),
+    m_minPresence(minPresence),
+    m_fields(),
+    m_current(-1),
+    m_placements()
+{
+}
+
+bool FlowFields::direction(double x, double y, double goalX, double goalY, int layer,
+                           double & directionX, double & directionY)
+{
+    int goalTileX = tileCoordinate(goalX), goalTileY = tileCoordinate(goalY);
+    int tileX = tileCoordinate(x), tileY = tileCoordinate(y);
+    int index = findField(goalTileX, goalTileY, layer);
+    if (index == -1)
+        index = addField(goalTileX, goalTileY, layer);
+    m_fields[index].idle = 0;
+    if (m_fields[index].stage != Done) {
+        index = findStandIn(goalTileX, goalTileY, layer, tileX, tileY);
+        if (index == -1)
+            return false;
+        m_fields[index].idle = 0;
+    }
+
+    Field & field = m_fields[index];
+    int fieldX = tileX - field.left, fieldY = tileY - field.top;
+    if (fieldX < 0 || fieldX >= c_fieldSize || fieldY < 0 || fieldY >= c_fieldSize)
+        return false;
+    // laid out like Entity::Direction
+    int tile = fieldY * c_fieldSize + fieldX;
+    int direction = field.directions[tile];
+    // on a tile you can't walk on, like the edge of a rail. head for the
+    // cheapest one next to it
+    if (direction == 4 && field.cost[tile] < 0.0f)
+        direction = cheapestNeighbor(field, fieldX, fieldY);
+    if (direction == 4)
+        return false;
+    directionX = direction % 3 - 1;
+    directionY = direction / 3 - 1;
+    if (directionX != 0.0 && directionY != 0.0) {
+        directionX *= Utils::RadHalf;
+        directionY *= Utils::RadHalf;
+    }
+    return true;
+}
+
+void FlowFields::update()
+{
+    for (unsigned int i = 0; i < m_fields.size(); i++) {
+        Field & field = m_fields[i];
+        if (! field.used)
+            continue;
+        if (++field.idle > c_idleFrames) {
+            field.used = false;
+            if (m_current == (int)i)
+                m_current = -1;
+        } else if (stale(field)) {
+            restart(field);
+        }
+    }
+
+    int steps = c_updateSteps;
+    while (steps > 0) {
+        if (m_current == -1) {
+            for (unsigned int i = 0; i < m_fields.size(); i++) {
+                if (m_fields[i].used && m_fields[i].stage != Done) {
+                    m_current = i;
+                    break;
+                }
+            }
+            if (m_current == -1)
+                return;
+        }
+        Field & field = m_fields[m_current];
+        steps -= step(field, steps);
+        if (field.stage == Done)
+            m_current = -1;
+    }
+}
+
+void FlowFields::tilesChanged(double left, double top, double width, double height)
+{
+    int tileLeft = tileCoordinate(left), tileTop = tileCoordinate(top);
+    int tileRight = tileCoordinate(left + width), tileBottom = tileCoordinate(top + height);
+    for (unsigned int i = 0; i < m_fields.size(); i++) {
+        Field & field = m_fields[i];
+        if (field.used && tileLeft < field.left + c_fieldSize && tileRight >= field.left &&
+            tileTop < field.top + c_fieldSize && tileBottom >= field.top)
+        {
+            restart(field);
+        }
+    }
+}
+
+int FlowFields::tileCoordinate(double value)
+{
+    return (int)std::floor(value / Tile::size);
+}
+
+bool FlowFields::walkable(int tileX, int tileY, int layer)
+{
+    double centerX = (tileX + 0.5) * Tile::size, centerY = (tileY + 0.5) * Tile::size;
+    int placement = m_world->placementAt(centerX, centerY);
+    if (placement == -1)
+        return false;
+    World::MapPlacement * where = m_world->placement(placement);
+    Map * map = where->map;
+    if (map == NULL || layer < 0 || layer >= map->layerCount())
+        return false;
+    // the right and bottom edges belong to the map too
+    int x = Utils::min((int)((centerX - where->left) / Tile::size), map->tileCountX() - 1);
+    int y = Utils::min((int)((centerY - where->top) / Tile::size), map->tileCountY() - 1);
+    Tile * tile = map->tile(x, y, layer);
+    return tile->hasMinPresence(Tile::ppFloor) && !tile->hasMinPresence(m_minPresence);
+}
+
+int FlowFields::findField(int goalX, int goalY, int layer)
+{
+    for (unsigned int i = 0; i < m_fields.size(); i++) {
+        Field & field = m_fields[i];
+        if (field.used && field.goalX == goalX && field.goalY == goalY && field.layer == layer)
+            return i;
+    }
+    return -1;
+}
+
+int FlowFields::findStandIn(int goalX, int goalY, int layer, int x, int y)
+{
+    int best = -1, bestDistance = c_standInDistance + 1;
+    for (unsigned int i = 0; i < m_fields.size(); i++) {
+        Field & field = m_fields[i];
+        if (! field.used || field.stage != Done || field.layer != layer ||
+            x < field.left || x >= field.left + c_fieldSize || y < field.top || y >= field.top + c_fieldSize)
+        {
+            continue;
+        }
+        int distance = Utils::max(std::abs(field.goalX - goalX), std::abs(field.goalY - goalY));
+        if (distance < bestDistance) {
+            best = i;
+            bestDistance = distance;
+        }
+    }
+    return best;
+}
+
+int FlowFields::addField(int goalX, int goalY, int layer)
+{
+    int index = -1;
+    for (unsigned int i = 0; i < m_fields.size(); i++) {
+        if (! m_fields[i].used) {
+            index = i;
+            break;
+        }
+    }
+    if (index == -1 && (int)m_fields.size() < c_maxFields) {
+        index = m_fields.size();
+        m_fields.push_back(Field());
+    }
+    if (index == -1) {
+        index = 0;
+        for (unsigned int i = 1; i < m_fields.size(); i++) {
+            if (m_fields[i].idle > m_fields[index].idle)
+                index = i;
+        }
+    }
+    if (m_current == index)
+        m_current = -1;
+
+    Field & field = m_fields[index];
+    field.used = true;
+    field.goalX = goalX;
+    field.goalY = goalY;
+    field.layer = layer;
+    field.left = goalX - c_fieldRadius;
+    field.top = goalY - c_fieldRadius;
+    field.idle = 0;
+    restart(field);
+    return index;
+}
+
+void FlowFields::restart(Field & field)
+{
+    field.stage = Sample;
+    field.next = 0;
+    findPlacements(field);
+    field.placements.clear();
+    for (unsigned int i = 0; i < m_placements.size(); i++)
+        field.placements.push_back(std::make_pair(m_placements[i], m_world->placement(m_placements[i])->generation));
+    field.walkable.assign(c_fieldSize * c_fieldSize, 0);
+    field.cost.assign(c_fieldSize * c_fieldSize, -1.0f);
+    field.directions.assign(c_fieldSize * c_fieldSize, 4);
+    field.open.clear();
+}
+
+int FlowFields::step(Field & field, int steps)
+{
+    const int tileCount = c_fieldSize * c_fieldSize;
+    const int goal = c_fieldRadius * c_fieldSize + c_fieldRadius;
+    int done = 0;
+    while (done < steps && field.stage != Done) {
+        done++;
+        switch (field.stage) {
+        case Sample:
+            {
+                int tile = field.next++;
+                field.walkable[tile] = walkable(field.left + tile % c_fieldSize,
+                                                field.top + tile / c_fieldSize, field.layer);
+                if (field.next == tileCount) {
+                    field.stage = Integrate;
+                    if (field.walkable[goal]) {
+                        field.cost[goal] = 0.0f;
+                        field.open.push_back(std::make_pair(0.0f, goal));
+                    }
+                }
+                break;
+            }
+        case Integrate:
+            {
+                if (field.open.size() == 0) {
+                    field.stage = Point;
+                    field.next = 0;
+                    break;
+                }
+                std::pop_heap(field.open.begin(), field.open.end(), std::greater<std::pair<float, int> >());
+                float cost = field.open.back().first;
+                int tile = field.open.back().second;
+                field.open.pop_back();
+                // there's a cheaper way here further up the heap
+                if (cost > field.cost[tile])
+                    break;
+
+                int tileX = tile % c_fieldSize, tileY = tile / c_fieldSize;
+                for (int dy = -1; dy <= 1; dy++) {
+                    for (int dx = -1; dx <= 1; dx++) {
+                        int nextX = tileX + dx, nextY = tileY + dy;
+                        if ((dx == 0 && dy == 0) || nextX < 0 || nextX >= c_fieldSize || nextY < 0 || nextY >= c_fieldSize)
+                            continue;
+                        int next = nextY * c_fieldSize + nextX;
+                        if (! field.walkable[next])
+                            continue;
+                        // no cutting corners
+                        if (dx != 0 && dy != 0 && !(field.walkable[tileY * c_fieldSize + nextX] &&
+                                                    field.walkable[nextY * c_fieldSize + tileX]))
+                        {
+                            continue;
+                        }
+                        float nextCost = cost + (dx != 0 && dy != 0 ? c_diagonalCost : 1.0f);
+                        if (field.cost[next] >= 0.0f && field.cost[next] <= nextCost)
+                            continue;
+                        field.cost[next] = nextCost;
+                        field.open.push_back(std::make_pair(nextCost, next));
+                        std::push_heap(field.open.begin(), field.open.end(), std::greater<std::pair<float, int> >());
+                    }
+                }
+                break;
+            }
+        case Point:
+            {
+                int tile = field.next++;
+                if (field.next == tileCount)
+                    field.stage = Done;
+                if (tile == goal || field.cost[tile] < 0.0f)
+                    break;
+
+                // downhill, the same way the wavefront came
+                int tileX = tile % c_fieldSize, tileY = tile / c_fieldSize;
+                float best = field.cost[tile];
+                for (int dy = -1; dy <= 1; dy++) {
+                    for (int dx = -1; dx <= 1; dx++) {
+                        int nextX = tileX + dx, nextY = tileY + dy;
+                        if ((dx == 0 && dy == 0) || nextX < 0 || nextX >= c_fieldSize || nextY < 0 || nextY >= c_fieldSize)
+                            continue;
+                        int next = nextY * c_fieldSize + nextX;
+                        if (field.cost[next] < 0.0f)
+                            continue;
+                        if (dx != 0 && dy != 0 && !(field.walkable[tileY * c_fieldSize + nextX] &&
+                                                    field.walkable[nextY * c_fieldSize + tileX]))
+                        {
+                            continue;
+                        }
+                        float viaCost = field.cost[next] + (dx != 0 && dy != 0 ? c_diagonalCost : 1.0f);
+                        if (viaCost <= best) {
+                            best = viaCost;
+                            field.directions[tile] = (dx + 1) + 3 * (dy + 1);
+                        }
+                    }
+                }
+                break;
+            }
+        default: assert(false);
+        }
+    }
+    return done;
+}
+
+int FlowFields::cheapestNeighbor(Field & field, int x, int y)
+{
+    int direction = 4;
+    float best = -1.0f;
+    for (int dy = -1; dy <= 1; dy++) {
+        for (int dx = -1; dx <= 1; dx++) {
+            int nextX = x + dx, nextY = y + dy;
+            if ((dx == 0 && dy == 0) || nextX < 0 || nextX >= c_fieldSize || nextY < 0 || nextY >= c_fieldSize)
+                continue;
+            float cost = field.cost[nextY * c_fieldSize + nextX];
+            if (cost < 0.0f)
+                continue;
+            if (dx != 0 && dy != 0 && !(field.walkable[y * c_fieldSize + nextX] &&
+                                        field.walkable[nextY * c_fieldSize + x]))
+            {
+                continue;
+            }
+            cost += dx != 0 && dy != 0 ? c_diagonalCost : 1.0f;
+            if (best < 0.0f || cost < best) {
+                best = cost;
+                direction = (dx + 1) + 3 * (dy + 1);
+            }
+        }
+    }
+    return direction;
+}
+
+bool FlowFields::stale(Field & field)
+{
+    for (unsigned int i = 0; i < field.placements.size(); i++) {
+        if (m_world->placement(field.placements[i].first)->generation != field.placements[i].second)
+            return true;
+    }
+    return false;
+}
+
+void FlowFields::findPlacements(Field & field)
+{
+    m_placements.clear();
+    m_world->placementsIntersecting(m_placements, field.left * Tile::size, field.top * Tile::size,
+                                    c_fieldSize * Tile::size, c_fieldSize * Tile::size);
+}
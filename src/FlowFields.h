@@ -0,0 +1,122 @@
+#ifndef _FLOW_FIELDS_H_
+#define _FLOW_FIELDS_H_
+
+#include "Tile.h"
+
+#include <vector>
+
+class World;
+
+// FlowFields steers crowds. a flow field covers the tiles around a goal and
+// says, for every one of them, which way to go to get to the goal the
+// cheapest way. working it out is a dijkstra wavefront out from the goal
+// over every tile in the field, and then a pass that points each tile at
+// its cheapest neighbor, so it costs the same for one entity as for a
+// thousand: everything heading for the same tile shares the same field.
+// fields are worked out a bit at a time in update, and whatever is heading
+// for a tile whose field isn't done yet is steered by a finished field for
+// a tile close by, which is what happens all the time when chasing
+// something that moves.
+// the tiles are Tile::size squares lined up with the world's origin, and
+// each one is whatever tile of the map under its center is there. you can
+// walk on tiles that have a floor and don't stick up as far as
+// minPresence. diagonals count as walls.
+class FlowFields
+{
+public:
+    FlowFields(World * world, Tile::PhysicalPresence minPresence);
+
+    // which way to go from x, y to get to the tile at goalX, goalY, as a
+    // unit vector. false if there's no field for it yet, or none that
+    // covers x, y, or there's no way there, or x, y is already there. asks
+    // for a field for the goal if there isn't one
+    bool direction(double x, double y, double goalX, double goalY, int layer,
+                   double & directionX, double & directionY);
+
+    // work on the fields, until a frame's worth of tiles are done. fields
+    // nothing asked for in a while get reused
+    void update();
+
+    // tiles in the rectangle, on every layer, changed since they were
+    // loaded
+    void tilesChanged(double left, double top, double width, double height);
+
+private: //variables
+    enum Stage {
+        // finding out which tiles you can walk on
+        Sample,
+        // the wavefront
+        Integrate,
+        // pointing every tile at its cheapest neighbor
+        Point,
+        Done,
+    };
+
+    typedef struct {
+        bool used;
+        Stage stage;
+        // in tiles. the goal is in the middle
+        int goalX, goalY, layer;
+        int left, top;
+        // update() calls since direction last asked for it
+        int idle;
+        // the maps under it, and their generations when it was started. if
+        // one streams in or out, it starts over
+        std::vector<std::pair<int, int> > placements;
+        // how far through the stage it is, for Sample and Point
+        int next;
+        // by tile in the field
+        std::vector<char> walkable;
+        std::vector<float> cost;
+        // Entity::Direction. Center for the goal and for tiles that can't
+        // get there
+        std::vector<char> directions;
+        std::vector<std::pair<float, int> > open;
+    } Field;
+
+    // the fields go this many tiles out from the goal
+    static const int c_fieldRadius;
+    static const int c_fieldSize;
+    static const float c_diagonalCost;
+    // how many tiles update does per frame, over all fields
+    static const int c_updateSteps;
+    // at most this many fields at once. the one unused the longest makes
+    // way for a new one
+    static const int c_maxFields;
+    // fields nothing has asked for in this many frames stop being updated
+    static const int c_idleFrames;
+    // how far from the goal a finished field for another tile can be and
+    // still be used until the goal's field is done
+    static const int c_standInDistance;
+
+    World * m_world;
+    Tile::PhysicalPresence m_minPresence;
+    std::vector<Field> m_fields;
+    // the field update is working on, so that one gets finished before
+    // the next starts
+    int m_current;
+    // scratch for restart
+    std::vector<int> m_placements;
+
+private: //methods
+    static int tileCoordinate(double value);
+    bool walkable(int tileX, int tileY, int layer);
+
+    int findField(int goalX, int goalY, int layer);
+    // the finished field whose goal is closest to the tile, if it's within
+    // c_standInDistance and covers x, y. -1 if there isn't one
+    int findStandIn(int goalX, int goalY, int layer, int x, int y);
+    int addField(int goalX, int goalY, int layer);
+    void restart(Field & field);
+    // does up to steps steps of work on the field. returns how many it did
+    int step(Field & field, int steps);
+    // the direction of the cheapest neighbor of a tile that isn't in the
+    // field. Center if there isn't one
+    int cheapestNeighbor(Field & field, int x, int y);
+    // wherever it's at, it has to start over if the maps under it changed
+    bool stale(Field & field);
+    // fill m_placements with the placements under the field
+    void findPlacements(Field & field);
+};
+
+#endif
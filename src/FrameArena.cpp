@@ -0,0 +1,63 @@
+#include "FrameArena.h"
+
+#include "Utils.h"
+
+const std::size_t FrameArena::c_defaultBlockSize = 64 * 1024;
+const std::size_t FrameArena::c_alignment = 16;
+
+FrameArena::FrameArena(std::size_t blockSize) :
+    m_block(new char[blockSize]),
+    m_blockSize(blockSize),
+    m_used(0),
+    m_overflow(),
+    m_overflowBytes(0),
+    m_peakBytesUsed(0),
+    m_heapAllocationCount(1)
+{
+}
+
+FrameArena::~FrameArena()
+{
+    reset();
+    delete[] m_block;
+}
+
+void * FrameArena::allocate(std::size_t size)
+{
+    // the block is aligned by operator new[], so aligning offsets is enough
+    std::size_t start = (m_used + c_alignment - 1) & ~(c_alignment - 1);
+    if (start + size <= m_blockSize) {
+        m_used = start + size;
+        return m_block + start;
+    }
+
+    // out of room. this frame gets by with the heap
+    char * memory = new char[size];
+    m_overflow.push_back(memory);
+    m_overflowBytes += size;
+    m_heapAllocationCount++;
+    return memory;
+}
+
+void FrameArena::reset()
+{
+    m_peakBytesUsed = Utils::max(m_peakBytesUsed, bytesUsed());
+    if (m_overflow.size() > 0) {
+        // grow enough to fit the whole frame, with room to spare
+        std::size_t needed = m_used + m_overflowBytes + m_overflow.size() * c_alignment;
+        std::size_t newSize = m_blockSize;
+        while (newSize < needed)
+            newSize *= 2;
+        newSize *= 2;
+
+        for (unsigned int i = 0; i < m_overflow.size(); i++)
+            delete[] m_overflow[i];
+        m_overflow.clear();
+        delete[] m_block;
+        m_block = new char[newSize];
+        m_blockSize = newSize;
+        m_heapAllocationCount++;
+    }
+    m_used = 0;
+    m_overflowBytes = 0;
+}
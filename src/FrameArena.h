@@ -0,0 +1,96 @@
+#ifndef _FRAME_ARENA_H_
+#define _FRAME_ARENA_H_
+
+#include <vector>
+#include <cstddef>
+#include <new>
+
+// FrameArena hands out memory for things that only live until the end of
+// the frame. allocating is bumping a pointer, freeing is a no-op, and
+// reset forgets everything at once. the memory is kept between frames, so
+// once the arena has grown to fit a frame it never touches the heap again.
+class FrameArena
+{
+public:
+    FrameArena(std::size_t blockSize = c_defaultBlockSize);
+    ~FrameArena();
+
+    // aligned at least as well as memory from operator new
+    void * allocate(std::size_t size);
+
+    // forget everything. if the frame didn't fit, the arena grows so that
+    // the next one does.
+    void reset();
+
+    // metrics
+    std::size_t bytesUsed() { return m_used + m_overflowBytes; }
+    std::size_t peakBytesUsed() { return m_peakBytesUsed; }
+    std::size_t capacity() { return m_blockSize; }
+    // how many times the arena has gone to the heap
+    int heapAllocationCount() { return m_heapAllocationCount; }
+
+private: //variables
+    static const std::size_t c_defaultBlockSize;
+    static const std::size_t c_alignment;
+
+    char * m_block;
+    std::size_t m_blockSize;
+    std::size_t m_used;
+
+    // allocations that didn't fit in the block this frame
+    std::vector<char *> m_overflow;
+    std::size_t m_overflowBytes;
+
+    std::size_t m_peakBytesUsed;
+    int m_heapAllocationCount;
+
+private: //methods
+    FrameArena(const FrameArena &);
+    FrameArena & operator=(const FrameArena &);
+};
+
+// lets STL containers live in a FrameArena, for example:
+//     ArenaAllocator<int> allocator(arena);
+//     std::vector<int, ArenaAllocator<int> > list(allocator);
+// the container must not outlive the arena's next reset.
+template <class T>
+class ArenaAllocator
+{
+public:
+    typedef T value_type;
+    typedef T * pointer;
+    typedef const T * const_pointer;
+    typedef T & reference;
+    typedef const T & const_reference;
+    typedef std::size_t size_type;
+    typedef std::ptrdiff_t difference_type;
+
+    template <class U>
+    struct rebind { typedef ArenaAllocator<U> other; };
+
+    ArenaAllocator(FrameArena * arena) : m_arena(arena) {}
+    template <class U>
+    ArenaAllocator(const ArenaAllocator<U> & other) : m_arena(other.arena()) {}
+
+    pointer allocate(size_type count, const void * = 0) { return (pointer)m_arena->allocate(count * sizeof(T)); }
+    void deallocate(pointer, size_type) {}
+
+    void construct(pointer p, const T & value) { new((void *)p) T(value); }
+    void destroy(pointer p) { p->~T(); }
+
+    pointer address(reference value) const { return &value; }
+    const_pointer address(const_reference value) const { return &value; }
+    size_type max_size() const { return ((size_type)-1) / sizeof(T); }
+
+    FrameArena * arena() const { return m_arena; }
+
+private:
+    FrameArena * m_arena;
+};
+
+template <class T, class U>
+inline bool operator==(const ArenaAllocator<T> & a, const ArenaAllocator<U> & b) { return a.arena() == b.arena(); }
+template <class T, class U>
+inline bool operator!=(const ArenaAllocator<T> & a, const ArenaAllocator<U> & b) { return a.arena() != b.arena(); }
+
+#endif
@@ -7,8 +7,19 @@
 #include "Debug.h"
 #include "Utils.h"
 #include "MainWindow.h"
+#include "WorldStreamer.h"
+#include "Config.h"
+#include "WorkerPool.h"
+#include "InputRecording.h"
+#include "HeapCounter.h"
+#include "Profiler.h"
+#include "SfmlRenderBackend.h"
+#include "Pathfinder.h"
+#include "FlowFields.h"
+#include "Physics.h"
 
 #include <cmath>
+#include <algorithm>
 
 #include <iostream>
 
@@ -19,27 +30,130 @@ const char * Gameplay::ResourceFilePath = "resources.dat";
 #endif
 
 Gameplay * Gameplay::s_inst = NULL;
+const double Gameplay::c_broadphaseMargin = 2.0;
+const int Gameplay::c_islandGrain = 8;
+const int Gameplay::c_entityGrain = 32;
+// rays are short, so hand them out in bigger chunks
+const int Gameplay::c_rayGrain = 64;
+const int Gameplay::c_tileListReserve = 16;
+const double Gameplay::c_sleepSpeed = 0.05;
+const int Gameplay::c_sleepFrames = 60;
+const int Gameplay::c_sweepPasses = 3;
+const double Gameplay::c_sweepGraze = 0.001;
 
 Gameplay::Gameplay(MainWindow * owner) :
     m_good(true),
     m_screen(owner->renderWindow()),
+    m_fps(owner->fps()),
     m_interval(1000/owner->fps()), //frames per second -> miliseconds
     m_frameCount(0),
+    m_interpolation(1.0),
     m_screenX(0.0), m_screenY(0.0),
+    m_screenVelocityX(0.0), m_screenVelocityY(0.0),
     m_universe(NULL),
     m_currentWorld(NULL),
-    m_loadedMaps(),
+    m_streamer(NULL),
+    m_pathfinder(NULL),
+    m_flowFields(NULL),
     m_loadedMapsCache(),
+    m_nearbyMaps(),
     m_entities(),
+    m_activeEntities(),
+    m_entitySlots(),
+    m_sleepEnabled(Config::instance()->sleepEntities()),
+    m_touched(),
+    m_islandAwake(),
+    m_sleepStarts(), m_sleepSlots(),
+    m_pairSlots1(), m_pairSlots2(),
     m_player(NULL),
+    m_broadphase(),
+    m_drawQueue(),
+    m_commands(),
+    m_backend(new SfmlRenderBackend(m_screen)),
+    m_workers(NULL),
+    m_workerScratch(),
+    m_rays(NULL),
+    m_triggerOverlaps(), m_newTriggerOverlaps(),
+    m_triggerEvents(),
+    m_triggerHandler(NULL), m_triggerContext(NULL),
+    m_handleFrames(),
+    m_heapAllocationsLastFrame(0),
+    m_heapAllocationsAtFrameStart(0),
     m_window(owner),
-    m_input(new Input(m_screen->GetInput()))
+    m_input(new Input(m_screen->GetInput())),
+    m_recording(NULL),
+    m_replay(NULL)
+{
+    initialize(ResourceFilePath);
+}
+
+Gameplay::Gameplay(std::string resourceFile, int fps) :
+    m_good(true),
+    m_screen(NULL),
+    m_fps(fps),
+    m_interval(1000/fps),
+    m_frameCount(0),
+    m_interpolation(1.0),
+    m_screenX(0.0), m_screenY(0.0),
+    m_screenVelocityX(0.0), m_screenVelocityY(0.0),
+    m_universe(NULL),
+    m_currentWorld(NULL),
+    m_streamer(NULL),
+    m_pathfinder(NULL),
+    m_flowFields(NULL),
+    m_loadedMapsCache(),
+    m_nearbyMaps(),
+    m_entities(),
+    m_activeEntities(),
+    m_entitySlots(),
+    m_sleepEnabled(Config::instance()->sleepEntities()),
+    m_touched(),
+    m_islandAwake(),
+    m_sleepStarts(), m_sleepSlots(),
+    m_pairSlots1(), m_pairSlots2(),
+    m_player(NULL),
+    m_broadphase(),
+    m_drawQueue(),
+    m_commands(),
+    m_backend(NULL),
+    m_workers(NULL),
+    m_workerScratch(),
+    m_rays(NULL),
+    m_triggerOverlaps(), m_newTriggerOverlaps(),
+    m_triggerEvents(),
+    m_triggerHandler(NULL), m_triggerContext(NULL),
+    m_handleFrames(),
+    m_heapAllocationsLastFrame(0),
+    m_heapAllocationsAtFrameStart(0),
+    m_window(NULL),
+    m_input(new Input()),
+    m_recording(NULL),
+    m_replay(NULL)
+{
+    initialize(resourceFile);
+}
+
+void Gameplay::initialize(std::string resourceFile)
 {
     assert(s_inst == NULL);
     s_inst = this;
 
+    Config * config = Config::instance();
+    if (config->replayFile().size() > 0) {
+        m_replay = new InputRecording();
+        if (! m_replay->load(config->replayFile())) {
+            m_good = false;
+            return;
+        }
+        m_input->setReplay(m_replay);
+    }
+    if (config->recordFile().size() > 0) {
+        m_recording = new InputRecording();
+        m_input->setRecorder(m_recording);
+    }
+
     // initialize gameplay
-    m_universe = ResourceManager::loadUniverse(ResourceFilePath, "main.universe");
+    m_universe = ResourceManager::loadUniverse(resourceFile, "main.universe");
     if (m_universe == NULL) {
         m_good = false;
         return;
@@ -50,18 +164,38 @@ Gameplay::Gameplay(MainWindow * owner) :
         return;
     }
     m_currentWorld = m_universe->startWorld();
-
-    std::vector<Map*>* allMaps = m_currentWorld->maps();
-    for (unsigned int i = 0; i < allMaps->size(); i++)
-        m_loadedMaps.insert((*allMaps)[i]);
-
     m_player = m_universe->player();
+
+    // only the neighborhood of the player is loaded. the rest streams in.
+    // recordings and headless runs have to play back the same way every
+    // time, so they don't let the disk decide when a map shows up.
+    bool synchronousStreaming = m_window == NULL || m_replay != NULL || m_recording != NULL;
+    m_streamer = new WorldStreamer(m_currentWorld, config->streamRadius(), synchronousStreaming);
+    m_streamer->loadAround(m_player->centerX(), m_player->centerY());
+    m_pathfinder = new Pathfinder(m_currentWorld, Entity::minPhysicalPresence(Entity::Walk));
+    m_flowFields = new FlowFields(m_currentWorld, Entity::minPhysicalPresence(Entity::Walk));
+
+    m_workers = new WorkerPool(config->simulationThreads());
+    for (int i = 0; i < m_workers->workerCount(); i++)
+        m_workerScratch.push_back(new WorkerScratch());
 }
 
 Gameplay::~Gameplay()
 {
+    if (m_recording != NULL)
+        m_recording->save(Config::instance()->recordFile());
+    delete m_recording;
+    delete m_replay;
+    delete m_workers;
+    for (unsigned int i = 0; i < m_workerScratch.size(); i++)
+        delete m_workerScratch[i];
+    delete m_flowFields;
+    delete m_pathfinder;
+    delete m_streamer;
     delete m_universe;
+    ResourceManager::close();
     delete m_input;
+    delete m_backend;
     s_inst = NULL;
 }
 
@@ -72,10 +206,23 @@ bool Gameplay::isGood()
 
 void Gameplay::nextFrame()
 {
+    PROFILE_ZONE("Gameplay::nextFrame");
+    long long heapAllocations = HeapCounter::allocationCount();
+    m_heapAllocationsLastFrame = heapAllocations - m_heapAllocationsAtFrameStart;
+    m_heapAllocationsAtFrameStart = heapAllocations;
+
+    // last frame's scratch is garbage now
+    for (unsigned int i = 0; i < m_workerScratch.size(); i++)
+        m_workerScratch[i]->arena.reset();
+
+    // stream maps in and out around the player. whatever is on screen
+    // has to be in memory
+    m_streamer->update(m_player->centerX(), m_player->centerY(), m_screenVelocityX, m_screenVelocityY,
+                       m_screenX, m_screenY, screenWidth(), screenHeight());
+
     // cache loaded maps
-    m_loadedMapsCache.clear();
-    for (std::set<Map*>::iterator iMap = m_loadedMaps.begin(); iMap != m_loadedMaps.end(); iMap++)
-        m_loadedMapsCache.push_back(*iMap);
+    std::vector<Map*> * residentMaps = m_streamer->residentMaps();
+    m_loadedMapsCache.assign(residentMaps->begin(), residentMaps->end());
     // cache loaded entities
     m_entities.clear();
     m_entities.push_back(m_player);
@@ -85,19 +232,66 @@ void Gameplay::nextFrame()
             m_entities.push_back((*mapEntities)[j]);
     }
 
+    // path requests and flow fields asked for last frame, now that the maps
+    // for this one are in
+    {
+        PROFILE_ZONE("Pathfinder::update");
+        m_pathfinder->update();
+    }
+    {
+        PROFILE_ZONE("FlowFields::update");
+        m_flowFields->update();
+    }
 
     // refresh the input state
     m_input->refresh();
 
-    for (unsigned int i = 0; i < m_entities.size(); i++)
-        applyInput(m_entities[i], m_entities[i] == m_player);
-    for (unsigned int i = 0; i < m_entities.size() - 1; i++)
-        for (unsigned int j = i + 1; j < m_entities.size(); j++)
-            m_entities[i]->resolveCollision(m_entities[j]);
-    for (unsigned int i = 0; i < m_entities.size(); i++)
-        resolveWithWorld(m_entities[i]);
+    // only what's awake gets simulated
+    wakeTouched();
+
+    {
+        PROFILE_ZONE("Gameplay::applyInput");
+        for (unsigned int i = 0; i < m_activeEntities.size(); i++)
+            applyInput(m_activeEntities[i], m_activeEntities[i] == m_player);
+    }
+
+    // from here on nothing is added to or removed from the store, so the
+    // physics can work on slots directly
+    EntityStore * store = EntityStore::instance();
+    m_entitySlots.resize(m_activeEntities.size());
+    for (unsigned int i = 0; i < m_activeEntities.size(); i++)
+        m_entitySlots[i] = m_activeEntities[i]->slot();
+    {
+        PROFILE_ZONE("Broadphase::findPairs");
+        m_broadphase.findPairs(store, m_entitySlots, c_broadphaseMargin);
+        m_broadphase.findIslands();
+    }
+    std::vector<Broadphase::Pair> * pairs = m_broadphase.pairs();
+    std::vector<int> * islandPairs = m_broadphase.islandPairs();
+    m_pairSlots1.resize(pairs->size());
+    m_pairSlots2.resize(pairs->size());
+    for (unsigned int i = 0; i < islandPairs->size(); i++) {
+        Broadphase::Pair & pair = (*pairs)[(*islandPairs)[i]];
+        m_pairSlots1[i] = m_entitySlots[pair.first];
+        m_pairSlots2[i] = m_entitySlots[pair.second];
+    }
+    m_workers->run(resolveIslandsJob, this, m_broadphase.islandCount(), c_islandGrain);
+    m_workers->run(resolveWithWorldJob, this, m_entitySlots.size(), c_entityGrain);
+    {
+        // the workers moved everything without telling the index. the
+        // sleepers didn't move
+        PROFILE_ZONE("EntityStore::updateIndex");
+        for (unsigned int i = 0; i < m_entitySlots.size(); i++)
+            store->updateIndex(m_entitySlots[i]);
+    }
+    updateTriggers();
+    if (m_sleepEnabled) {
+        PROFILE_ZONE("Gameplay::sleepIdle");
+        sleepIdle();
+    }
 
     // scroll the screen
+    double oldScreenX = m_screenX, oldScreenY = m_screenY;
     double marginNorth = m_player->centerY() - m_screenY;
     double marginEast = m_screenX + screenWidth() - (m_player->centerX() + m_player->radius());
     double marginSouth = m_screenY + screenHeight() - (m_player->centerY() + m_player->radius());
@@ -111,10 +305,125 @@ void Gameplay::nextFrame()
         m_screenX -= minMarginWest() - marginWest;
     else if (marginEast < minMarginEast())
         m_screenX += minMarginEast() - marginEast;
+    m_screenVelocityX = m_screenX - oldScreenX;
+    m_screenVelocityY = m_screenY - oldScreenY;
 
     m_frameCount++;
 }
 
+void Gameplay::wakeTouched()
+{
+    PROFILE_ZONE("Gameplay::wakeTouched");
+    EntityStore * store = EntityStore::instance();
+    m_activeEntities.clear();
+    for (unsigned int i = 0; i < m_entities.size(); i++) {
+        if (! m_entities[i]->isAsleep())
+            m_activeEntities.push_back(m_entities[i]);
+    }
+    if (m_activeEntities.size() == m_entities.size())
+        return;
+
+    // anything that moved last frame might bump into a sleeper this frame.
+    // getting pushed counts, even when the entity's own velocity is about 0,
+    // so go by how far its center actually went. it can't get further than
+    // that plus one frame of speeding up, and the broadphase margin covers
+    // getting pushed a little
+    bool wokeAny = false;
+    for (unsigned int i = 0; i < m_activeEntities.size(); i++) {
+        int slot = m_activeEntities[i]->slot();
+        double moveX = store->centerX(slot) - store->previousX(slot);
+        double moveY = store->centerY(slot) - store->previousY(slot);
+        double moved = std::sqrt(moveX * moveX + moveY * moveY);
+        if (store->stillFrames(slot) > 0 && moved < c_sleepSpeed)
+            continue;
+        double vx = store->velocityX(slot), vy = store->velocityY(slot);
+        double reach = store->radius(slot) + Utils::max(std::sqrt(vx * vx + vy * vy), moved) +
+                       store->speed(slot) + c_broadphaseMargin;
+        m_touched.clear();
+        store->index()->inRadius(m_touched, store->centerX(slot), store->centerY(slot), reach, store->layer(slot));
+        for (unsigned int j = 0; j < m_touched.size(); j++) {
+            int touched = store->slot(m_touched[j]);
+            if (store->asleep(touched)) {
+                store->wake(touched);
+                wokeAny = true;
+            }
+        }
+    }
+    if (! wokeAny)
+        return;
+    // keep them in the same order as m_entities, so it comes out the same
+    // no matter who woke who
+    m_activeEntities.clear();
+    for (unsigned int i = 0; i < m_entities.size(); i++) {
+        if (! m_entities[i]->isAsleep())
+            m_activeEntities.push_back(m_entities[i]);
+    }
+}
+
+void Gameplay::sleepIdle()
+{
+    EntityStore * store = EntityStore::instance();
+    int count = m_activeEntities.size();
+    for (int i = 0; i < count; i++) {
+        Entity * entity = m_activeEntities[i];
+        int slot = m_entitySlots[i];
+        double vx = store->velocityX(slot), vy = store->velocityY(slot);
+        Entity::MovementMode mode = entity->movementMode();
+        bool still = entity != m_player && ! entity->hasGoal() &&
+                     vx * vx + vy * vy < c_sleepSpeed * c_sleepSpeed &&
+                     (mode == Entity::Stand || mode == Entity::Walk || mode == Entity::Run) &&
+                     entity->currentSequence() == Entity::None && entity->altitude() == 0.0;
+        int & stillFrames = store->stillFrames(slot);
+        if (! still)
+            stillFrames = 0;
+        else if (stillFrames < c_sleepFrames)
+            stillFrames++;
+    }
+
+    // an island sleeps only once everything in it has been still long
+    // enough, otherwise it would be left leaning on a sleeper
+    m_islandAwake.assign(count, 0);
+    for (int i = 0; i < count; i++) {
+        if (store->stillFrames(m_entitySlots[i]) < c_sleepFrames)
+            m_islandAwake[m_broadphase.islandRoot(i)] = 1;
+    }
+    // group the sleepy islands by root, counting sort style
+    m_sleepStarts.assign(count + 1, 0);
+    for (int i = 0; i < count; i++) {
+        int root = m_broadphase.islandRoot(i);
+        if (! m_islandAwake[root])
+            m_sleepStarts[root + 1]++;
+    }
+    for (int i = 0; i < count; i++)
+        m_sleepStarts[i + 1] += m_sleepStarts[i];
+    int sleepers = m_sleepStarts[count];
+    if (sleepers == 0)
+        return;
+    m_sleepSlots.resize(sleepers);
+    for (int i = 0; i < count; i++) {
+        int root = m_broadphase.islandRoot(i);
+        if (! m_islandAwake[root])
+            m_sleepSlots[m_sleepStarts[root]++] = m_entitySlots[i];
+    }
+    // the placing moved each start up to the next one's
+    int start = 0;
+    for (int root = 0; root < count; root++) {
+        int end = m_sleepStarts[root];
+        if (end > start)
+            store->sleep(&m_sleepSlots[start], end - start);
+        start = end;
+    }
+}
+
+void Gameplay::wakeEntities(double x, double y, double radius, int layer)
+{
+    EntityStore * store = EntityStore::instance();
+    m_touched.clear();
+    store->index()->inRadius(m_touched, x, y, radius, layer);
+    for (unsigned int i = 0; i < m_touched.size(); i++)
+        store->wake(store->slot(m_touched[i]));
+}
+
 void Gameplay::applyInput(Entity * entity, bool takesInput)
 {
     // determin directional input
@@ -128,14 +437,17 @@ void Gameplay::applyInput(Entity * entity, bool takesInput)
     bool isFalling = false;
     bool affectedByFriction = false;
 
+    // entities without input head for their goal, if they have one
+    bool steers = !takesInput && entity->hasGoal();
+
     switch (entity->movementMode()) {
     case Entity::Stand:
     case Entity::Walk:
     case Entity::Run:
-        canChangeDirections = takesInput;
+        canChangeDirections = takesInput || steers;
         canStartJump = takesInput;
         canSwingSword = takesInput;
-        canMoveAround = takesInput;
+        canMoveAround = takesInput || steers;
         affectedByFriction = true;
         break;
     case Entity::JumpUp:
@@ -151,12 +463,24 @@ void Gameplay::applyInput(Entity * entity, bool takesInput)
     }
 
     if (canChangeDirections) {
-        int north = m_input->state(Input::North) ? 1 : 0;
-        int east = m_input->state(Input::East) ? 1 : 0;
-        int south = m_input->state(Input::South) ? 1 : 0;
-        int west = m_input->state(Input::West) ? 1 : 0;
-        int input_dx = east - west;
-        int input_dy = south - north;
+        int input_dx = 0, input_dy = 0;
+        if (takesInput) {
+            int north = m_input->state(Input::North) ? 1 : 0;
+            int east = m_input->state(Input::East) ? 1 : 0;
+            int south = m_input->state(Input::South) ? 1 : 0;
+            int west = m_input->state(Input::West) ? 1 : 0;
+            input_dx = east - west;
+            input_dy = south - north;
+        } else {
+            // the flow field only ever points at one of the 8 neighbors
+            double steerX, steerY;
+            if (m_flowFields->direction(entity->centerX(), entity->centerY(), entity->goalX(),
+                                        entity->goalY(), entity->layer(), steerX, steerY))
+            {
+                input_dx = steerX > 0.5 ? 1 : (steerX < -0.5 ? -1 : 0);
+                input_dy = steerY > 0.5 ? 1 : (steerY < -0.5 ? -1 : 0);
+            }
+        }
         Entity::Direction direction = (Entity::Direction)((input_dx + 1) + 3 * (input_dy + 1));
         if (direction != Entity::Center)
             entity->setOrientation(direction);
@@ -239,37 +563,277 @@ void Gameplay::applyInput(Entity * entity, bool takesInput)
     entity->setVelocity(dx, dy);
 }
 
-void Gameplay::resolveWithWorld(Entity * entity)
+void Gameplay::resolveIslandsJob(void * gameplay, int worker, int begin, int end)
+{
+    PROFILE_ZONE("Gameplay::resolveIslands");
+    Gameplay * self = (Gameplay *)gameplay;
+    std::vector<int> * islandStarts = self->m_broadphase.islandStarts();
+    EntityStore::instance()->resolveCollisions(self->m_pairSlots1, self->m_pairSlots2,
+                                               (*islandStarts)[begin], (*islandStarts)[end],
+                                               self->m_workerScratch[worker]->collisions);
+}
+
+void Gameplay::resolveWithWorldJob(void * gameplay, int worker, int begin, int end)
+{
+    // one zone for the whole chunk. one per entity would be thousands a frame
+    PROFILE_ZONE("Gameplay::resolveWithWorld");
+    Gameplay * self = (Gameplay *)gameplay;
+    for (int i = begin; i < end; i++)
+        self->resolveWithWorld(self->m_entitySlots[i], *self->m_workerScratch[worker]);
+}
+
+void Gameplay::castRays(World::Ray * rays, int count)
+{
+    m_rays = rays;
+    m_workers->run(castRaysJob, this, count, c_rayGrain);
+    m_rays = NULL;
+}
+
+bool Gameplay::lineOfSight(double fromX, double fromY, double toX, double toY, int layer,
+                           Tile::PhysicalPresence minPresence)
+{
+    World::Ray ray;
+    ray.fromX = fromX;
+    ray.fromY = fromY;
+    ray.toX = toX;
+    ray.toY = toY;
+    ray.layer = layer;
+    ray.minPresence = minPresence;
+    return !m_currentWorld->raycast(m_nearbyMaps, ray);
+}
+
+void Gameplay::castRaysJob(void * gameplay, int worker, int begin, int end)
+{
+    PROFILE_ZONE("Gameplay::castRays");
+    Gameplay * self = (Gameplay *)gameplay;
+    for (int i = begin; i < end; i++)
+        self->m_currentWorld->raycast(self->m_workerScratch[worker]->nearbyMaps, self->m_rays[i]);
+}
+
+void Gameplay::findTriggersJob(void * gameplay, int worker, int begin, int end)
+{
+    PROFILE_ZONE("Gameplay::findTriggers");
+    Gameplay * self = (Gameplay *)gameplay;
+    WorkerScratch & scratch = *self->m_workerScratch[worker];
+    EntityStore * store = EntityStore::instance();
+    World * world = self->m_currentWorld;
+    for (int i = begin; i < end; i++) {
+        int slot = self->m_entitySlots[i];
+        double x = store->centerX(slot), y = store->centerY(slot);
+        double radius = store->radius(slot);
+        scratch.placements.clear();
+        world->placementsIntersecting(scratch.placements, x - radius, y - radius, radius * 2.0, radius * 2.0);
+        for (unsigned int j = 0; j < scratch.placements.size(); j++) {
+            World::MapPlacement * placement = world->placement(scratch.placements[j]);
+            if (placement->map == NULL || placement->map->triggers()->size() == 0)
+                continue;
+            scratch.triggers.clear();
+            placement->map->triggersOverlapping(scratch.triggers, x, y, radius, store->shape(slot), store->layer(slot));
+            for (unsigned int k = 0; k < scratch.triggers.size(); k++) {
+                TriggerOverlap overlap;
+                overlap.entity = store->owner(slot);
+                overlap.handle = overlap.entity->handle();
+                overlap.placement = scratch.placements[j];
+                overlap.generation = placement->generation;
+                overlap.trigger = scratch.triggers[k];
+                scratch.triggerOverlaps.push_back(overlap);
+            }
+        }
+    }
+}
+
+void Gameplay::setTriggerHandler(TriggerHandler handler, void * context)
+{
+    m_triggerHandler = handler;
+    m_triggerContext = context;
+}
+
+void Gameplay::updateTriggers()
+{
+    for (unsigned int i = 0; i < m_workerScratch.size(); i++)
+        m_workerScratch[i]->triggerOverlaps.clear();
+    m_workers->run(findTriggersJob, this, m_entitySlots.size(), c_entityGrain);
+
+    PROFILE_ZONE("Gameplay::updateTriggers");
+    // the workers got the entities in no particular order. sorted, it comes
+    // out the same every time
+    m_newTriggerOverlaps.clear();
+    for (unsigned int i = 0; i < m_workerScratch.size(); i++) {
+        std::vector<TriggerOverlap> & found = m_workerScratch[i]->triggerOverlaps;
+        m_newTriggerOverlaps.insert(m_newTriggerOverlaps.end(), found.begin(), found.end());
+    }
+
+    for (unsigned int i = 0; i < m_entities.size(); i++) {
+        EntityStore::Handle handle = m_entities[i]->handle();
+        if (handle >= (int)m_handleFrames.size())
+            m_handleFrames.resize(handle + 1, -1);
+        m_handleFrames[handle] = m_frameCount;
+    }
+
+    // sleepers weren't looked at, but they haven't moved, so they're still
+    // in whatever they were in last frame
+    EntityStore * store = EntityStore::instance();
+    if (m_activeEntities.size() < m_entities.size()) {
+        for (unsigned int i = 0; i < m_triggerOverlaps.size(); i++) {
+            TriggerOverlap & overlap = m_triggerOverlaps[i];
+            if (overlap.handle < (int)m_handleFrames.size() && m_handleFrames[overlap.handle] == m_frameCount &&
+                store->owner(store->slot(overlap.handle)) == overlap.entity &&
+                store->asleep(store->slot(overlap.handle)) &&
+                m_currentWorld->placement(overlap.placement)->generation == overlap.generation)
+            {
+                m_newTriggerOverlaps.push_back(overlap);
+            }
+        }
+    }
+    std::sort(m_newTriggerOverlaps.begin(), m_newTriggerOverlaps.end(), triggerOverlapLessThan);
+
+    // go through both lists together. whatever is only in last frame's is
+    // an exit, only in this frame's an enter, and in both a stay
+    m_triggerEvents.clear();
+    unsigned int last = 0, now = 0;
+    while (last < m_triggerOverlaps.size() || now < m_newTriggerOverlaps.size()) {
+        if (now == m_newTriggerOverlaps.size() ||
+            (last < m_triggerOverlaps.size() && triggerOverlapLessThan(m_triggerOverlaps[last], m_newTriggerOverlaps[now])))
+        {
+            // nothing to send if the trigger or the entity streamed out
+            TriggerOverlap & overlap = m_triggerOverlaps[last++];
+            if (m_currentWorld->placement(overlap.placement)->generation == overlap.generation &&
+                overlap.handle < (int)m_handleFrames.size() && m_handleFrames[overlap.handle] == m_frameCount &&
+                store->owner(store->slot(overlap.handle)) == overlap.entity)
+            {
+                addTriggerEvent(teExit, overlap);
+            }
+        } else if (last == m_triggerOverlaps.size() ||
+                   triggerOverlapLessThan(m_newTriggerOverlaps[now], m_triggerOverlaps[last]))
+        {
+            addTriggerEvent(teEnter, m_newTriggerOverlaps[now++]);
+        } else {
+            // a handle gets reused when an entity goes away and another one
+            // shows up
+            bool same = m_newTriggerOverlaps[now].entity == m_triggerOverlaps[last].entity;
+            addTriggerEvent(same ? teStay : teEnter, m_newTriggerOverlaps[now++]);
+            last++;
+        }
+    }
+    m_triggerOverlaps.swap(m_newTriggerOverlaps);
+
+    if (m_triggerHandler != NULL && m_triggerEvents.size() > 0)
+        m_triggerHandler(m_triggerContext, &m_triggerEvents[0], m_triggerEvents.size());
+}
+
+bool Gameplay::triggerOverlapLessThan(const TriggerOverlap & overlap1, const TriggerOverlap & overlap2)
+{
+    if (overlap1.handle != overlap2.handle)
+        return overlap1.handle < overlap2.handle;
+    if (overlap1.placement != overlap2.placement)
+        return overlap1.placement < overlap2.placement;
+    if (overlap1.generation != overlap2.generation)
+        return overlap1.generation < overlap2.generation;
+    return overlap1.trigger < overlap2.trigger;
+}
+
+void Gameplay::addTriggerEvent(TriggerEventType type, const TriggerOverlap & overlap)
+{
+    TriggerEvent event;
+    event.type = type;
+    event.entity = overlap.entity;
+    event.map = m_currentWorld->placement(overlap.placement)->map;
+    event.trigger = overlap.trigger;
+    m_triggerEvents.push_back(event);
+}
+
+void Gameplay::resolveWithWorld(int slot, WorkerScratch & scratch)
 {
+    EntityStore * store = EntityStore::instance();
     // calculate the desired location
-    double dx = entity->velocityX();
-    double dy = entity->velocityY();
-    double x = entity->centerX() + dx;
-    double y = entity->centerY() + dy;
-    double radius = entity->radius();
-    int layer = entity->layer();
+    double centerX = store->centerX(slot), centerY = store->centerY(slot);
+    double x = centerX + store->velocityX(slot);
+    double y = centerY + store->velocityY(slot);
+    double radius = store->radius(slot);
+    int layer = store->layer(slot);
+    Tile::PhysicalPresence minPhysicalPresence = Entity::minPhysicalPresence((Entity::MovementMode)store->movementMode(slot));
+
+    // only checking where it ends up would let it skip over a wall
+    double dx = x - centerX, dy = y - centerY;
+    if (dx * dx + dy * dy > Physics::sweepDistance * Physics::sweepDistance)
+        sweepWithWorld(centerX, centerY, x, y, radius, layer, minPhysicalPresence, scratch);
 
     // resolve collisions
-    std::vector<Map::TileAndLocation> tiles;
-    Tile::PhysicalPresence minPhysicalPresence = entity->minPhysicalPresence();
-    for (unsigned int i = 0; i < m_loadedMapsCache.size(); i++)
-        m_loadedMapsCache[i]->intersectingTiles(tiles, x, y, radius, layer, minPhysicalPresence);
+    Map::TileList tiles(ArenaAllocator<Map::TileAndLocation>(&scratch.arena));
+    tiles.reserve(c_tileListReserve);
+    findNearbyMaps(scratch.nearbyMaps, x - radius, y - radius, radius * 2.0, radius * 2.0);
+    for (unsigned int i = 0; i < scratch.nearbyMaps.size(); i++)
+        scratch.nearbyMaps[i]->intersectingTiles(tiles, x, y, radius, layer, minPhysicalPresence);
     // sort by proximity
     sortByProximity(x, y, tiles);
     // resolve collisions
     for (unsigned int i = 0; i < tiles.size(); i++)
         tiles[i].tile->resolveCircleCollision(tiles[i].x, tiles[i].y, x, y, radius);
 
-    // calculate real dx, dy
-    dx = x - entity->centerX();
-    dy = y - entity->centerY();
-    // apply new location
-    entity->setCenter(x, y);
     // store velocity for next frame
-    entity->setVelocity(dx, dy);
+    store->velocityX(slot) = x - centerX;
+    store->velocityY(slot) = y - centerY;
+    // apply new location, remembering the old one for drawing
+    store->previousX(slot) = centerX;
+    store->previousY(slot) = centerY;
+    store->centerX(slot) = x;
+    store->centerY(slot) = y;
+}
+
+void Gameplay::sweepWithWorld(double fromX, double fromY, double & x, double & y, double radius, int layer,
+                              Tile::PhysicalPresence minPhysicalPresence, WorkerScratch & scratch)
+{
+    // everything it could touch on the way, sliding included, is within
+    // the length of the move of where it starts
+    double dx = x - fromX, dy = y - fromY;
+    double reach = radius + std::sqrt(dx * dx + dy * dy);
+    Map::TileList tiles(ArenaAllocator<Map::TileAndLocation>(&scratch.arena));
+    tiles.reserve(c_tileListReserve);
+    findNearbyMaps(scratch.nearbyMaps, fromX - reach, fromY - reach, reach * 2.0, reach * 2.0);
+    for (unsigned int i = 0; i < scratch.nearbyMaps.size(); i++)
+        scratch.nearbyMaps[i]->intersectingTiles(tiles, fromX, fromY, reach, layer, minPhysicalPresence);
+
+    for (int pass = 0; pass < c_sweepPasses; pass++) {
+        double first = 1.0, normalX = 0.0, normalY = 0.0;
+        double graze = -c_sweepGraze * std::sqrt(dx * dx + dy * dy);
+        bool hit = false;
+        for (unsigned int i = 0; i < tiles.size(); i++) {
+            double t, nx, ny;
+            if (tiles[i].tile->sweepCircle(tiles[i].x, tiles[i].y, fromX, fromY, dx, dy, radius, t, nx, ny) &&
+                t < first && dx * nx + dy * ny < graze)
+            {
+                hit = true;
+                first = t;
+                normalX = nx;
+                normalY = ny;
+            }
+        }
+        if (! hit)
+            break;
+        // move up to it, then whatever is left of the move that isn't into
+        // it goes along it
+        fromX += dx * first;
+        fromY += dy * first;
+        if (pass == c_sweepPasses - 1) {
+            dx = dy = 0.0;
+            break;
+        }
+        double restX = dx * (1.0 - first), restY = dy * (1.0 - first);
+        double into = restX * normalX + restY * normalY;
+        dx = restX - into * normalX;
+        dy = restY - into * normalY;
+    }
+    x = fromX + dx;
+    y = fromY + dy;
 }
 
-void Gameplay::sortByProximity(double x, double y, std::vector<Map::TileAndLocation> & tiles)
+void Gameplay::findNearbyMaps(std::vector<Map*> & nearbyMaps, double left, double top, double width, double height)
+{
+    nearbyMaps.clear();
+    m_currentWorld->mapsIntersecting(nearbyMaps, left, top, width, height);
+}
+
+void Gameplay::sortByProximity(double x, double y, Map::TileList & tiles)
 {
     // TODO: code duplication
     if (tiles.size() == 0)
@@ -291,53 +855,88 @@ void Gameplay::sortByProximity(double x, double y, std::vector<Map::TileAndLocat
     }
 }
 
-void Gameplay::sortByCenterY(std::vector<Entity *> & entities)
+void Gameplay::updateDisplay()
 {
-    // TODO: code duplication
-    if (entities.size() == 0)
-        return; // we have to check for this because of stupid unsigned int size;
-    // selection sort
-    for (unsigned int i = 0; i < entities.size() - 1; i++) {
-        unsigned int minIndex = i;
-        for (unsigned int j = i + 1; j < entities.size(); j++) {
-            if (entities[j]->centerY() < entities[minIndex]->centerY())
-                minIndex = j;
-        }
-        if (minIndex != i) {
-            Entity * tmp = entities[i];
-            entities[i] = entities[minIndex];
-            entities[minIndex] = tmp;
-        }
-    }
+    PROFILE_ZONE("Gameplay::updateDisplay");
+    if (m_screen == NULL)
+        return; // headless
+
+    recordFrame(&m_commands);
+    m_backend->render(&m_commands, m_interpolation);
 }
 
-void Gameplay::updateDisplay()
+void Gameplay::recordFrame(RenderCommandBuffer * commands)
 {
-    // generic background color
-    m_screen->Clear();
+    PROFILE_ZONE("Gameplay::recordFrame");
+    commands->clear();
+    double previousScreenX = m_screenX - m_screenVelocityX;
+    double previousScreenY = m_screenY - m_screenVelocityY;
+    commands->setCamera(previousScreenX, previousScreenY, m_screenX, m_screenY);
+    commands->setTime(m_frameCount, m_fps);
+
+    // the screen gets drawn anywhere between last frame and this one, so
+    // include everything that's on screen in either
+    double screenX = Utils::min(previousScreenX, m_screenX);
+    double screenY = Utils::min(previousScreenY, m_screenY);
+    double width = screenWidth() + std::fabs(m_screenVelocityX);
+    double height = screenHeight() + std::fabs(m_screenVelocityY);
+
+    // only the maps on screen get drawn
+    findNearbyMaps(m_nearbyMaps, screenX, screenY, width, height);
+
+    m_drawQueue.update(m_entities);
 
     // find layer count
-    int layerCount = 0;
-    for (unsigned int i = 0; i < m_loadedMapsCache.size(); i++)
-        layerCount = Utils::max(layerCount, m_loadedMapsCache[i]->layerCount());
+    int layerCount = m_drawQueue.layerCount();
+    for (unsigned int i = 0; i < m_nearbyMaps.size(); i++)
+        layerCount = Utils::max(layerCount, m_nearbyMaps[i]->layerCount());
     for (int layer = 0; layer < layerCount; layer++) {
-        for (unsigned int i = 0; i < m_loadedMapsCache.size(); i++) {
-            Map * map = m_loadedMapsCache[i];
+        commands->beginLayer(layer);
+        for (unsigned int i = 0; i < m_nearbyMaps.size(); i++) {
+            Map * map = m_nearbyMaps[i];
             if (layer < map->layerCount())
-                map->draw(m_screenX, m_screenY, screenWidth(), screenHeight(), layer);
+                map->draw(commands, screenX, screenY, width, height, layer);
         }
-        // TODO: cache entities on each layer
-        std::vector<Entity *> entities;
-        for (unsigned int i = 0; i < m_entities.size(); i++)
-            if (m_entities[i]->layer() == layer)
-                entities.push_back(m_entities[i]);
-        sortByCenterY(entities);
-        for (unsigned int i = 0; i < entities.size(); i++)
-            entities[i]->draw(m_screenX, m_screenY);
+        m_drawQueue.draw(commands, layer, m_nearbyMaps, screenX, screenY, width, height);
+    }
+}
+
+unsigned long long Gameplay::stateHash()
+{
+    // FNV-1a over the raw bytes of the state
+    unsigned long long hash = 14695981039346656037ULL;
+    std::vector<double> values;
+    values.push_back(m_frameCount);
+    values.push_back(m_screenX);
+    values.push_back(m_screenY);
+    std::vector<Entity *> entities;
+    entities.push_back(m_player);
+    for (int i = 0; i < m_currentWorld->mapCount(); i++) {
+        Map * map = m_currentWorld->placement(i)->map;
+        if (map == NULL)
+            continue;
+        entities.insert(entities.end(), map->entities()->begin(), map->entities()->end());
+    }
+    for (unsigned int i = 0; i < entities.size(); i++) {
+        Entity * entity = entities[i];
+        values.push_back(entity->centerX());
+        values.push_back(entity->centerY());
+        values.push_back(entity->velocityX());
+        values.push_back(entity->velocityY());
+        values.push_back(entity->altitude());
+        values.push_back(entity->movementMode());
+        values.push_back(entity->orientation());
+        values.push_back(entity->layer());
+    }
+    const unsigned char * bytes = (const unsigned char *)&values[0];
+    for (unsigned int i = 0; i < values.size() * sizeof(double); i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
     }
+    return hash;
 }
 
 int Gameplay::fps()
 {
-    return m_window->fps();
+    return m_fps;
 }
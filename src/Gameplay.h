@@ -8,11 +8,23 @@
 #include "ResourceFile.h"
 #include "Debug.h"
 #include "Map.h"
+#include "World.h"
 #include "Input.h"
+#include "Broadphase.h"
+#include "EntityStore.h"
+#include "FrameArena.h"
+#include "DrawQueue.h"
+#include "RenderCommandBuffer.h"
+#include "RenderBackend.h"
 
 #include <set>
 
 class MainWindow;
+class WorldStreamer;
+class WorkerPool;
+class InputRecording;
+class Pathfinder;
+class FlowFields;
 
 class Gameplay
 {
@@ -20,48 +32,229 @@ public:
     static inline Gameplay * instance();
 
     Gameplay(MainWindow * owner);
+    // without a window. nothing gets drawn and input is scripted; see input()
+    Gameplay(std::string resourceFile, int fps);
     ~Gameplay();
 
     bool isGood();
 
     inline long long int frameCount();
     int fps();
+    // how far updateDisplay draws between the last two logic frames, from 0
+    // (the one before) to 1 (the latest). the main loop sets it before
+    // drawing, since it runs logic frames at a fixed rate no matter how
+    // often it draws.
+    inline double interpolation();
+    inline void setInterpolation(double value);
+    // NULL when there's no window
     inline sf::RenderWindow * screen();
+    inline Input * input();
+    // NULL unless the input is being played back from a file
+    inline InputRecording * replay();
+
+    // hash of everything the simulation has decided so far. two runs that
+    // got the same input should end up with the same hash.
+    unsigned long long stateHash();
+
+    // how many times the last frame (logic and drawing) touched the heap.
+    // should be 0 when nothing is streaming in or out
+    inline long long heapAllocationsLastFrame();
+    inline Broadphase * broadphase();
+    inline WorkerPool * workers();
+    // how many of the entities in memory were simulated last frame, and how
+    // many were asleep. see Entity::isAsleep
+    inline int activeEntityCount();
+    inline int sleepingEntityCount();
 
     inline double screenWidth();
     inline double screenHeight();
 
+    // keeps the maps near the player in memory
+    inline WorldStreamer * streamer();
+    // paths for things that walk, in the current world
+    inline Pathfinder * pathfinder();
+    // steering for crowds heading to the same place. entities with a goal
+    // follow these
+    inline FlowFields * flowFields();
+
+    // draw the current frame on the screen
     void updateDisplay();
+    // record everything updateDisplay would draw, for drawing somewhere else
+    void recordFrame(RenderCommandBuffer * commands);
     void nextFrame();
+
+    // cast a batch of rays against the current world on the worker threads,
+    // for when lots of things want to look around in the same frame. not
+    // from inside another job
+    void castRays(World::Ray * rays, int count);
+    // true if nothing that sticks up at least minPresence is in the way
+    bool lineOfSight(double fromX, double fromY, double toX, double toY, int layer,
+                     Tile::PhysicalPresence minPresence);
+    // wake up everything on layer that overlaps the circle, and whatever is
+    // asleep touching them
+    void wakeEntities(double x, double y, double radius, int layer);
+
+    enum TriggerEventType {
+        teEnter,
+        teStay,
+        teExit,
+    };
+    // something that happened between an entity and a trigger this frame
+    typedef struct {
+        TriggerEventType type;
+        Entity * entity;
+        Map * map;
+        // index into map->triggers()
+        int trigger;
+    } TriggerEvent;
+    typedef void (*TriggerHandler)(void * context, TriggerEvent * events, int count);
+    // every frame, once the physics is done, the handler gets all of the
+    // frame's trigger events at once, sorted by entity. the same batch is
+    // in triggerEvents until the next frame. entities that stream out
+    // with their map don't get exit events
+    void setTriggerHandler(TriggerHandler handler, void * context);
+    std::vector<TriggerEvent> * triggerEvents() { return &m_triggerEvents; }
 private: //variables
     static const char * ResourceFilePath;
     static Gameplay * s_inst;
+    // how far past its bounds an entity can be pushed by another one and
+    // still bump into whatever it gets pushed into this frame
+    static const double c_broadphaseMargin;
+    // how many islands / entities a worker grabs at a time
+    static const int c_islandGrain;
+    static const int c_entityGrain;
+    static const int c_rayGrain;
+    // most entities touch fewer tiles than this
+    static const int c_tileListReserve;
+    // an entity that moves slower than this for this many frames in a row
+    // goes to sleep, once everything touching it has too
+    static const double c_sleepSpeed;
+    static const int c_sleepFrames;
+    // how many times a swept entity can hit something and slide along it in
+    // one frame before it just stops
+    static const int c_sweepPasses;
+    // hits where less than this fraction of the move goes into the surface
+    // are grazes, like brushing the corner where two walls meet while
+    // sliding along them. they don't stop anything, and the little bit of
+    // overlap they leave is for resolveCircleCollision
+    static const double c_sweepGraze;
 
-    static void sortByProximity(double x, double y, std::vector<Map::TileAndLocation> & tiles);
-    static void sortByCenterY(std::vector<Entity *> & entities);
+    static void sortByProximity(double x, double y, Map::TileList & tiles);
 
 
     bool m_good;
     sf::RenderWindow * m_screen;
+    int m_fps;
     int m_interval;
     long long int m_frameCount;
+    double m_interpolation;
 
     double m_screenX, m_screenY;
+    // how far the screen scrolled last frame
+    double m_screenVelocityX, m_screenVelocityY;
 
     Universe * m_universe;
 
     World * m_currentWorld;
-    std::set<Map*> m_loadedMaps;
+    WorldStreamer * m_streamer;
+    Pathfinder * m_pathfinder;
+    FlowFields * m_flowFields;
     std::vector<Map*> m_loadedMapsCache;
+    // scratch space for spatial queries against the current world
+    std::vector<Map*> m_nearbyMaps;
+    // everything in memory, asleep or not
     std::vector<Entity*> m_entities;
+    // the ones being simulated this frame, and where they are in the
+    // EntityStore
+    std::vector<Entity*> m_activeEntities;
+    std::vector<int> m_entitySlots;
+    bool m_sleepEnabled;
+    // scratch for waking entities and putting them to sleep
+    std::vector<EntityStore::Handle> m_touched;
+    std::vector<char> m_islandAwake;
+    std::vector<int> m_sleepStarts, m_sleepSlots;
+    // the broadphase pairs as slots, island by island
+    std::vector<int> m_pairSlots1, m_pairSlots2;
     Entity * m_player;
 
+    // finds the pairs of entities that might collide
+    Broadphase m_broadphase;
+    // what order to draw the entities in
+    DrawQueue m_drawQueue;
+    // what updateDisplay draws, and what it draws with. no backend when
+    // there's no window
+    RenderCommandBuffer m_commands;
+    RenderBackend * m_backend;
+
+    // the physics runs on these. islands don't share entities, and world
+    // collision only touches its own entity, so the results are the same
+    // no matter how many threads there are.
+    WorkerPool * m_workers;
+    // an entity in a trigger. placement and generation say which map the
+    // trigger is in, since a map that streams out and back in is a new map
+    typedef struct {
+        EntityStore::Handle handle;
+        Entity * entity;
+        int placement, generation, trigger;
+    } TriggerOverlap;
+    typedef struct {
+        std::vector<Map*> nearbyMaps;
+        std::vector<int> placements;
+        std::vector<int> triggers;
+        std::vector<TriggerOverlap> triggerOverlaps;
+        EntityStore::CollisionScratch collisions;
+        FrameArena arena;
+    } WorkerScratch;
+    std::vector<WorkerScratch *> m_workerScratch;
+    // the batch castRays is working on
+    World::Ray * m_rays;
+
+    // which entities were in which triggers, last frame and this one,
+    // sorted
+    std::vector<TriggerOverlap> m_triggerOverlaps;
+    std::vector<TriggerOverlap> m_newTriggerOverlaps;
+    std::vector<TriggerEvent> m_triggerEvents;
+    TriggerHandler m_triggerHandler;
+    void * m_triggerContext;
+    // which handles belong to entities that are around this frame
+    std::vector<long long> m_handleFrames;
+
+    // heap allocations between the starts of the last two frames
+    long long m_heapAllocationsLastFrame;
+    long long m_heapAllocationsAtFrameStart;
+
     MainWindow * m_window;
     Input * m_input;
+    // --record and --replay. the recording is saved when gameplay ends
+    InputRecording * m_recording;
+    InputRecording * m_replay;
 
 private: //methods
+    void initialize(std::string resourceFile);
     void applyInput(Entity * entity, bool takesInput);
-    void resolveWithWorld(Entity * entity);
+    // wake whatever is asleep where something awake might get to this frame
+    void wakeTouched();
+    // count the frames each active entity has been still, and put islands
+    // that have all been still long enough to sleep
+    void sleepIdle();
+    void resolveWithWorld(int slot, WorkerScratch & scratch);
+    // follow a fast entity from where it is to x, y, stopping it at the
+    // first tile in the way and sliding it along. x, y gets where it ends up
+    void sweepWithWorld(double fromX, double fromY, double & x, double & y, double radius, int layer,
+                        Tile::PhysicalPresence minPhysicalPresence, WorkerScratch & scratch);
+    // fill nearbyMaps with the resident maps that intersect the rectangle
+    void findNearbyMaps(std::vector<Map*> & nearbyMaps, double left, double top, double width, double height);
+
+    // WorkerPool jobs
+    static void resolveIslandsJob(void * gameplay, int worker, int begin, int end);
+    static void resolveWithWorldJob(void * gameplay, int worker, int begin, int end);
+    static void castRaysJob(void * gameplay, int worker, int begin, int end);
+    static void findTriggersJob(void * gameplay, int worker, int begin, int end);
+
+    // find out who is in which trigger now, and send out the events
+    void updateTriggers();
+    static bool triggerOverlapLessThan(const TriggerOverlap & overlap1, const TriggerOverlap & overlap2);
+    void addTriggerEvent(TriggerEventType type, const TriggerOverlap & overlap);
 
     double minMarginNorth() { return 250.0; }
     double minMarginEast() { return 350.0; }
@@ -76,16 +269,76 @@ inline Gameplay * Gameplay::instance()
     return s_inst;
 }
 
+inline int Gameplay::activeEntityCount()
+{
+    return m_activeEntities.size();
+}
+
+inline int Gameplay::sleepingEntityCount()
+{
+    return m_entities.size() - m_activeEntities.size();
+}
+
 inline long long int Gameplay::frameCount()
 {
     return m_frameCount;
 }
 
+inline double Gameplay::interpolation()
+{
+    return m_interpolation;
+}
+
+inline void Gameplay::setInterpolation(double value)
+{
+    m_interpolation = value;
+}
+
 inline sf::RenderWindow * Gameplay::screen()
 {
     return m_screen;
 }
 
+inline Input * Gameplay::input()
+{
+    return m_input;
+}
+
+inline long long Gameplay::heapAllocationsLastFrame()
+{
+    return m_heapAllocationsLastFrame;
+}
+
+inline InputRecording * Gameplay::replay()
+{
+    return m_replay;
+}
+
+inline Broadphase * Gameplay::broadphase()
+{
+    return &m_broadphase;
+}
+
+inline WorkerPool * Gameplay::workers()
+{
+    return m_workers;
+}
+
+inline WorldStreamer * Gameplay::streamer()
+{
+    return m_streamer;
+}
+
+inline Pathfinder * Gameplay::pathfinder()
+{
+    return m_pathfinder;
+}
+
+inline FlowFields * Gameplay::flowFields()
+{
+    return m_flowFields;
+}
+
 inline double Gameplay::screenWidth()
 {
     return 800.0;
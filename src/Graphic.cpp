@@ -1,11 +1,13 @@
 #include "Graphic.h"
 
-#include "Gameplay.h"
 #include "Utils.h"
 #include "Debug.h"
 
 #include <cmath>
 
+bool Graphic::s_decodeImages = true;
+int Graphic::s_nextTexture = 0;
+
 Graphic * Graphic::load(const char * buffer)
 {
 
@@ -23,6 +25,7 @@ Graphic * Graphic::load(const char * buffer)
     Header * header = Utils::readStruct<Header>(&buffer);
 
     Graphic * out = new Graphic();
+    out->m_texture = s_nextTexture++;
 
     out->m_frameCount = header->frameCount;
     out->m_fps = header->framesPerSecond;
@@ -33,10 +36,13 @@ Graphic * Graphic::load(const char * buffer)
         return NULL;
     }
 
-    if (storageType == stBMP || storageType == stPNG) {
+    if (storageType != stBMP && storageType != stPNG) {
+        std::cerr << "unknown storageType: " << storageType << std::endl;
+        delete out;
+        return NULL;
+    } else if (s_decodeImages) {
         // initialize
         out->m_image = new sf::Image();
-        out->m_spriteSheet = new sf::Sprite();
 
         // load the .bmp
         bool good = out->m_image->LoadFromMemory(buffer, header->imageSize);
@@ -48,11 +54,6 @@ Graphic * Graphic::load(const char * buffer)
         }
 
         out->m_image->CreateMaskFromColor(sf::Color(colorKey->r, colorKey->g, colorKey->b));
-
-        out->m_spriteSheet->SetImage(*out->m_image);
-    } else {
-        std::cerr << "unknown storageType: " << storageType << std::endl;
-        return NULL;
     }
 
     // generate a rectangle for each frame
@@ -70,7 +71,7 @@ Graphic * Graphic::load(const char * buffer)
 
 Graphic::Graphic() :
     m_image(NULL),
-    m_spriteSheet(NULL),
+    m_texture(-1),
     m_frameCount(1),
     m_fps(1),
     m_offset(0),
@@ -81,37 +82,11 @@ Graphic::Graphic() :
 Graphic::~Graphic()
 {
     delete m_image;
-    delete m_spriteSheet;
-}
-
-// calculate which frame to draw
-int Graphic::currentFrame()
-{
-    return (Gameplay::instance()->frameCount() * m_fps / Gameplay::instance()->fps() + m_offset) % m_frameCount;
-}
-
-void Graphic::draw(sf::RenderWindow * dest, int x, int y)
-{
-    int frame = currentFrame();
-
-    sf::IntRect destRect;
-    destRect.Left = x;
-    destRect.Top = y;
-    destRect.Right = x + m_spriteBounds[frame].GetWidth();
-    destRect.Bottom = y + m_spriteBounds[frame].GetHeight();
-
-    draw(dest, destRect);
 }
 
-void Graphic::draw(sf::RenderWindow * dest, const sf::IntRect & destRect)
+int Graphic::frameAt(double time, int fps)
 {
-    int frame = currentFrame();
-
-    m_spriteSheet->SetPosition(destRect.Left, destRect.Top);
-    m_spriteSheet->SetScale(destRect.GetWidth() / (float) m_spriteBounds[frame].GetWidth(),
-                           destRect.GetHeight() / (float) m_spriteBounds[frame].GetHeight());
-    m_spriteSheet->SetSubRect(m_spriteBounds[frame]);
-    dest->Draw(*m_spriteSheet);
+    return ((long long int)(time * m_fps / fps) + m_offset) % m_frameCount;
 }
 
 int Graphic::width()
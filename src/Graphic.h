@@ -24,17 +24,31 @@ public: //methods
     // NULL if there was a problem.
     static Graphic * load(const char * buffer);
 
+    // when false, load skips decoding the image and image() is NULL.
+    // for running without a display.
+    static void setDecodeImages(bool value) { s_decodeImages = value; }
+
     ~Graphic();
 
-    // draw to a surface
-    void draw(sf::RenderWindow * dest, const sf::IntRect & destRect);
-    void draw(sf::RenderWindow * dest, int x, int y);
+    // which frame of the animation shows after time logic frames, when
+    // there are fps logic frames per second
+    int frameAt(double time, int fps);
+    // where a frame is in the image
+    const sf::IntRect & frameBounds(int frame) { return m_spriteBounds[frame]; }
+
+    // every graphic has its own image, numbered in the order they loaded.
+    // see RenderCommandBuffer
+    int texture() { return m_texture; }
+    sf::Image * image() { return m_image; }
 
     // get the size
     int width();
     int height();
 
 private: //variables
+    static bool s_decodeImages;
+    static int s_nextTexture;
+
     /*  storage format:
         Uint32 GraphicType
         Uint32 StorageType
@@ -58,7 +72,7 @@ private: //variables
     } Header;
 
     sf::Image * m_image;
-    sf::Sprite * m_spriteSheet;
+    int m_texture;
     int m_frameCount;
     int m_fps;
     int m_offset;
@@ -67,8 +81,6 @@ private: //variables
 
 private: //methods
     Graphic();
-
-    int currentFrame();
 };
 
 #endif
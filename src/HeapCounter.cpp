@@ -0,0 +1,13 @@
+#include "HeapCounter.h"
+
+static volatile long long s_allocationCount = 0;
+
+long long HeapCounter::allocationCount()
+{
+    return __sync_fetch_and_add(&s_allocationCount, 0);
+}
+
+void HeapCounter::countAllocation()
+{
+    __sync_fetch_and_add(&s_allocationCount, 1);
+}
@@ -0,0 +1,18 @@
+#ifndef _HEAP_COUNTER_H_
+#define _HEAP_COUNTER_H_
+
+// HeapCounter counts calls to operator new, so we can check that a frame
+// doesn't touch the heap. the counting operator new lives in
+// HeapCounterHooks.cpp, which only the game, the headless loop and the
+// benchmarks link. everywhere else, and in RELEASE builds, allocationCount
+// is always 0.
+namespace HeapCounter
+{
+    // allocations since the program started, on all threads
+    long long allocationCount();
+
+    // called by the counting operator new
+    void countAllocation();
+}
+
+#endif
@@ -0,0 +1,43 @@
+#include "HeapCounter.h"
+#include "version.h"
+
+#include <new>
+#include <cstdlib>
+
+#ifndef RELEASE
+
+// dynamic exception specifications are gone in C++17
+#if __cplusplus >= 201103L
+#define THROWS_BAD_ALLOC
+#define THROWS_NOTHING noexcept
+#else
+#define THROWS_BAD_ALLOC throw(std::bad_alloc)
+#define THROWS_NOTHING throw()
+#endif
+
+// replacements for the global allocation functions that count
+void * operator new(std::size_t size) THROWS_BAD_ALLOC
+{
+    HeapCounter::countAllocation();
+    void * memory = std::malloc(size == 0 ? 1 : size);
+    if (memory == NULL)
+        throw std::bad_alloc();
+    return memory;
+}
+
+void * operator new[](std::size_t size) THROWS_BAD_ALLOC
+{
+    return operator new(size);
+}
+
+void operator delete(void * memory) THROWS_NOTHING
+{
+    std::free(memory);
+}
+
+void operator delete[](void * memory) THROWS_NOTHING
+{
+    std::free(memory);
+}
+
+#endif
@@ -2,14 +2,31 @@
 
 #include "Utils.h"
 #include "Config.h"
+#include "InputRecording.h"
 
 Input::Input(const sf::Input & input) :
-    m_input(input)
+    m_input(&input),
+    m_recorder(NULL),
+    m_replay(NULL)
+{
+    initialize();
+}
+
+Input::Input() :
+    m_input(NULL),
+    m_recorder(NULL),
+    m_replay(NULL)
+{
+    initialize();
+}
+
+void Input::initialize()
 {
     // clear to 0
     for (int k=0; k<InputActionCount; ++k) {
         m_state[k] = false;
         m_lastState[k] = false;
+        m_scriptedState[k] = false;
         m_map[k] = (Input::KeyCode) -1;
     }
 
@@ -35,8 +52,24 @@ bool Input::justPressed(Action key)
 
 void Input::refresh()
 {
+    int replayMask = m_replay != NULL ? m_replay->next() : 0;
+    int mask = 0;
     for (int k = 0; k < InputActionCount; ++k) {
         m_lastState[k] = m_state[k];
-        m_state[k] = m_input.IsKeyDown((sf::Key::Code)m_map[k]);
+        if (m_replay != NULL)
+            m_state[k] = (replayMask & (1 << k)) != 0;
+        else if (m_input != NULL)
+            m_state[k] = m_input->IsKeyDown((sf::Key::Code)m_map[k]);
+        else
+            m_state[k] = m_scriptedState[k];
+        if (m_state[k])
+            mask |= 1 << k;
     }
+    if (m_recorder != NULL)
+        m_recorder->append(mask);
+}
+
+void Input::setState(Action key, bool down)
+{
+    m_scriptedState[key] = down;
 }
@@ -6,10 +6,14 @@
 
 #include <SFML/Window.hpp>
 
+class InputRecording;
+
 // Input maps KeyCodes to InputActions
 class Input {
 public:
     Input(const sf::Input & input);
+    // scripted input that isn't connected to a keyboard. see setState
+    Input();
 
     enum Action {
         // Movement
@@ -137,12 +141,29 @@ public:
     // whether a key has just been pressed (like a key-down event).
     bool justPressed(Action key);
 
+    // for scripted input: hold a key down or let it go. takes effect at the
+    // next refresh.
+    void setState(Action key, bool down);
+
+    // append every frame's state to a recording. NULL to stop
+    void setRecorder(InputRecording * recording) { m_recorder = recording; }
+    // take the state from a recording instead of the keyboard or the script.
+    // once the recording runs out, nothing is pressed. NULL to stop
+    void setReplay(InputRecording * recording) { m_replay = recording; }
+
 private:
     bool m_state[InputActionCount];
     bool m_lastState[InputActionCount];
+    bool m_scriptedState[InputActionCount];
     KeyCode m_map[InputActionCount];
 
-    const sf::Input & m_input;
+    // NULL for scripted input
+    const sf::Input * m_input;
+    InputRecording * m_recorder;
+    InputRecording * m_replay;
+
+private:
+    void initialize();
 };
 
 #endif
@@ -0,0 +1,117 @@
+#include "InputRecording.h"
+
+#include "Utils.h"
+
+#include <fstream>
+#include <iterator>
+
+const int InputRecording::c_version = 1;
+
+InputRecording::InputRecording() :
+    m_runs(),
+    m_frameCount(0),
+    m_playRun(0),
+    m_playOffset(0),
+    m_playFrame(0)
+{
+}
+
+bool InputRecording::load(std::string filename)
+{
+    std::ifstream in(filename.c_str(), std::ios::in | std::ios::binary);
+    if (! in.good()) {
+        std::cerr << "Unable to open input recording " << filename << std::endl;
+        return false;
+    }
+    std::vector<char> buffer((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    const int headerSize = 3 * sizeof(int);
+    const int runSize = sizeof(char) + sizeof(int);
+    if ((int)buffer.size() < headerSize) {
+        std::cerr << "Input recording " << filename << " is truncated" << std::endl;
+        return false;
+    }
+
+    const char * cursor = &buffer[0];
+    int version = Utils::readInt(&cursor);
+    if (version != c_version) {
+        std::cerr << "Unsupported input recording version: " << version << std::endl;
+        return false;
+    }
+    int frameCount = Utils::readInt(&cursor);
+    int runCount = Utils::readInt(&cursor);
+    if (runCount < 0 || (int)buffer.size() != headerSize + runCount * runSize) {
+        std::cerr << "Input recording " << filename << " is truncated" << std::endl;
+        return false;
+    }
+
+    m_runs.clear();
+    m_frameCount = 0;
+    for (int i = 0; i < runCount; i++) {
+        Run run;
+        run.mask = (unsigned char)*cursor;
+        cursor += sizeof(char);
+        run.count = Utils::readInt(&cursor);
+        m_runs.push_back(run);
+        m_frameCount += run.count;
+    }
+    if (m_frameCount != frameCount) {
+        std::cerr << "Input recording " << filename << " is corrupt" << std::endl;
+        m_runs.clear();
+        m_frameCount = 0;
+        return false;
+    }
+    rewind();
+    return true;
+}
+
+bool InputRecording::save(std::string filename)
+{
+    std::ofstream out(filename.c_str(), std::ios::out | std::ios::binary);
+    if (! out.good()) {
+        std::cerr << "Unable to write input recording " << filename << std::endl;
+        return false;
+    }
+    int runCount = m_runs.size();
+    out.write((const char *)&c_version, sizeof(int));
+    out.write((const char *)&m_frameCount, sizeof(int));
+    out.write((const char *)&runCount, sizeof(int));
+    for (int i = 0; i < runCount; i++) {
+        char mask = (char)m_runs[i].mask;
+        out.write(&mask, sizeof(char));
+        out.write((const char *)&m_runs[i].count, sizeof(int));
+    }
+    return out.good();
+}
+
+void InputRecording::append(int mask)
+{
+    if (m_runs.size() > 0 && m_runs.back().mask == mask) {
+        m_runs.back().count++;
+    } else {
+        Run run;
+        run.mask = mask;
+        run.count = 1;
+        m_runs.push_back(run);
+    }
+    m_frameCount++;
+}
+
+int InputRecording::next()
+{
+    if (m_playRun >= m_runs.size())
+        return 0;
+    int mask = m_runs[m_playRun].mask;
+    m_playFrame++;
+    if (++m_playOffset >= m_runs[m_playRun].count) {
+        m_playRun++;
+        m_playOffset = 0;
+    }
+    return mask;
+}
+
+void InputRecording::rewind()
+{
+    m_playRun = 0;
+    m_playOffset = 0;
+    m_playFrame = 0;
+}
@@ -0,0 +1,55 @@
+#ifndef _INPUT_RECORDING_H_
+#define _INPUT_RECORDING_H_
+
+#include <vector>
+#include <string>
+
+// InputRecording is a record of which Input::Actions were held down on each
+// frame. each frame is a bit mask (bit n is action n), and runs of
+// identical frames are stored once with a count, so holding a direction for
+// a few seconds costs a handful of bytes.
+class InputRecording
+{
+public:
+    InputRecording();
+
+    // returns success
+    bool load(std::string filename);
+    bool save(std::string filename);
+
+    // add a frame to the end
+    void append(int mask);
+
+    int frameCount() { return m_frameCount; }
+
+    // playback. returns the mask for the next frame, or 0 after the end
+    int next();
+    bool finished() { return m_playFrame >= m_frameCount; }
+    void rewind();
+
+private: //variables
+    /*  file format:
+        int version
+        int frameCount
+        int runCount
+        runCount times:
+            char mask
+            int count
+    */
+    static const int c_version;
+
+    typedef struct {
+        int mask;
+        int count;
+    } Run;
+
+    std::vector<Run> m_runs;
+    int m_frameCount;
+
+    // playback position
+    unsigned int m_playRun;
+    int m_playOffset;
+    int m_playFrame;
+};
+
+#endif
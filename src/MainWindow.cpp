@@ -2,6 +2,10 @@
 
 #include "Config.h"
 #include "Gameplay.h"
+#include "Profiler.h"
+#include "RenderThread.h"
+#include "ResourceManager.h"
+#include "WorkerPool.h"
 
 #include <iostream>
 #include <cstdlib>
@@ -11,18 +15,21 @@ const int MainWindow::c_height = 600;
 const int MainWindow::c_colorDepth = 32;
 const char * MainWindow::c_caption = "Myth of the Ruby Sword";
 const int MainWindow::c_fps = 60; // logic frames per second
+const int MainWindow::c_maxFramesPerDisplay = 5;
+const float MainWindow::c_spinTime = 0.002f;
 
 MainWindow::MainWindow() :
     m_videoModeFlags(c_width, c_height, c_colorDepth),
     m_windowStyle(sf::Style::Close),
     m_window(NULL),
-    m_gameplay(NULL)
+    m_gameplay(NULL),
+    m_renderer(NULL)
 {
     // set fullscreen flag
     setFullscreenFlags(Config::instance()->fullscreen());
 
     m_window = new sf::RenderWindow(m_videoModeFlags, c_caption, m_windowStyle);
-    m_window->UseVerticalSync(true);
+    m_window->UseVerticalSync(Config::instance()->verticalSync());
 
     // initialize gameplay
     if (m_window->IsOpened()) {
@@ -36,49 +43,138 @@ MainWindow::MainWindow() :
 
 MainWindow::~MainWindow()
 {
+    stopRenderer();
     delete m_window;
     delete m_gameplay;
 }
 
 int MainWindow::exec()
 {
+    // logic frames run at a fixed rate. drawing happens as often as it can
+    // (or is allowed to), and shows the state between the last two logic
+    // frames, so that it looks smooth at any display rate. with a render
+    // thread, drawing happens over there and this thread only does logic.
+    // the clocks get reset every time around so that float seconds don't
+    // lose precision after the game has been running for a while
     sf::Clock clock;
-    float goalTime = clock.GetElapsedTime();
+    sf::Clock displayClock;
     float interval = 1.0f / c_fps;
+    int maxDisplayFps = Config::instance()->maxDisplayFps();
+    float displayInterval = maxDisplayFps > 0 ? 1.0f / maxDisplayFps : 0.0f;
+    float accumulator = 0.0f;
+    startRenderer();
+    Profiler::nameThread("main");
 
     while (m_window->IsOpened()) {
+        Profiler::endFrame();
+        PROFILE_ZONE("MainWindow::exec");
+
         // Process events
         sf::Event event;
         while (m_window->GetEvent(event)) {
             if (event.Type == sf::Event::Closed)
-                m_window->Close();
+                close();
             else if(event.Type == sf::Event::KeyPressed) {
                 if (event.Key.Code == sf::Key::F4 && event.Key.Alt)
-                    m_window->Close();
+                    close();
                 else if (event.Key.Alt && event.Key.Code == sf::Key::Return)
                     toggleFullscreen();
+                else if (event.Key.Code == sf::Key::F3)
+                    Profiler::setOverlayVisible(! Profiler::overlayVisible());
             }
         }
 
-        // next logic frame in the gameplay
-        m_gameplay->nextFrame();
-        goalTime += interval;
+        accumulator += clock.GetElapsedTime();
+        clock.Reset();
+
+        // catch the logic up to now
+        int frames = 0;
+        while (accumulator >= interval && frames < c_maxFramesPerDisplay) {
+            m_gameplay->nextFrame();
+            accumulator -= interval;
+            frames++;
+        }
+        // too far behind to catch up. let the time go
+        if (accumulator >= interval)
+            accumulator = 0.0f;
+
+        if (m_renderer != NULL) {
+            if (frames > 0) {
+                m_gameplay->recordFrame(m_renderer->backBuffer());
+                ResourceManager::setGraphicGeneration(m_renderer->publish());
+            }
+            ResourceManager::deleteReleasedGraphics(m_renderer->oldestSerialInUse());
+            // nothing to do until the next logic frame
+            waitUntil(clock, interval - accumulator);
+            continue;
+        }
+
+        m_gameplay->setInterpolation(accumulator / interval);
+        m_gameplay->updateDisplay();
+        Profiler::drawOverlay(m_window);
+        m_window->Display();
+
+        if (displayInterval > 0.0f)
+            waitUntil(displayClock, displayInterval);
+        displayClock.Reset();
+    }
+    stopRenderer();
+
+    Config * config = Config::instance();
+    if (config->profileOutFile().size() > 0)
+        Profiler::writeTrace(config->profileOutFile());
 
-        // draw. frame skip if we're too late!
-        if (clock.GetElapsedTime() < goalTime) {
-            m_gameplay->updateDisplay();
-            m_window->Display();
+    if (m_gameplay != NULL && m_gameplay->isGood()) {
+        // to check a replay against the recording
+        if (config->recordFile().size() > 0 || config->replayFile().size() > 0) {
+            std::cout << "frames: " << m_gameplay->frameCount() << " state hash: "
+                      << std::hex << m_gameplay->stateHash() << std::dec << std::endl;
         }
+        return EXIT_SUCCESS;
     }
+    return EXIT_FAILURE;
+}
+
+void MainWindow::waitUntil(sf::Clock & clock, float time)
+{
+    float remaining = time - clock.GetElapsedTime();
+    if (remaining > c_spinTime)
+        sf::Sleep(remaining - c_spinTime);
+    while (clock.GetElapsedTime() < time) {
+        // spin
+    }
+}
 
-    return (m_gameplay != NULL && m_gameplay->isGood()) ? EXIT_SUCCESS : EXIT_FAILURE;
+void MainWindow::startRenderer()
+{
+    if (m_renderer != NULL || ! Config::instance()->renderThread() || WorkerPool::processorCount() < 2)
+        return;
+    int maxDisplayFps = Config::instance()->maxDisplayFps();
+    // graphics that the render thread might be drawing can't be deleted
+    // out from under it
+    ResourceManager::setDeferGraphicDeletes(true);
+    m_renderer = new RenderThread(m_window, c_fps, maxDisplayFps > 0 ? 1.0f / maxDisplayFps : 0.0f);
+}
+
+void MainWindow::stopRenderer()
+{
+    if (m_renderer == NULL)
+        return;
+    delete m_renderer;
+    m_renderer = NULL;
+    ResourceManager::setDeferGraphicDeletes(false);
 }
 
 void MainWindow::toggleFullscreen()
 {
+    // the window can't be recreated while another thread is drawing on it
+    bool rendering = m_renderer != NULL;
+    stopRenderer();
     setFullscreenFlags(! m_fullscreen);
     m_window->Create(m_videoModeFlags, c_caption, m_windowStyle);
-    m_window->UseVerticalSync(true);
+    m_window->UseVerticalSync(Config::instance()->verticalSync());
+    if (rendering)
+        startRenderer();
 }
 
 void MainWindow::setFullscreenFlags(bool fullscreen)
@@ -92,6 +188,7 @@ void MainWindow::setFullscreenFlags(bool fullscreen)
 
 void MainWindow::close()
 {
+    stopRenderer();
     m_window->Close();
 }
 
@@ -4,6 +4,7 @@
 #include <SFML/Graphics.hpp>
 
 class Gameplay;
+class RenderThread;
 
 // Main window is responsible for setting up the graphics framework,
 // Gameplay, and handling window events.
@@ -29,20 +30,34 @@ public:
 
     // close window and end gameplay
     void close();
+
+    // wait until clock reaches time. sleeps most of the way, then spins,
+    // since sleeping isn't precise enough to hit the time on its own
+    static void waitUntil(sf::Clock & clock, float time);
 private: //variables
     static const int c_fps;
     static const int c_width;
     static const int c_height;
     static const char * c_caption;
     static const int c_colorDepth;
+    // at most this many logic frames per drawn frame. past that the game
+    // slows down instead of never drawing
+    static const int c_maxFramesPerDisplay;
+    // waitUntil sleeps until this close to the time, then spins
+    static const float c_spinTime;
 
     bool m_fullscreen;
     sf::VideoMode m_videoModeFlags;
     int m_windowStyle;
     sf::RenderWindow * m_window;
     Gameplay * m_gameplay;
+    // NULL when drawing happens on this thread
+    RenderThread * m_renderer;
 private: //methods
     void setFullscreenFlags(bool fullscreen);
+    // start and stop drawing on another thread. see RenderThread
+    void startRenderer();
+    void stopRenderer();
 };
 
 inline sf::RenderWindow * MainWindow::renderWindow()
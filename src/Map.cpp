@@ -1,10 +1,19 @@
 #include "Map.h"
 
 #include "ResourceManager.h"
+#include "RenderCommandBuffer.h"
 
 #include "Utils.h"
 #include "Debug.h"
 
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+// 8 tiles. a trigger is usually a doorway or a room, so most of them are in
+// a cell or two
+const double Map::c_triggerCellSize = 128.0;
+
 Map * Map::load(const char *buffer) {
     const char * cursor = buffer;
     int version = Utils::readInt(&cursor);
@@ -51,13 +60,42 @@ Map * Map::load(const char *buffer) {
         }
     }
 
-    // submaps
+    // submaps. each one is a whole map in the same format, so reusing a
+    // piece doesn't mean reading another resource
     int submapCount = Utils::readInt(&cursor);
-    assert(submapCount == 0);
+    for (int i = 0; i < submapCount; i++) {
+        Submap submap;
+        submap.x = Utils::readInt(&cursor);
+        submap.y = Utils::readInt(&cursor);
+        submap.id = Utils::readString(&cursor);
+        int size = Utils::readInt(&cursor);
+        submap.map = load(cursor);
+        cursor += size;
+        if (submap.map == NULL) {
+            delete map;
+            return NULL;
+        }
+        map->m_submaps.push_back(submap);
+    }
 
     // triggers
     int triggerCount = Utils::readInt(&cursor);
-    assert(triggerCount == 0);
+    map->m_triggers.resize(triggerCount);
+    for (int i = 0; i < triggerCount; i++) {
+        Trigger & trigger = map->m_triggers[i];
+        trigger.shape = (TriggerShape)Utils::readInt(&cursor);
+        trigger.layer = Utils::readInt(&cursor);
+        trigger.left = Utils::readInt(&cursor);
+        trigger.top = Utils::readInt(&cursor);
+        trigger.width = Utils::readInt(&cursor);
+        trigger.height = Utils::readInt(&cursor);
+        trigger.id = Utils::readString(&cursor);
+        if (trigger.shape != tgRectangle && trigger.shape != tgCircle) {
+            std::cerr << "Unsupported trigger shape: " << trigger.shape << std::endl;
+            delete map;
+            return NULL;
+        }
+    }
 
     // entities
     int entityCount = Utils::readInt(&cursor);
@@ -77,23 +115,93 @@ Map * Map::load(const char *buffer) {
     }
 
     map->calculateBoundaries();
+    map->adoptSubmaps();
+    map->findTallTiles();
+    map->indexTriggers();
     return map;
 }
 
+void Map::paletteGraphicIds(const char * buffer, std::vector<std::string> & ids)
+{
+    const char * cursor = buffer;
+    Utils::readInt(&cursor); // version
+
+    int sizeX = Utils::readInt(&cursor);
+    int sizeY = Utils::readInt(&cursor);
+
+    int tileCount = Utils::readInt(&cursor);
+    for (int i = 0; i < tileCount; i++) {
+        Utils::readInt(&cursor); // shape
+        Utils::readInt(&cursor); // surface type
+        ids.push_back(Utils::readString(&cursor));
+    }
+
+    // skip the layers to get to the submaps
+    int layerCount = Utils::readInt(&cursor);
+    for (int z = 0; z < layerCount; z++) {
+        LayerType layerType = (LayerType)Utils::readInt(&cursor);
+        if (layerType == ltFull)
+            cursor += sizeX * sizeY * sizeof(int);
+        else
+            cursor += Utils::readInt(&cursor) * sizeof(SparseTile);
+    }
+    int submapCount = Utils::readInt(&cursor);
+    for (int i = 0; i < submapCount; i++) {
+        Utils::readInt(&cursor); // x
+        Utils::readInt(&cursor); // y
+        Utils::readString(&cursor); // id
+        int size = Utils::readInt(&cursor);
+        paletteGraphicIds(cursor, ids);
+        cursor += size;
+    }
+}
+
 Map::Map() :
     m_palette(),
     m_tiles(NULL),
     m_submaps(),
+    m_submapNodes(),
+    m_visibleSubmaps(),
     m_entities(),
+    m_submapEntities(),
+    m_triggers(),
+    m_triggerCellsX(0), m_triggerCellsY(0),
+    m_triggerCells(),
+    m_tallTiles(),
+    m_maxTallHeight(0),
     m_x(0.0), m_y(0.0),
     m_width(0.0), m_height(0.0),
+    m_extentLeft(0.0), m_extentTop(0.0), m_extentRight(0.0), m_extentBottom(0.0),
     m_story(0)
 {
 }
 
 Map::~Map() {
-    for (unsigned int i = 0; i < m_palette.size(); i++)
+    // palette entry 0 is the shared null tile
+    for (unsigned int i = 1; i < m_palette.size(); i++)
         delete m_palette[i];
+    delete m_tiles;
+    for (unsigned int i = 0; i < m_entities.size(); i++)
+        delete m_entities[i];
+    for (unsigned int i = 0; i < m_submapEntities.size(); i++)
+        delete m_submapEntities[i];
+    for (unsigned int i = 0; i < m_submaps.size(); i++)
+        delete m_submaps[i].map;
+}
+
+void Map::setPosition(double x, double y, int story)
+{
+    m_x = x;
+    m_y = y;
+    m_story = story;
+    for (unsigned int i = 0; i < m_submapEntities.size(); i++) {
+        Entity * entity = m_submapEntities[i];
+        entity->setCenter(entity->centerX() + x, entity->centerY() + y);
+        m_entities.push_back(entity);
+    }
+    m_submapEntities.clear();
+    for (unsigned int i = 0; i < m_submaps.size(); i++)
+        m_submaps[i].map->setPosition(x + m_submaps[i].x, y + m_submaps[i].y, story);
 }
 
 void Map::calculateBoundaries()
@@ -101,27 +209,247 @@ void Map::calculateBoundaries()
     // pre-calculations
     m_width = m_tiles->sizeX() * Tile::size;
     m_height = m_tiles->sizeY() * Tile::size;
+
+    m_extentLeft = 0.0;
+    m_extentTop = 0.0;
+    m_extentRight = m_width;
+    m_extentBottom = m_height;
+    for (unsigned int i = 0; i < m_submaps.size(); i++) {
+        Submap & submap = m_submaps[i];
+        m_extentLeft = Utils::min(m_extentLeft, submap.x + submap.map->m_extentLeft);
+        m_extentTop = Utils::min(m_extentTop, submap.y + submap.map->m_extentTop);
+        m_extentRight = Utils::max(m_extentRight, submap.x + submap.map->m_extentRight);
+        m_extentBottom = Utils::max(m_extentBottom, submap.y + submap.map->m_extentBottom);
+    }
+}
+
+void Map::adoptSubmaps()
+{
+    for (unsigned int i = 0; i < m_submaps.size(); i++) {
+        Submap & submap = m_submaps[i];
+        // a submap's entities and triggers are relative to it, wherever it
+        // is. the entities stay relative to this map until it's placed
+        Map * map = submap.map;
+        map->m_entities.insert(map->m_entities.end(), map->m_submapEntities.begin(), map->m_submapEntities.end());
+        map->m_submapEntities.clear();
+        for (unsigned int j = 0; j < map->m_entities.size(); j++) {
+            Entity * entity = map->m_entities[j];
+            entity->setCenter(entity->centerX() + submap.x, entity->centerY() + submap.y);
+            m_submapEntities.push_back(entity);
+        }
+        map->m_entities.clear();
+        map->setPosition(m_x + submap.x, m_y + submap.y, m_story);
+        std::vector<Trigger> & triggers = map->m_triggers;
+        for (unsigned int j = 0; j < triggers.size(); j++) {
+            Trigger trigger = triggers[j];
+            trigger.left += submap.x;
+            trigger.top += submap.y;
+            m_triggers.push_back(trigger);
+        }
+        triggers.clear();
+    }
+
+    m_submapNodes.clear();
+    if (m_submaps.size() == 0)
+        return;
+    std::vector<std::pair<double, int> > order;
+    for (unsigned int i = 0; i < m_submaps.size(); i++)
+        order.push_back(std::pair<double, int>(0.0, i));
+    buildSubmapNodes(order, 0, order.size());
+}
+
+void Map::buildSubmapNodes(std::vector<std::pair<double, int> > & order, int begin, int end)
+{
+    SubmapNode node;
+    node.left = HUGE_VAL;
+    node.top = HUGE_VAL;
+    node.right = -HUGE_VAL;
+    node.bottom = -HUGE_VAL;
+    for (int i = begin; i < end; i++) {
+        Submap & submap = m_submaps[order[i].second];
+        node.left = Utils::min(node.left, submap.x + submap.map->m_extentLeft);
+        node.top = Utils::min(node.top, submap.y + submap.map->m_extentTop);
+        node.right = Utils::max(node.right, submap.x + submap.map->m_extentRight);
+        node.bottom = Utils::max(node.bottom, submap.y + submap.map->m_extentBottom);
+    }
+    int index = m_submapNodes.size();
+    m_submapNodes.push_back(node);
+
+    if (end - begin == 1) {
+        m_submapNodes[index].submap = order[begin].second;
+    } else {
+        // split in half at the middle one along the longer side
+        bool wide = node.right - node.left >= node.bottom - node.top;
+        for (int i = begin; i < end; i++) {
+            Submap & submap = m_submaps[order[i].second];
+            if (wide)
+                order[i].first = submap.x + (submap.map->m_extentLeft + submap.map->m_extentRight) / 2.0;
+            else
+                order[i].first = submap.y + (submap.map->m_extentTop + submap.map->m_extentBottom) / 2.0;
+        }
+        int middle = (begin + end) / 2;
+        std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end);
+        m_submapNodes[index].submap = -1;
+        buildSubmapNodes(order, begin, middle);
+        buildSubmapNodes(order, middle, end);
+    }
+    m_submapNodes[index].skip = m_submapNodes.size();
 }
 
-void Map::tilesAtPoint(std::vector<TileAndLocation>& tiles, double x, double y, int layer) {
-    int tileIndexX = (int)((x - m_x) / Tile::size), tileIndexY = (int)((y - m_y) / Tile::size);
-    if (!(0 <= tileIndexX && tileIndexX < m_tiles->sizeX() &&
-          0 <= tileIndexY && tileIndexY < m_tiles->sizeY())) {
+int Map::nextSubmap(int & node, double left, double top, double right, double bottom)
+{
+    while (node < (int)m_submapNodes.size()) {
+        SubmapNode & current = m_submapNodes[node];
+        if (current.right < left || current.left > right || current.bottom < top || current.top > bottom) {
+            node = current.skip;
+            continue;
+        }
+        node++;
+        if (current.submap != -1)
+            return current.submap;
+    }
+    return -1;
+}
+
+void Map::findTallTiles()
+{
+    m_tallTiles.clear();
+    m_tallTiles.resize(m_tiles->sizeZ());
+    m_maxTallHeight = 0;
+    for (int z = 0; z < m_tiles->sizeZ(); z++) {
+        for (int y = 0; y < m_tiles->sizeY(); y++) {
+            for (int x = 0; x < m_tiles->sizeX(); x++) {
+                Tile * tile = m_palette[m_tiles->get(x, y, z)];
+                if (! tile->isTall())
+                    continue;
+                TallTile tallTile;
+                tallTile.x = x * Tile::sizeInt;
+                tallTile.y = y * Tile::sizeInt;
+                tallTile.depth = tallTile.y + tile->graphicHeight();
+                tallTile.tile = tile;
+                m_tallTiles[z].push_back(tallTile);
+                m_maxTallHeight = Utils::max(m_maxTallHeight, tile->graphicHeight());
+            }
+        }
+        // the submaps have already gathered up their own, and theirs
+        for (unsigned int i = 0; i < m_submaps.size(); i++) {
+            Submap & submap = m_submaps[i];
+            if (z >= submap.map->layerCount())
+                continue;
+            std::vector<TallTile> & tallTiles = submap.map->m_tallTiles[z];
+            for (unsigned int j = 0; j < tallTiles.size(); j++) {
+                TallTile tallTile = tallTiles[j];
+                tallTile.x += submap.x;
+                tallTile.y += submap.y;
+                tallTile.depth += submap.y;
+                m_tallTiles[z].push_back(tallTile);
+            }
+            m_maxTallHeight = Utils::max(m_maxTallHeight, submap.map->m_maxTallHeight);
+        }
+        std::stable_sort(m_tallTiles[z].begin(), m_tallTiles[z].end(), tallTileLessThan);
+    }
+}
+
+void Map::indexTriggers()
+{
+    m_triggerCellsX = Utils::max((int)std::ceil(m_width / c_triggerCellSize), 1);
+    m_triggerCellsY = Utils::max((int)std::ceil(m_height / c_triggerCellSize), 1);
+    m_triggerCells.clear();
+    m_triggerCells.resize(m_triggerCellsX * m_triggerCellsY);
+    for (unsigned int i = 0; i < m_triggers.size(); i++) {
+        Trigger & trigger = m_triggers[i];
+        int cellLeft, cellTop, cellRight, cellBottom;
+        if (! triggerCellRange(trigger.left, trigger.top, trigger.left + trigger.width,
+                               trigger.top + trigger.height, cellLeft, cellTop, cellRight, cellBottom))
+        {
+            continue;
+        }
+        for (int y = cellTop; y <= cellBottom; y++) {
+            for (int x = cellLeft; x <= cellRight; x++)
+                m_triggerCells[y * m_triggerCellsX + x].push_back(i);
+        }
+    }
+}
+
+bool Map::triggerCellRange(double left, double top, double right, double bottom,
+                           int & cellLeft, int & cellTop, int & cellRight, int & cellBottom)
+{
+    if (right < 0.0 || bottom < 0.0 || left > m_width || top > m_height)
+        return false;
+    cellLeft = Utils::max((int)(left / c_triggerCellSize), 0);
+    cellTop = Utils::max((int)(top / c_triggerCellSize), 0);
+    cellRight = Utils::min((int)(right / c_triggerCellSize), m_triggerCellsX - 1);
+    cellBottom = Utils::min((int)(bottom / c_triggerCellSize), m_triggerCellsY - 1);
+    return true;
+}
+
+bool Map::triggerOverlaps(const Trigger & trigger, double x, double y, double radius, int shape)
+{
+    if (trigger.shape == tgCircle) {
+        double triggerRadius = Utils::min(trigger.width, trigger.height) / 2.0;
+        double triggerX = trigger.left + trigger.width / 2.0, triggerY = trigger.top + trigger.height / 2.0;
+        if (shape == Entity::Square) {
+            // the closest point of the square to the middle of the circle
+            double closestX = Utils::max(x - radius, Utils::min(triggerX, x + radius));
+            double closestY = Utils::max(y - radius, Utils::min(triggerY, y + radius));
+            return Utils::distance2(closestX, closestY, triggerX, triggerY) < triggerRadius * triggerRadius;
+        }
+        double reach = triggerRadius + radius;
+        return Utils::distance2(x, y, triggerX, triggerY) < reach * reach;
+    }
+
+    double right = trigger.left + trigger.width, bottom = trigger.top + trigger.height;
+    if (shape == Entity::Square)
+        return x - radius < right && x + radius > trigger.left && y - radius < bottom && y + radius > trigger.top;
+    // how far the middle of the circle is outside the rectangle
+    double outsideX = Utils::max(Utils::max(trigger.left - x, x - right), 0.0);
+    double outsideY = Utils::max(Utils::max(trigger.top - y, y - bottom), 0.0);
+    if (outsideX == 0.0 && outsideY == 0.0)
+        return true;
+    return outsideX * outsideX + outsideY * outsideY < radius * radius;
+}
+
+bool Map::tallTileLessThan(const TallTile & tile1, const TallTile & tile2)
+{
+    return tile1.depth < tile2.depth;
+}
+
+void Map::tallTileRange(double screenY, double screenHeight, int layer, int & begin, int & end)
+{
+    std::vector<TallTile> & tiles = m_tallTiles[layer];
+    // a tile shows up if the bottom of its graphic is below the top of the
+    // screen and its top is above the bottom of the screen
+    TallTile bound;
+    bound.depth = screenY - m_y;
+    begin = std::lower_bound(tiles.begin(), tiles.end(), bound, tallTileLessThan) - tiles.begin();
+    bound.depth = screenY + screenHeight + m_maxTallHeight - m_y;
+    end = std::upper_bound(tiles.begin(), tiles.end(), bound, tallTileLessThan) - tiles.begin();
+    end = Utils::max(begin, end);
+}
+
+void Map::tilesAtPoint(TileList & tiles, double x, double y, int layer) {
+    int tileIndexX = (int)std::floor((x - m_x) / Tile::size), tileIndexY = (int)std::floor((y - m_y) / Tile::size);
+    if (0 <= tileIndexX && tileIndexX < m_tiles->sizeX() &&
+        0 <= tileIndexY && tileIndexY < m_tiles->sizeY() && layer < m_tiles->sizeZ())
+    {
         double tileX = m_x + tileIndexX * Tile::size, tileY = m_y + tileIndexY * Tile::size;
         Tile * tile = m_palette[m_tiles->get(tileIndexX, tileIndexY, layer)];
         tiles.push_back(TileAndLocation(tileX, tileY, tile));
     }
 
-    for (unsigned int i = 0; i < m_submaps.size(); i++)
-        m_submaps[i]->tilesAtPoint(tiles, x, y, layer);
+    int node = 0, submap;
+    while ((submap = nextSubmap(node, x - m_x, y - m_y, x - m_x, y - m_y)) != -1)
+        m_submaps[submap].map->tilesAtPoint(tiles, x, y, layer);
 }
 
-void Map::intersectingTiles(std::vector<TileAndLocation>& tiles, double centerX, double centerY, double apothem,
+void Map::intersectingTiles(TileList & tiles, double centerX, double centerY, double apothem,
                             int layer, Tile::PhysicalPresence minPresence)
 {
     int tileIndexStartX, tileIndexStartY, tileIndexEndX, tileIndexEndY;
     tileRange(centerX - apothem, centerY - apothem, apothem * 2.0, apothem * 2.0,
               tileIndexStartX, tileIndexStartY, tileIndexEndX, tileIndexEndY);
+    if (layer >= m_tiles->sizeZ())
+        tileIndexEndY = tileIndexStartY;
 
     for (int tileIndexY = tileIndexStartY; tileIndexY < tileIndexEndY; tileIndexY++) {
         for (int tileIndexX = tileIndexStartX; tileIndexX < tileIndexEndX; tileIndexX++) {
@@ -130,23 +458,155 @@ void Map::intersectingTiles(std::vector<TileAndLocation>& tiles, double centerX,
                 tiles.push_back(TileAndLocation(tileIndexX * Tile::size + m_x, tileIndexY * Tile::size + m_y, tile));
         }
     }
+
+    double x = centerX - m_x, y = centerY - m_y;
+    int node = 0, submap;
+    while ((submap = nextSubmap(node, x - apothem, y - apothem, x + apothem, y + apothem)) != -1)
+        m_submaps[submap].map->intersectingTiles(tiles, centerX, centerY, apothem, layer, minPresence);
+}
+
+bool Map::raycast(double fromX, double fromY, double toX, double toY, int layer,
+                  Tile::PhysicalPresence minPresence, RayHit & hit, double maxT)
+{
+    bool found = false;
+    double originX = fromX - m_x, originY = fromY - m_y;
+    double dx = toX - fromX, dy = toY - fromY;
+    int node = 0;
+    while (true) {
+        // only submaps near what's left of the segment. a hit shortens it
+        double endX = originX + dx * maxT, endY = originY + dy * maxT;
+        int submap = nextSubmap(node, Utils::min(originX, endX), Utils::min(originY, endY),
+                                Utils::max(originX, endX), Utils::max(originY, endY));
+        if (submap == -1)
+            break;
+        if (m_submaps[submap].map->raycast(fromX, fromY, toX, toY, layer, minPresence, hit, maxT)) {
+            maxT = hit.t;
+            found = true;
+        }
+    }
+    if (layer < 0 || layer >= m_tiles->sizeZ())
+        return found;
+
+    // only the part of the segment over the map
+    double tStart = 0.0, tEnd = maxT;
+    if (!clipRay(originX, dx, m_width, tStart, tEnd) || !clipRay(originY, dy, m_height, tStart, tEnd))
+        return found;
+
+    // Amanatides & Woo: step to whichever tile boundary the segment
+    // crosses next, x or y. next* is the t of that boundary
+    int tileIndexX = Utils::max(Utils::min((int)std::floor((originX + dx * tStart) / Tile::size), m_tiles->sizeX() - 1), 0);
+    int tileIndexY = Utils::max(Utils::min((int)std::floor((originY + dy * tStart) / Tile::size), m_tiles->sizeY() - 1), 0);
+    int stepX = dx > 0.0 ? 1 : -1, stepY = dy > 0.0 ? 1 : -1;
+    double deltaX = dx != 0.0 ? Tile::size / std::fabs(dx) : HUGE_VAL;
+    double deltaY = dy != 0.0 ? Tile::size / std::fabs(dy) : HUGE_VAL;
+    double nextX = dx != 0.0 ? ((tileIndexX + (stepX > 0)) * Tile::size - originX) / dx : HUGE_VAL;
+    double nextY = dy != 0.0 ? ((tileIndexY + (stepY > 0)) * Tile::size - originY) / dy : HUGE_VAL;
+
+    double t = tStart;
+    while (true) {
+        double tileEnd = Utils::min(Utils::min(nextX, nextY), tEnd);
+        Tile * tile = m_palette[m_tiles->get(tileIndexX, tileIndexY, layer)];
+        double tileX = m_x + tileIndexX * Tile::size, tileY = m_y + tileIndexY * Tile::size;
+        double hitT;
+        if (tile->raycast(tileX, tileY, fromX, fromY, dx, dy, t, tileEnd, minPresence, hitT)) {
+            hit.t = hitT;
+            hit.x = fromX + dx * hitT;
+            hit.y = fromY + dy * hitT;
+            hit.tile = tile;
+            return true;
+        }
+        if (tileEnd >= tEnd)
+            return found;
+
+        if (nextX < nextY) {
+            tileIndexX += stepX;
+            t = nextX;
+            nextX += deltaX;
+        } else {
+            tileIndexY += stepY;
+            t = nextY;
+            nextY += deltaY;
+        }
+        // rounding can put the last boundary a hair before tEnd
+        if (!(0 <= tileIndexX && tileIndexX < m_tiles->sizeX() &&
+              0 <= tileIndexY && tileIndexY < m_tiles->sizeY()))
+        {
+            return found;
+        }
+    }
 }
 
-void Map::draw(double screenX, double screenY, double screenWidth, double screenHeight, int layer) {
+bool Map::clipRay(double from, double d, double size, double & tStart, double & tEnd)
+{
+    if (d == 0.0)
+        return 0.0 <= from && from <= size;
+    double t1 = (0.0 - from) / d, t2 = (size - from) / d;
+    if (t1 > t2)
+        std::swap(t1, t2);
+    tStart = Utils::max(tStart, t1);
+    tEnd = Utils::min(tEnd, t2);
+    return tStart <= tEnd;
+}
+
+void Map::draw(RenderCommandBuffer * commands, double screenX, double screenY, double screenWidth, double screenHeight, int layer) {
     int tileIndexStartX, tileIndexStartY, tileIndexEndX, tileIndexEndY;
     tileRange(screenX, screenY, screenWidth, screenHeight, tileIndexStartX, tileIndexStartY, tileIndexEndX, tileIndexEndY);
+    if (layer >= m_tiles->sizeZ())
+        tileIndexEndY = tileIndexStartY;
 
-    int mapX = (int)(m_x - screenX), mapY = (int)(m_y - screenY);
     for (int tileIndexY = tileIndexStartY; tileIndexY < tileIndexEndY; tileIndexY++) {
         for (int tileIndexX = tileIndexStartX; tileIndexX < tileIndexEndX; tileIndexX++) {
             int tileIndex = m_tiles->get(tileIndexX, tileIndexY, layer);
             Tile * tile = m_palette[tileIndex];
-            tile->draw(mapX + tileIndexX * Tile::sizeInt, mapY + tileIndexY * Tile::sizeInt);
+            if (tile->isTall())
+                continue;
+            tile->draw(commands, m_x + tileIndexX * Tile::size, m_y + tileIndexY * Tile::size);
         }
     }
 
-    for (unsigned int i = 0; i < m_submaps.size(); i++)
-        m_submaps[i]->draw(screenX, screenY, screenWidth, screenHeight, layer);
+    // only the submaps on screen, in the order they're listed so the later
+    // ones go on top. each gets its own sort key, or the backend would be
+    // free to mix its tiles in with ours
+    double left = screenX - m_x, top = screenY - m_y;
+    m_visibleSubmaps.clear();
+    int node = 0, submap;
+    while ((submap = nextSubmap(node, left, top, left + screenWidth, top + screenHeight)) != -1)
+        m_visibleSubmaps.push_back(submap);
+    std::sort(m_visibleSubmaps.begin(), m_visibleSubmaps.end());
+    for (unsigned int i = 0; i < m_visibleSubmaps.size(); i++) {
+        commands->beginLayer(layer);
+        m_submaps[m_visibleSubmaps[i]].map->draw(commands, screenX, screenY, screenWidth, screenHeight, layer);
+    }
+}
+
+void Map::triggersOverlapping(std::vector<int> & results, double centerX, double centerY,
+                              double radius, int shape, int layer)
+{
+    if (m_triggers.size() == 0)
+        return;
+    double x = centerX - m_x, y = centerY - m_y;
+    int cellLeft, cellTop, cellRight, cellBottom;
+    if (! triggerCellRange(x - radius, y - radius, x + radius, y + radius, cellLeft, cellTop, cellRight, cellBottom))
+        return;
+    for (int cellY = cellTop; cellY <= cellBottom; cellY++) {
+        for (int cellX = cellLeft; cellX <= cellRight; cellX++) {
+            std::vector<int> & cell = m_triggerCells[cellY * m_triggerCellsX + cellX];
+            for (unsigned int i = 0; i < cell.size(); i++) {
+                Trigger & trigger = m_triggers[cell[i]];
+                if (trigger.layer != layer)
+                    continue;
+                // a trigger in more than one of the cells only counts in the
+                // first one they have in common
+                int left, top, right, bottom;
+                triggerCellRange(trigger.left, trigger.top, trigger.left + trigger.width,
+                                 trigger.top + trigger.height, left, top, right, bottom);
+                if (cellX != Utils::max(left, cellLeft) || cellY != Utils::max(top, cellTop))
+                    continue;
+                if (triggerOverlaps(trigger, x, y, radius, shape))
+                    results.push_back(cell[i]);
+            }
+        }
+    }
 }
 
 void Map::tileRange(double left, double top, double width, double height,
@@ -5,15 +5,23 @@
 #include "ResourceFile.h"
 #include "Tile.h"
 #include "Entity.h"
+#include "FrameArena.h"
 
 #include <vector>
 
+class RenderCommandBuffer;
+
 class Map {
 public: //variables
     enum LayerType {
         ltFull = 1,
         ltSparse = 2,
     };
+    enum TriggerShape {
+        tgRectangle = 1,
+        // the biggest circle that fits in the middle of the rectangle
+        tgCircle = 2,
+    };
 
     class TileAndLocation {
     public:
@@ -23,51 +31,168 @@ public: //variables
         TileAndLocation() : x(0), y(0), tile(NULL), proximity2(0) {}
         TileAndLocation(double x, double y, Tile * tile) : x(x), y(y), tile(tile), proximity2(0) {}
     };
+    // a tile that has to be depth sorted with the entities. see Tile::isTall
+    typedef struct {
+        // top left, relative to the map
+        int x, y;
+        // the bottom of the graphic, relative to the map. things are drawn
+        // in order of depth
+        double depth;
+        Tile * tile;
+    } TallTile;
+
+    // where a ray ran into something. see raycast
+    typedef struct {
+        // how far along the ray, from 0 at the start to 1 at the end
+        double t;
+        double x, y;
+        Tile * tile;
+    } RayHit;
+
+    // a region of the map that notices entities coming and going. see
+    // Gameplay::triggerEvents
+    typedef struct {
+        std::string id;
+        TriggerShape shape;
+        int layer;
+        // relative to the map, so they move with it
+        double left, top, width, height;
+    } Trigger;
+
+    // tile queries are per frame scratch, so they live in a FrameArena
+    typedef std::vector<TileAndLocation, ArenaAllocator<TileAndLocation> > TileList;
 
 public: //methods
     static Map * load(const char * buffer);
+    // list the graphics used by the palette of a map in memory, and by the
+    // palettes of its submaps, without loading anything
+    static void paletteGraphicIds(const char * buffer, std::vector<std::string> & ids);
     Map();
     ~Map();
 
-    void tilesAtPoint(std::vector<TileAndLocation>& tiles, double x, double y, int layer);
-    void intersectingTiles(std::vector<TileAndLocation>& tiles, double centerX, double centerY, double apothem,
+    void tilesAtPoint(TileList & tiles, double x, double y, int layer);
+    void intersectingTiles(TileList & tiles, double centerX, double centerY, double apothem,
                            int layer, Tile::PhysicalPresence minPresence);
+    // walk the tiles along the segment, stopping at the first one that
+    // sticks up at least minPresence where the segment crosses it. only hits
+    // up to maxT along the segment count. hit is left alone if it returns
+    // false. a segment that starts inside something hits at 0
+    bool raycast(double fromX, double fromY, double toX, double toY, int layer,
+                 Tile::PhysicalPresence minPresence, RayHit & hit, double maxT = 1.0);
 
-    // draw on screen
-    void draw(double screenX, double screenY, double screenWidth,
+    // record the tiles on screen. tall tiles are left out; see tallTiles
+    void draw(RenderCommandBuffer * commands, double screenX, double screenY, double screenWidth,
               double screenHeight, int layer);
+    // the tall tiles on a layer, sorted by depth
+    std::vector<TallTile> * tallTiles(int layer) { return &m_tallTiles[layer]; }
+    // the range [begin, end) of tallTiles(layer) that might show up on screen
+    void tallTileRange(double screenY, double screenHeight, int layer, int & begin, int & end);
 
-    // world location
-    void setPosition(double x, double y, int story) { m_x = x; m_y = y; m_story = story; }
+    // world location. submaps move along
+    void setPosition(double x, double y, int story);
     double left() { return m_x; }
     double top() { return m_y; }
     double width(){ return m_width; }
     double height() { return m_height; }
     int layerCount() { return m_tiles->sizeZ(); }
+    // size in tiles, and the tile at a spot in the map
+    int tileCountX() { return m_tiles->sizeX(); }
+    int tileCountY() { return m_tiles->sizeY(); }
+    Tile * tile(int tileIndexX, int tileIndexY, int layer) { return m_palette[m_tiles->get(tileIndexX, tileIndexY, layer)]; }
 
     // gimme the entities
     std::vector<Entity*> * entities() { return &m_entities; }
 
+    std::vector<Trigger> * triggers() { return &m_triggers; }
+    // append the indexes of the triggers on layer that overlap something
+    // shaped like an entity (see Entity::Shape), in world coordinates. safe
+    // to call from several threads at once
+    void triggersOverlapping(std::vector<int> & results, double centerX, double centerY,
+                             double radius, int shape, int layer);
+
 private:
     typedef struct {
         int x, y, tile;
     } SparseTile;
 
+    // a map drawn and collided with as part of this one, on the same layers.
+    // its entities, triggers and tall tiles are handed to this map when it
+    // loads
+    typedef struct {
+        Map * map;
+        std::string id;
+        // top left, relative to this map. a submap has to fit inside this
+        // map's own tiles: worlds, trigger cells and placements only go by
+        // those. compile-resources and the editor refuse anything else
+        int x, y;
+    } Submap;
+
+    // bounding volume hierarchy over the submaps. the nodes are in depth
+    // first order, so a query walks them front to back and jumps to skip to
+    // get past everything under a node it doesn't need
+    typedef struct {
+        // relative to this map. covers everything under the node
+        double left, top, right, bottom;
+        int skip;
+        // index into m_submaps for leaves, -1 for the rest
+        int submap;
+    } SubmapNode;
+
     std::vector<Tile*> m_palette;
     Array3<int> * m_tiles;
-    std::vector<Map*> m_submaps;
+    std::vector<Submap> m_submaps;
+    std::vector<SubmapNode> m_submapNodes;
+    // draw's scratch space, kept so it doesn't reallocate every frame
+    std::vector<int> m_visibleSubmaps;
     std::vector<Entity*> m_entities;
+    // the submaps' entities, relative to this map until it's placed
+    std::vector<Entity*> m_submapEntities;
+    std::vector<Trigger> m_triggers;
+    // uniform grid over the map. each cell holds the indexes of the
+    // triggers that overlap it
+    static const double c_triggerCellSize;
+    int m_triggerCellsX, m_triggerCellsY;
+    std::vector<std::vector<int> > m_triggerCells;
+    std::vector<std::vector<TallTile> > m_tallTiles;
+    // the tallest tall tile graphic
+    int m_maxTallHeight;
 
     // absolute coordinates
     double m_x, m_y;
     double m_width, m_height; // computed and cached
+    // relative to the map, around its tiles and all of its submaps
+    double m_extentLeft, m_extentTop, m_extentRight, m_extentBottom;
     int m_story;
 
     void tileRange(double left, double top, double width, double height,
                    int & indexLeft, int & indexTop, int & indexRight, int & indexBottom);
 
+    // narrow [tStart, tEnd] down to where from + t * d is in [0, size].
+    // returns false if that's nowhere
+    static bool clipRay(double from, double d, double size, double & tStart, double & tEnd);
+
     // cache the width and height of the map
     void calculateBoundaries();
+    // take over the entities and triggers of the submaps, and fill
+    // m_submapNodes
+    void adoptSubmaps();
+    // add the nodes for order[begin, end), which it reorders. order holds
+    // indexes into m_submaps
+    void buildSubmapNodes(std::vector<std::pair<double, int> > & order, int begin, int end);
+    // the next submap whose bounds overlap the rectangle, which is relative
+    // to the map, starting from node. -1 when there are no more. start at
+    // node 0. doesn't change anything, so it's safe from several threads
+    int nextSubmap(int & node, double left, double top, double right, double bottom);
+    // fill m_tallTiles
+    void findTallTiles();
+    // fill m_triggerCells
+    void indexTriggers();
+    // the cells the rectangle, relative to the map, is in. false if it's
+    // off the map
+    bool triggerCellRange(double left, double top, double right, double bottom,
+                          int & cellLeft, int & cellTop, int & cellRight, int & cellBottom);
+    static bool triggerOverlaps(const Trigger & trigger, double x, double y, double radius, int shape);
+    static bool tallTileLessThan(const TallTile & tile1, const TallTile & tile2);
 };
 
 #endif
@@ -0,0 +1,22 @@
+#include "NullRenderBackend.h"
+
+NullRenderBackend::NullRenderBackend(int width, int height) :
+    m_width(width), m_height(height),
+    m_visibleQuadCount(0)
+{
+}
+
+void NullRenderBackend::render(RenderCommandBuffer * buffer, double interpolation)
+{
+    sortQuads(buffer);
+    double cameraX = buffer->cameraX(interpolation);
+    double cameraY = buffer->cameraY(interpolation);
+    m_visibleQuadCount = 0;
+    for (int i = 0; i < buffer->quadCount(); i++) {
+        RenderCommandBuffer::Quad * quad = buffer->quad(i);
+        int x = screenX(quad, cameraX, interpolation);
+        int y = screenY(quad, cameraY, interpolation);
+        if (x + quad->width > 0 && x < m_width && y + quad->height > 0 && y < m_height)
+            m_visibleQuadCount++;
+    }
+}
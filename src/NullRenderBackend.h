@@ -0,0 +1,24 @@
+#ifndef _NULL_RENDER_BACKEND_H_
+#define _NULL_RENDER_BACKEND_H_
+
+#include "RenderBackend.h"
+
+// works out what would be drawn, and how many batches it would take, without
+// drawing anything. for measuring draw work with no display
+class NullRenderBackend : public RenderBackend
+{
+public:
+    // the size of the pretend screen
+    NullRenderBackend(int width, int height);
+
+    void render(RenderCommandBuffer * buffer, double interpolation);
+
+    // how many of the last render's quads would be on screen
+    int visibleQuadCount() { return m_visibleQuadCount; }
+
+private:
+    int m_width, m_height;
+    int m_visibleQuadCount;
+};
+
+#endif
@@ -0,0 +1,94 @@
+#include "Parking.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#ifdef _WIN32
+// the semaphore gets a count per waiter for each wake up. threads that
+// weren't waiting leave theirs behind, which only makes a later wait check
+// what it's waiting for one more time
+struct Parking::Platform {
+    CRITICAL_SECTION lock;
+    HANDLE wake;
+};
+
+Parking::Parking() :
+    m_platform(new Platform())
+{
+    InitializeCriticalSection(&m_platform->lock);
+    m_platform->wake = CreateSemaphore(NULL, 0, 0x7fffffff, NULL);
+}
+
+Parking::~Parking()
+{
+    CloseHandle(m_platform->wake);
+    DeleteCriticalSection(&m_platform->lock);
+    delete m_platform;
+}
+
+void Parking::lock()
+{
+    EnterCriticalSection(&m_platform->lock);
+}
+
+void Parking::unlock()
+{
+    LeaveCriticalSection(&m_platform->lock);
+}
+
+void Parking::wait()
+{
+    LeaveCriticalSection(&m_platform->lock);
+    WaitForSingleObject(m_platform->wake, INFINITE);
+    EnterCriticalSection(&m_platform->lock);
+}
+
+void Parking::wakeAll(int waiters)
+{
+    if (waiters > 0)
+        ReleaseSemaphore(m_platform->wake, waiters, NULL);
+}
+#else
+struct Parking::Platform {
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+};
+
+Parking::Parking() :
+    m_platform(new Platform())
+{
+    pthread_mutex_init(&m_platform->lock, NULL);
+    pthread_cond_init(&m_platform->wake, NULL);
+}
+
+Parking::~Parking()
+{
+    pthread_cond_destroy(&m_platform->wake);
+    pthread_mutex_destroy(&m_platform->lock);
+    delete m_platform;
+}
+
+void Parking::lock()
+{
+    pthread_mutex_lock(&m_platform->lock);
+}
+
+void Parking::unlock()
+{
+    pthread_mutex_unlock(&m_platform->lock);
+}
+
+void Parking::wait()
+{
+    pthread_cond_wait(&m_platform->wake, &m_platform->lock);
+}
+
+void Parking::wakeAll(int)
+{
+    pthread_cond_broadcast(&m_platform->wake);
+}
+#endif
@@ -0,0 +1,44 @@
+#ifndef _PARKING_H_
+#define _PARKING_H_
+
+// Parking is a lock and a way to wait on it, so a thread with nothing to do
+// can sleep until another thread has something for it instead of polling.
+// It's a condition variable, or a semaphore on Windows. The platform's
+// headers stay in Parking.cpp.
+//
+// waits can end without a wakeAll, so always wait in a loop that checks
+// whatever you're waiting for, with the lock held.
+class Parking
+{
+public:
+    Parking();
+    ~Parking();
+
+    void lock();
+    void unlock();
+    // call with the lock held. lets go of it until woken, then takes it back
+    void wait();
+    // wake everyone waiting. waiters is the most threads that could be
+    void wakeAll(int waiters);
+
+    // holds the lock for as long as it's in scope
+    class Lock
+    {
+    public:
+        Lock(Parking & parking) : m_parking(parking) { m_parking.lock(); }
+        ~Lock() { m_parking.unlock(); }
+    private:
+        Parking & m_parking;
+    };
+
+private: //variables
+    struct Platform;
+    Platform * m_platform;
+
+private: //methods
+    // not copyable
+    Parking(const Parking &);
+    Parking & operator=(const Parking &);
+};
+
+#endif
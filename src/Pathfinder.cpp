@@ -0,0 +1,638 @@
+#include "Pathfinder.h"
+
+#include "World.h"
+#include "Map.h"
+#include "Utils.h"
+#include "Debug.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+// a screen is about 50 x 40 tiles, so a few clusters across
+const int Pathfinder::c_clusterSize = 16;
+const int Pathfinder::c_wideEntrance = 6;
+const double Pathfinder::c_diagonalCost = 1.41421356237;
+// about a millisecond
+const int Pathfinder::c_updateSteps = 20000;
+const int Pathfinder::c_cacheSize = 256;
+
+Pathfinder::Pathfinder(World * world, Tile::PhysicalPresence minPresence) :
+    m_world(world),
+    m_minPresence(minPresence),
+    m_maps(),
+    m_changes(0),
+    m_stamp(0),
+    m_steps(0),
+    m_open(),
+    m_goalCosts(),
+    m_route(),
+    m_localCost(c_clusterSize * c_clusterSize, 0.0),
+    m_localParent(c_clusterSize * c_clusterSize, -1),
+    m_localStamp(c_clusterSize * c_clusterSize, 0),
+    m_localClosed(c_clusterSize * c_clusterSize, 0),
+    m_localOpen(),
+    m_localTiles(),
+    m_localSearch(0),
+    m_localPlacement(-1), m_localLeft(0), m_localTop(0), m_localWidth(0), m_localHeight(0),
+    m_pending(),
+    m_queue(),
+    m_freeRequests(),
+    m_cache()
+{
+    MapClusters never;
+    never.generation = -1;
+    never.layers = never.clustersX = never.clustersY = 0;
+    m_maps.resize(m_world->mapCount(), never);
+
+    CachedPath unused;
+    unused.mapGeneration = -1;
+    unused.changes = -1;
+    unused.layer = -1;
+    unused.found = false;
+    m_cache.resize(c_cacheSize, unused);
+}
+
+bool Pathfinder::findPath(std::vector<Waypoint> & path, double fromX, double fromY,
+                          double toX, double toY, int layer)
+{
+    path.clear();
+    Place from, to;
+    if (!locate(fromX, fromY, layer, from) || !locate(toX, toY, layer, to))
+        return false;
+
+    // nothing that went into a cached path can have changed since, or
+    // neither the map generation nor m_changes would match
+    CachedPath & cached = cacheEntry(layer, from, to);
+    if (cached.mapGeneration == m_world->mapGeneration() && cached.changes == m_changes &&
+        cached.layer == layer &&
+        cached.from.placement == from.placement && cached.from.x == from.x && cached.from.y == from.y &&
+        cached.to.placement == to.placement && cached.to.x == to.x && cached.to.y == to.y)
+    {
+        path.assign(cached.path.begin(), cached.path.end());
+        return cached.found;
+    }
+
+    bool found = search(path, layer, from, to);
+    cached.mapGeneration = m_world->mapGeneration();
+    cached.changes = m_changes;
+    cached.layer = layer;
+    cached.from = from;
+    cached.to = to;
+    cached.found = found;
+    cached.path.assign(path.begin(), path.end());
+    return found;
+}
+
+Pathfinder::Request Pathfinder::request(double fromX, double fromY, double toX, double toY, int layer)
+{
+    Request request;
+    if (m_freeRequests.size() > 0) {
+        request = m_freeRequests.back();
+        m_freeRequests.pop_back();
+    } else {
+        request = m_pending.size();
+        m_pending.push_back(PendingPath());
+    }
+    PendingPath & pending = m_pending[request];
+    pending.used = true;
+    pending.done = false;
+    pending.fromX = fromX;
+    pending.fromY = fromY;
+    pending.toX = toX;
+    pending.toY = toY;
+    pending.layer = layer;
+    pending.path.clear();
+    m_queue.push_back(request);
+    return request;
+}
+
+bool Pathfinder::done(Request request)
+{
+    return m_pending[request].done;
+}
+
+std::vector<Pathfinder::Waypoint> * Pathfinder::path(Request request)
+{
+    return &m_pending[request].path;
+}
+
+void Pathfinder::release(Request request)
+{
+    // it might still be in the queue. update skips it
+    m_pending[request].used = false;
+    m_freeRequests.push_back(request);
+}
+
+void Pathfinder::update()
+{
+    // counting steps instead of time keeps which paths are ready when the
+    // same from run to run, so replays come out the same
+    long long stop = m_steps + c_updateSteps;
+    while (m_queue.size() > 0 && m_steps < stop) {
+        PendingPath & pending = m_pending[m_queue.front()];
+        m_queue.pop_front();
+        // released, or asked for again after being released
+        if (!pending.used || pending.done)
+            continue;
+        findPath(pending.path, pending.fromX, pending.fromY, pending.toX, pending.toY, pending.layer);
+        pending.done = true;
+    }
+}
+
+void Pathfinder::tilesChanged(double left, double top, double width, double height)
+{
+    // a tile on the edge of a cluster changes the entrances of the cluster
+    // next door too, so take in one more tile all around
+    std::vector<int> placements;
+    m_world->placementsIntersecting(placements, left - Tile::size, top - Tile::size,
+                                    width + Tile::size * 2.0, height + Tile::size * 2.0);
+    for (unsigned int i = 0; i < placements.size(); i++) {
+        World::MapPlacement * placement = m_world->placement(placements[i]);
+        MapClusters & clusters = m_maps[placements[i]];
+        if (clusters.generation != placement->generation)
+            continue;
+        double clusterPixels = c_clusterSize * Tile::size;
+        int startX = Utils::max((int)std::floor((left - Tile::size - placement->left) / clusterPixels), 0);
+        int startY = Utils::max((int)std::floor((top - Tile::size - placement->top) / clusterPixels), 0);
+        int endX = Utils::min((int)std::floor((left + width + Tile::size - placement->left) / clusterPixels), clusters.clustersX - 1);
+        int endY = Utils::min((int)std::floor((top + height + Tile::size - placement->top) / clusterPixels), clusters.clustersY - 1);
+        for (int layer = 0; layer < clusters.layers; layer++) {
+            for (int y = startY; y <= endY; y++) {
+                for (int x = startX; x <= endX; x++)
+                    clusters.clusters[(layer * clusters.clustersY + y) * clusters.clustersX + x].built = false;
+            }
+        }
+    }
+    m_changes++;
+}
+
+bool Pathfinder::locate(double x, double y, int layer, Place & place)
+{
+    place.placement = m_world->placementAt(x, y);
+    if (place.placement == -1)
+        return false;
+    World::MapPlacement * placement = m_world->placement(place.placement);
+    if (placement->map == NULL)
+        return false;
+    // the right and bottom edges belong to the map too
+    place.x = Utils::min((int)((x - placement->left) / Tile::size), placement->map->tileCountX() - 1);
+    place.y = Utils::min((int)((y - placement->top) / Tile::size), placement->map->tileCountY() - 1);
+    return walkable(place.placement, place.x, place.y, layer);
+}
+
+bool Pathfinder::walkable(int placement, int x, int y, int layer)
+{
+    Map * map = m_world->placement(placement)->map;
+    if (map == NULL || layer < 0 || layer >= map->layerCount() ||
+        x < 0 || x >= map->tileCountX() || y < 0 || y >= map->tileCountY())
+    {
+        return false;
+    }
+    Tile * tile = map->tile(x, y, layer);
+    return tile->hasMinPresence(Tile::ppFloor) && !tile->hasMinPresence(m_minPresence);
+}
+
+bool Pathfinder::neighbor(int placement, int x, int y, int dx, int dy, Place & place)
+{
+    Map * map = m_world->placement(placement)->map;
+    place.placement = placement;
+    place.x = x + dx;
+    place.y = y + dy;
+    if (0 <= place.x && place.x < map->tileCountX() && 0 <= place.y && place.y < map->tileCountY())
+        return true;
+
+    // over the edge, into whatever map is there
+    double centerX = map->left() + (place.x + 0.5) * Tile::size;
+    double centerY = map->top() + (place.y + 0.5) * Tile::size;
+    place.placement = m_world->placementAt(centerX, centerY);
+    if (place.placement == -1 || place.placement == placement)
+        return false;
+    World::MapPlacement * other = m_world->placement(place.placement);
+    if (other->map == NULL)
+        return false;
+    double otherX = (centerX - other->left) / Tile::size - 0.5;
+    double otherY = (centerY - other->top) / Tile::size - 0.5;
+    place.x = (int)std::floor(otherX + 0.5);
+    place.y = (int)std::floor(otherY + 0.5);
+    // tiles that don't line up would need entrances that aren't one tile
+    // wide
+    return std::fabs(otherX - place.x) < 0.001 && std::fabs(otherY - place.y) < 0.001;
+}
+
+Pathfinder::MapClusters * Pathfinder::mapClusters(int placement, int layer)
+{
+    World::MapPlacement * where = m_world->placement(placement);
+    if (where->map == NULL)
+        return NULL;
+    MapClusters & clusters = m_maps[placement];
+    if (clusters.generation != where->generation) {
+        // not the map the clusters were made for, if there were any
+        clusters.generation = where->generation;
+        clusters.layers = where->map->layerCount();
+        clusters.clustersX = (where->map->tileCountX() + c_clusterSize - 1) / c_clusterSize;
+        clusters.clustersY = (where->map->tileCountY() + c_clusterSize - 1) / c_clusterSize;
+        Cluster unbuilt;
+        unbuilt.built = false;
+        clusters.clusters.assign(clusters.layers * clusters.clustersX * clusters.clustersY, unbuilt);
+    }
+    if (layer < 0 || layer >= clusters.layers)
+        return NULL;
+    return &clusters;
+}
+
+int Pathfinder::clusterIndex(MapClusters * clusters, int layer, int x, int y)
+{
+    return (layer * clusters->clustersY + y / c_clusterSize) * clusters->clustersX + x / c_clusterSize;
+}
+
+Pathfinder::Cluster * Pathfinder::cluster(int placement, int layer, int x, int y, int & index)
+{
+    MapClusters * clusters = mapClusters(placement, layer);
+    if (clusters == NULL)
+        return NULL;
+    index = clusterIndex(clusters, layer, x, y);
+    Cluster & found = clusters->clusters[index];
+    for (unsigned int i = 0; found.built && i < found.neighbors.size(); i++) {
+        if (m_world->placement(found.neighbors[i].first)->generation != found.neighbors[i].second)
+            found.built = false;
+    }
+    if (!found.built)
+        buildCluster(placement, layer, index);
+    return &found;
+}
+
+void Pathfinder::buildCluster(int placement, int layer, int index)
+{
+    MapClusters & clusters = m_maps[placement];
+    Cluster & cluster = clusters.clusters[index];
+    Map * map = m_world->placement(placement)->map;
+    int withinLayer = index % (clusters.clustersX * clusters.clustersY);
+    int left = withinLayer % clusters.clustersX * c_clusterSize;
+    int top = withinLayer / clusters.clustersX * c_clusterSize;
+    int width = Utils::min(c_clusterSize, map->tileCountX() - left);
+    int height = Utils::min(c_clusterSize, map->tileCountY() - top);
+
+    cluster.walkable.assign(c_clusterSize * c_clusterSize, 0);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++)
+            cluster.walkable[y * c_clusterSize + x] = walkable(placement, left + x, top + y, layer);
+    }
+
+    // the borders go left to right and top to bottom from both sides, so
+    // the clusters on either side come up with the same entrances
+    cluster.entrances.clear();
+    cluster.neighbors.clear();
+    addEntrances(cluster, placement, layer, left, top, 1, 0, width, 0, -1);
+    addEntrances(cluster, placement, layer, left + width - 1, top, 0, 1, height, 1, 0);
+    addEntrances(cluster, placement, layer, left, top + height - 1, 1, 0, width, 0, 1);
+    addEntrances(cluster, placement, layer, left, top, 0, 1, height, -1, 0);
+
+    int count = cluster.entrances.size();
+    cluster.costs.resize(count * count);
+    for (int i = 0; i < count; i++) {
+        searchCluster(placement, layer, cluster.entrances[i].x, cluster.entrances[i].y, -1, -1);
+        for (int j = 0; j < count; j++)
+            cluster.costs[i * count + j] = localCost(placement, cluster.entrances[j].x, cluster.entrances[j].y, layer);
+    }
+    cluster.built = true;
+}
+
+void Pathfinder::addEntrances(Cluster & cluster, int placement, int layer, int startX, int startY,
+                              int stepX, int stepY, int length, int dx, int dy)
+{
+    // runs of tiles you can cross the border at. a run ends where the tiles
+    // across stop following on from each other or go into another cluster
+    int runStart = -1;
+    Place previous;
+    previous.placement = -1;
+    previous.x = previous.y = 0;
+    for (int i = 0; i <= length; i++) {
+        bool open = false;
+        Place across;
+        if (i < length) {
+            int x = startX + stepX * i, y = startY + stepY * i;
+            bool lined = neighbor(placement, x, y, dx, dy, across);
+            if (across.placement != placement && across.placement != -1)
+                addDependency(cluster, across.placement);
+            open = lined && walkable(placement, x, y, layer) && walkable(across.placement, across.x, across.y, layer);
+        }
+        bool follows = open && runStart != -1 && across.placement == previous.placement &&
+                       across.x == previous.x + stepX && across.y == previous.y + stepY &&
+                       across.x / c_clusterSize == previous.x / c_clusterSize &&
+                       across.y / c_clusterSize == previous.y / c_clusterSize;
+        if (runStart != -1 && !follows) {
+            // wide runs get one at each end so paths don't all squeeze
+            // through the middle
+            int run = i - runStart;
+            int first = runStart + (run >= c_wideEntrance ? 0 : (run - 1) / 2);
+            int last = run >= c_wideEntrance ? i - 1 : first;
+            for (int j = first; j <= last; j += Utils::max(last - first, 1)) {
+                Entrance entrance;
+                entrance.x = startX + stepX * j;
+                entrance.y = startY + stepY * j;
+                neighbor(placement, entrance.x, entrance.y, dx, dy, entrance.to);
+                entrance.stamp = 0;
+                entrance.closed = false;
+                entrance.cost = 0.0;
+                entrance.parentPlacement = entrance.parentCluster = entrance.parentEntrance = -1;
+                cluster.entrances.push_back(entrance);
+            }
+            runStart = -1;
+        }
+        if (open && runStart == -1)
+            runStart = i;
+        if (open)
+            previous = across;
+    }
+}
+
+void Pathfinder::addDependency(Cluster & cluster, int placement)
+{
+    for (unsigned int i = 0; i < cluster.neighbors.size(); i++) {
+        if (cluster.neighbors[i].first == placement)
+            return;
+    }
+    cluster.neighbors.push_back(std::make_pair(placement, m_world->placement(placement)->generation));
+}
+
+void Pathfinder::searchCluster(int placement, int layer, int x, int y, int goalX, int goalY)
+{
+    MapClusters & clusters = m_maps[placement];
+    std::vector<char> & walkable = clusters.clusters[clusterIndex(&clusters, layer, x, y)].walkable;
+    Map * map = m_world->placement(placement)->map;
+    m_localSearch++;
+    m_localPlacement = placement;
+    m_localLeft = x / c_clusterSize * c_clusterSize;
+    m_localTop = y / c_clusterSize * c_clusterSize;
+    m_localWidth = Utils::min(c_clusterSize, map->tileCountX() - m_localLeft);
+    m_localHeight = Utils::min(c_clusterSize, map->tileCountY() - m_localTop);
+    int goal = goalX == -1 ? -1 : (goalY - m_localTop) * c_clusterSize + goalX - m_localLeft;
+    int localGoalX = goalX - m_localLeft, localGoalY = goalY - m_localTop;
+
+    int start = (y - m_localTop) * c_clusterSize + x - m_localLeft;
+    m_localCost[start] = 0.0;
+    m_localParent[start] = -1;
+    m_localStamp[start] = m_localSearch;
+    m_localOpen.clear();
+    m_localOpen.push_back(std::make_pair(0.0, start));
+    while (m_localOpen.size() > 0) {
+        std::pop_heap(m_localOpen.begin(), m_localOpen.end(), std::greater<std::pair<double, int> >());
+        int tile = m_localOpen.back().second;
+        m_localOpen.pop_back();
+        if (m_localClosed[tile] == m_localSearch)
+            continue;
+        m_localClosed[tile] = m_localSearch;
+        double cost = m_localCost[tile];
+        m_steps++;
+        if (tile == goal)
+            return;
+
+        int tileX = tile % c_clusterSize, tileY = tile / c_clusterSize;
+        for (int dy = -1; dy <= 1; dy++) {
+            for (int dx = -1; dx <= 1; dx++) {
+                int nextX = tileX + dx, nextY = tileY + dy;
+                if ((dx == 0 && dy == 0) || nextX < 0 || nextX >= m_localWidth || nextY < 0 || nextY >= m_localHeight)
+                    continue;
+                int next = nextY * c_clusterSize + nextX;
+                if (!walkable[next])
+                    continue;
+                // no cutting corners
+                if (dx != 0 && dy != 0 && !(walkable[tileY * c_clusterSize + nextX] && walkable[nextY * c_clusterSize + tileX]))
+                    continue;
+                double nextCost = cost + (dx != 0 && dy != 0 ? c_diagonalCost : 1.0);
+                if (m_localStamp[next] == m_localSearch && m_localCost[next] <= nextCost)
+                    continue;
+                m_localStamp[next] = m_localSearch;
+                m_localCost[next] = nextCost;
+                m_localParent[next] = tile;
+                double estimate = 0.0;
+                if (goal != -1) {
+                    int distanceX = std::abs(nextX - localGoalX), distanceY = std::abs(nextY - localGoalY);
+                    estimate = Utils::max(distanceX, distanceY) + (c_diagonalCost - 1.0) * Utils::min(distanceX, distanceY);
+                }
+                m_localOpen.push_back(std::make_pair(nextCost + estimate, next));
+                std::push_heap(m_localOpen.begin(), m_localOpen.end(), std::greater<std::pair<double, int> >());
+            }
+        }
+    }
+}
+
+double Pathfinder::localCost(int placement, int x, int y, int layer)
+{
+    int localX = x - m_localLeft, localY = y - m_localTop;
+    if (placement != m_localPlacement || localX < 0 || localX >= m_localWidth || localY < 0 || localY >= m_localHeight)
+        return -1.0;
+    int tile = localY * c_clusterSize + localX;
+    return m_localStamp[tile] == m_localSearch ? m_localCost[tile] : -1.0;
+}
+
+void Pathfinder::appendLocalPath(std::vector<Waypoint> & path, int placement, int layer, int x, int y)
+{
+    assert(localCost(placement, x, y, layer) >= 0.0);
+    m_localTiles.clear();
+    for (int tile = (y - m_localTop) * c_clusterSize + x - m_localLeft; m_localParent[tile] != -1; tile = m_localParent[tile])
+        m_localTiles.push_back(tile);
+    for (int i = m_localTiles.size() - 1; i >= 0; i--) {
+        addWaypoint(path, placement, m_localLeft + m_localTiles[i] % c_clusterSize,
+                    m_localTop + m_localTiles[i] / c_clusterSize);
+    }
+}
+
+bool Pathfinder::search(std::vector<Waypoint> & path, int layer, const Place & from, const Place & to)
+{
+    int fromIndex, toIndex;
+    Cluster * fromCluster = cluster(from.placement, layer, from.x, from.y, fromIndex);
+    Cluster * toCluster = cluster(to.placement, layer, to.x, to.y, toIndex);
+    if (fromCluster == NULL || toCluster == NULL)
+        return false;
+    addWaypoint(path, from.placement, from.x, from.y);
+
+    // close enough to get there without leaving the cluster
+    if (from.placement == to.placement && fromIndex == toIndex) {
+        searchCluster(from.placement, layer, from.x, from.y, to.x, to.y);
+        if (localCost(to.placement, to.x, to.y, layer) >= 0.0) {
+            appendLocalPath(path, to.placement, layer, to.x, to.y);
+            return true;
+        }
+    }
+
+    // the way out of the goal's cluster is the way in backwards
+    searchCluster(to.placement, layer, to.x, to.y, -1, -1);
+    m_goalCosts.resize(toCluster->entrances.size());
+    bool goalReachable = false;
+    for (unsigned int i = 0; i < toCluster->entrances.size(); i++) {
+        m_goalCosts[i] = localCost(to.placement, toCluster->entrances[i].x, toCluster->entrances[i].y, layer);
+        goalReachable = goalReachable || m_goalCosts[i] >= 0.0;
+    }
+    // walled in, which would otherwise take searching everywhere the start
+    // can get to to find out
+    if (!goalReachable) {
+        path.clear();
+        return false;
+    }
+
+    // A* over the entrances, starting from every way out of the start's
+    // cluster
+    m_stamp++;
+    m_open.clear();
+    searchCluster(from.placement, layer, from.x, from.y, -1, -1);
+    for (unsigned int i = 0; i < fromCluster->entrances.size(); i++) {
+        double cost = localCost(from.placement, fromCluster->entrances[i].x, fromCluster->entrances[i].y, layer);
+        if (cost >= 0.0)
+            relax(from.placement, fromIndex, i, cost, to, -1, -1, -1);
+    }
+
+    // the goal goes in the open list as a node with no entrance
+    bool found = false;
+    double bestCost = 0.0;
+    OpenNode best;
+    best.placement = best.cluster = best.entrance = -1;
+    while (m_open.size() > 0) {
+        std::pop_heap(m_open.begin(), m_open.end(), openNodeGreater);
+        OpenNode node = m_open.back();
+        m_open.pop_back();
+        if (node.entrance == -1)
+            break;
+        Entrance & here = entrance(node.placement, node.cluster, node.entrance);
+        if (here.closed)
+            continue;
+        here.closed = true;
+        m_steps++;
+
+        if (node.placement == to.placement && node.cluster == toIndex && m_goalCosts[node.entrance] >= 0.0) {
+            double cost = here.cost + m_goalCosts[node.entrance];
+            if (!found || cost < bestCost) {
+                found = true;
+                bestCost = cost;
+                best = node;
+                OpenNode goal;
+                goal.cost = cost;
+                goal.placement = goal.cluster = goal.entrance = -1;
+                m_open.push_back(goal);
+                std::push_heap(m_open.begin(), m_open.end(), openNodeGreater);
+            }
+        }
+
+        Cluster & cluster = m_maps[node.placement].clusters[node.cluster];
+        int count = cluster.entrances.size();
+        for (int i = 0; i < count; i++) {
+            double cost = cluster.costs[node.entrance * count + i];
+            if (i != node.entrance && cost >= 0.0)
+                relax(node.placement, node.cluster, i, here.cost + cost, to, node.placement, node.cluster, node.entrance);
+        }
+
+        // through the entrance into the next cluster, to the entrance
+        // there that leads back
+        int acrossIndex;
+        Cluster * across = this->cluster(here.to.placement, layer, here.to.x, here.to.y, acrossIndex);
+        if (across == NULL)
+            continue;
+        for (unsigned int i = 0; i < across->entrances.size(); i++) {
+            Entrance & back = across->entrances[i];
+            if (back.x == here.to.x && back.y == here.to.y && back.to.placement == node.placement &&
+                back.to.x == here.x && back.to.y == here.y)
+            {
+                relax(here.to.placement, acrossIndex, i, here.cost + 1.0, to, node.placement, node.cluster, node.entrance);
+                break;
+            }
+        }
+    }
+    if (!found) {
+        path.clear();
+        return false;
+    }
+
+    // back from the goal to the start, then walk it forwards filling in the
+    // tiles between entrances
+    m_route.clear();
+    for (OpenNode node = best; node.entrance != -1; ) {
+        m_route.push_back(node);
+        Entrance & step = entrance(node.placement, node.cluster, node.entrance);
+        node.placement = step.parentPlacement;
+        node.cluster = step.parentCluster;
+        node.entrance = step.parentEntrance;
+    }
+    for (int i = m_route.size() - 1; i >= 0; i--) {
+        OpenNode & node = m_route[i];
+        Entrance & step = entrance(node.placement, node.cluster, node.entrance);
+        if (i == (int)m_route.size() - 1) {
+            searchCluster(from.placement, layer, from.x, from.y, step.x, step.y);
+            appendLocalPath(path, node.placement, layer, step.x, step.y);
+        } else if (m_route[i + 1].placement != node.placement || m_route[i + 1].cluster != node.cluster) {
+            // one step over the border
+            addWaypoint(path, node.placement, step.x, step.y);
+        } else {
+            Entrance & previous = entrance(m_route[i + 1].placement, m_route[i + 1].cluster, m_route[i + 1].entrance);
+            searchCluster(node.placement, layer, previous.x, previous.y, step.x, step.y);
+            appendLocalPath(path, node.placement, layer, step.x, step.y);
+        }
+    }
+    Entrance & last = entrance(best.placement, best.cluster, best.entrance);
+    searchCluster(to.placement, layer, last.x, last.y, to.x, to.y);
+    appendLocalPath(path, to.placement, layer, to.x, to.y);
+    return true;
+}
+
+Pathfinder::Entrance & Pathfinder::entrance(int placement, int cluster, int entrance)
+{
+    return m_maps[placement].clusters[cluster].entrances[entrance];
+}
+
+void Pathfinder::relax(int placement, int cluster, int entrance, double cost, const Place & goal,
+                       int parentPlacement, int parentCluster, int parentEntrance)
+{
+    Entrance & node = this->entrance(placement, cluster, entrance);
+    if (node.stamp == m_stamp && (node.closed || node.cost <= cost))
+        return;
+    node.stamp = m_stamp;
+    node.closed = false;
+    node.cost = cost;
+    node.parentPlacement = parentPlacement;
+    node.parentCluster = parentCluster;
+    node.parentEntrance = parentEntrance;
+
+    Place here;
+    here.placement = placement;
+    here.x = node.x;
+    here.y = node.y;
+    OpenNode open;
+    open.cost = cost + estimate(here, goal);
+    open.placement = placement;
+    open.cluster = cluster;
+    open.entrance = entrance;
+    m_open.push_back(open);
+    std::push_heap(m_open.begin(), m_open.end(), openNodeGreater);
+}
+
+double Pathfinder::estimate(const Place & from, const Place & to)
+{
+    World::MapPlacement * fromPlacement = m_world->placement(from.placement);
+    World::MapPlacement * toPlacement = m_world->placement(to.placement);
+    double dx = std::fabs(fromPlacement->left / Tile::size + from.x - toPlacement->left / Tile::size - to.x);
+    double dy = std::fabs(fromPlacement->top / Tile::size + from.y - toPlacement->top / Tile::size - to.y);
+    return Utils::max(dx, dy) + (c_diagonalCost - 1.0) * Utils::min(dx, dy);
+}
+
+void Pathfinder::addWaypoint(std::vector<Waypoint> & path, int placement, int x, int y)
+{
+    World::MapPlacement * where = m_world->placement(placement);
+    Waypoint waypoint;
+    waypoint.x = where->left + (x + 0.5) * Tile::size;
+    waypoint.y = where->top + (y + 0.5) * Tile::size;
+    path.push_back(waypoint);
+}
+
+bool Pathfinder::openNodeGreater(const OpenNode & node1, const OpenNode & node2)
+{
+    return node1.cost > node2.cost;
+}
+
+Pathfinder::CachedPath & Pathfinder::cacheEntry(int layer, const Place & from, const Place & to)
+{
+    unsigned int hash = (unsigned int)layer * 83492791u;
+    hash ^= (unsigned int)from.placement * 2654435761u ^ (unsigned int)from.x * 73856093u ^ (unsigned int)from.y * 19349663u;
+    hash = hash * 31u ^ (unsigned int)to.placement * 2654435761u ^ (unsigned int)to.x * 73856093u ^ (unsigned int)to.y * 19349663u;
+    hash ^= hash >> 16;
+    return m_cache[hash % c_cacheSize];
+}
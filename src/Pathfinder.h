@@ -0,0 +1,202 @@
+#ifndef _PATHFINDER_H_
+#define _PATHFINDER_H_
+
+#include "Tile.h"
+
+#include <vector>
+#include <deque>
+
+class World;
+
+// Pathfinder finds paths over the tiles of a World with HPA*: each map is cut
+// into square clusters of tiles, the places where you can walk from one
+// cluster into the next become entrances, and the distances between the
+// entrances of a cluster are worked out once and kept. a search goes from
+// entrance to entrance, which is a lot fewer steps than tile to tile, and
+// only the clusters along the way get walked tile by tile at the end.
+// clusters are built the first time a search needs them, and thrown out
+// when their map streams out or their tiles change.
+// you can walk on tiles that have a floor and don't stick up as far as
+// minPresence. diagonals count as walls. paths stay on one layer, and only
+// cross between maps whose tiles line up.
+class Pathfinder
+{
+public:
+    typedef struct {
+        double x, y;
+    } Waypoint;
+    typedef int Request;
+
+    Pathfinder(World * world, Tile::PhysicalPresence minPresence);
+
+    // the centers of the tiles from the one at from to the one at to. empty
+    // and false if there's no way there
+    bool findPath(std::vector<Waypoint> & path, double fromX, double fromY,
+                  double toX, double toY, int layer);
+
+    // ask for a path to be found during a later update. release it when
+    // you're done with it
+    Request request(double fromX, double fromY, double toX, double toY, int layer);
+    // whether an update has gotten to it yet
+    bool done(Request request);
+    // the path once it's done. empty if there's no way there
+    std::vector<Waypoint> * path(Request request);
+    void release(Request request);
+    // work through the requests, until a frame's worth of searching is done
+    void update();
+
+    // tiles in the rectangle, on every layer, changed since they were
+    // loaded
+    void tilesChanged(double left, double top, double width, double height);
+
+private: //variables
+    // a tile in the world
+    typedef struct {
+        int placement, x, y;
+    } Place;
+
+    typedef struct {
+        // in the cluster's map
+        int x, y;
+        // the tile it leads to in the next cluster
+        Place to;
+        // search state. only good when stamp is the current search
+        int stamp;
+        bool closed;
+        double cost;
+        int parentCluster, parentEntrance;
+        int parentPlacement;
+    } Entrance;
+
+    typedef struct {
+        bool built;
+        // which tiles you can walk on, by tile in the cluster
+        std::vector<char> walkable;
+        std::vector<Entrance> entrances;
+        // cost from each entrance to each other one, without leaving the
+        // cluster. -1 if there's no way
+        std::vector<double> costs;
+        // the maps across the border, and their generations when it was
+        // built. if one streams in or out, the entrances change
+        std::vector<std::pair<int, int> > neighbors;
+    } Cluster;
+
+    // the clusters of one map
+    typedef struct {
+        // World::MapPlacement::generation when they were made. -1 for never
+        int generation;
+        int layers, clustersX, clustersY;
+        std::vector<Cluster> clusters;
+    } MapClusters;
+
+    typedef struct {
+        double cost;
+        int placement, cluster, entrance;
+    } OpenNode;
+
+    typedef struct {
+        bool used, done;
+        double fromX, fromY, toX, toY;
+        int layer;
+        std::vector<Waypoint> path;
+    } PendingPath;
+
+    typedef struct {
+        // World::mapGeneration and m_changes when it was found
+        int mapGeneration, changes;
+        int layer;
+        Place from, to;
+        bool found;
+        std::vector<Waypoint> path;
+    } CachedPath;
+
+    static const int c_clusterSize;
+    // a gap between clusters at least this wide gets an entrance at each
+    // end instead of one in the middle
+    static const int c_wideEntrance;
+    static const double c_diagonalCost;
+    // how many steps update searches per frame. it finishes the path it's
+    // on, so it can go over a little
+    static const int c_updateSteps;
+    static const int c_cacheSize;
+
+    World * m_world;
+    Tile::PhysicalPresence m_minPresence;
+    std::vector<MapClusters> m_maps;
+    // tilesChanged calls, for the cache
+    int m_changes;
+
+    // searches so far. marks which search state is current
+    int m_stamp;
+    // steps taken by searches, for update's budget
+    long long m_steps;
+    std::vector<OpenNode> m_open;
+    // what getting to the goal from each entrance of its cluster costs
+    std::vector<double> m_goalCosts;
+    // the entrances found by the search, goal first
+    std::vector<OpenNode> m_route;
+
+    // scratch for searches inside one cluster, indexed by tile in the
+    // cluster
+    std::vector<double> m_localCost;
+    std::vector<int> m_localParent;
+    std::vector<int> m_localStamp;
+    std::vector<int> m_localClosed;
+    std::vector<std::pair<double, int> > m_localOpen;
+    std::vector<int> m_localTiles;
+    // which search the scratch is from, and the cluster it was in
+    int m_localSearch;
+    int m_localPlacement, m_localLeft, m_localTop, m_localWidth, m_localHeight;
+
+    std::vector<PendingPath> m_pending;
+    std::deque<Request> m_queue;
+    std::vector<Request> m_freeRequests;
+
+    std::vector<CachedPath> m_cache;
+
+private: //methods
+    // where in the world the point is, if it's on a tile you can walk on
+    bool locate(double x, double y, int layer, Place & place);
+    bool walkable(int placement, int x, int y, int layer);
+    // the tile next door in direction dx, dy, which might be in another map.
+    // place.placement is the map it would be in even if that isn't
+    // resident, or -1 if there's no map there
+    bool neighbor(int placement, int x, int y, int dx, int dy, Place & place);
+
+    // the clusters of the placement, made fresh if its map changed. NULL if
+    // it isn't resident or doesn't have the layer
+    MapClusters * mapClusters(int placement, int layer);
+    int clusterIndex(MapClusters * clusters, int layer, int x, int y);
+    // the cluster the tile is in, built if it has to be
+    Cluster * cluster(int placement, int layer, int x, int y, int & index);
+    void buildCluster(int placement, int layer, int index);
+    // add the entrances along one side of a cluster
+    void addEntrances(Cluster & cluster, int placement, int layer, int startX, int startY,
+                      int stepX, int stepY, int length, int dx, int dy);
+    // the cluster has to be rebuilt if the placement's map changes
+    void addDependency(Cluster & cluster, int placement);
+
+    // dijkstra from the tile, inside the cluster it's in, which has to be
+    // built. with a goal tile it's A* instead, and stops when it gets there
+    void searchCluster(int placement, int layer, int x, int y, int goalX, int goalY);
+    // what searchCluster found for the tile. -1 if it can't get there
+    double localCost(int placement, int x, int y, int layer);
+    // add the tiles searchCluster went through to get to the tile, the
+    // first one left out
+    void appendLocalPath(std::vector<Waypoint> & path, int placement, int layer, int x, int y);
+
+    bool search(std::vector<Waypoint> & path, int layer, const Place & from, const Place & to);
+    Entrance & entrance(int placement, int cluster, int entrance);
+    // a way to the entrance that costs cost. it goes in the open list if
+    // it's the best one so far
+    void relax(int placement, int cluster, int entrance, double cost, const Place & goal,
+               int parentPlacement, int parentCluster, int parentEntrance);
+    // octile distance in tiles
+    double estimate(const Place & from, const Place & to);
+    void addWaypoint(std::vector<Waypoint> & path, int placement, int x, int y);
+    static bool openNodeGreater(const OpenNode & node1, const OpenNode & node2);
+
+    CachedPath & cacheEntry(int layer, const Place & from, const Place & to);
+};
+
+#endif
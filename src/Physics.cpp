@@ -2,6 +2,69 @@
 
 #include "Utils.h"
 #include "Debug.h"
+#include "Tile.h"
+
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// a handful of wrappers so the batch functions can be written once for
+// whichever vector width is available.
+#if defined(__AVX__)
+typedef __m256d Lanes;
+static const int c_laneCount = 4;
+static inline Lanes lanesLoad(const double * p) { return _mm256_loadu_pd(p); }
+static inline void lanesStore(double * p, Lanes a) { _mm256_storeu_pd(p, a); }
+static inline Lanes lanesZero() { return _mm256_setzero_pd(); }
+static inline Lanes lanesAdd(Lanes a, Lanes b) { return _mm256_add_pd(a, b); }
+static inline Lanes lanesSub(Lanes a, Lanes b) { return _mm256_sub_pd(a, b); }
+static inline Lanes lanesMul(Lanes a, Lanes b) { return _mm256_mul_pd(a, b); }
+static inline Lanes lanesDiv(Lanes a, Lanes b) { return _mm256_div_pd(a, b); }
+static inline Lanes lanesSqrt(Lanes a) { return _mm256_sqrt_pd(a); }
+static inline Lanes lanesLessThan(Lanes a, Lanes b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+static inline Lanes lanesAnd(Lanes a, Lanes b) { return _mm256_and_pd(a, b); }
+static inline Lanes lanesAndNot(Lanes a, Lanes b) { return _mm256_andnot_pd(a, b); }
+// mask ? a : b
+static inline Lanes lanesSelect(Lanes mask, Lanes a, Lanes b) { return _mm256_blendv_pd(b, a, mask); }
+#elif defined(__SSE2__)
+typedef __m128d Lanes;
+static const int c_laneCount = 2;
+static inline Lanes lanesLoad(const double * p) { return _mm_loadu_pd(p); }
+static inline void lanesStore(double * p, Lanes a) { _mm_storeu_pd(p, a); }
+static inline Lanes lanesZero() { return _mm_setzero_pd(); }
+static inline Lanes lanesAdd(Lanes a, Lanes b) { return _mm_add_pd(a, b); }
+static inline Lanes lanesSub(Lanes a, Lanes b) { return _mm_sub_pd(a, b); }
+static inline Lanes lanesMul(Lanes a, Lanes b) { return _mm_mul_pd(a, b); }
+static inline Lanes lanesDiv(Lanes a, Lanes b) { return _mm_div_pd(a, b); }
+static inline Lanes lanesSqrt(Lanes a) { return _mm_sqrt_pd(a); }
+static inline Lanes lanesLessThan(Lanes a, Lanes b) { return _mm_cmplt_pd(a, b); }
+static inline Lanes lanesAnd(Lanes a, Lanes b) { return _mm_and_pd(a, b); }
+static inline Lanes lanesAndNot(Lanes a, Lanes b) { return _mm_andnot_pd(a, b); }
+// mask ? a : b
+static inline Lanes lanesSelect(Lanes mask, Lanes a, Lanes b) { return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b)); }
+#else
+static const int c_laneCount = 0;
+#endif
+
+// a quarter of a tile
+const double Physics::sweepDistance = Tile::size * 0.25;
+
+#if defined(__AVX__) || defined(__SSE2__)
+// same math as the single pointAndCircle. lanes that don't overlap get 0
+static inline void lanesPointAndCircle(Lanes px1, Lanes py1, Lanes cx2, Lanes cy2, Lanes r2, Lanes & out_dx, Lanes & out_dy)
+{
+    Lanes dx = lanesSub(cx2, px1), dy = lanesSub(cy2, py1);
+    Lanes distance = lanesSqrt(lanesAdd(lanesMul(dx, dx), lanesMul(dy, dy)));
+    Lanes overlap = lanesSub(r2, distance);
+    Lanes overlapping = lanesLessThan(lanesZero(), overlap);
+    out_dx = lanesAnd(overlapping, lanesMul(lanesDiv(dx, distance), overlap));
+    out_dy = lanesAnd(overlapping, lanesMul(lanesDiv(dy, distance), overlap));
+}
+#endif
 
 void Physics::circleAndCircle(double cx1, double cy1, double r1, double cx2, double cy2, double r2, double & out_dx, double & out_dy) {
     double distance = Utils::distance(cx1, cy1, cx2, cy2);
@@ -120,3 +183,209 @@ void Physics::pointAndCircle(double px1, double py1, double cx2, double cy2, dou
         out_dy = 0.0;
     }
 }
+
+bool Physics::sweepCircleAndCircle(double cx1, double cy1, double r1, double cx2, double cy2, double r2,
+                                   double dx, double dy, double & t, double & out_nx, double & out_ny)
+{
+    return sweepPointAndCircle(cx1, cy1, cx2, cy2, r1 + r2, dx, dy, t, out_nx, out_ny);
+}
+
+bool Physics::sweepSquareAndCircle(double cx1, double cy1, double a1, double cx2, double cy2, double r2,
+                                   double dx, double dy, double & t, double & out_nx, double & out_ny)
+{
+    double left = cx1 - a1, right = cx1 + a1, top = cy1 - a1, bottom = cy1 + a1;
+    double corners[5][2] = {
+        {left, top}, {right, top}, {right, bottom}, {left, bottom}, {left, top},
+    };
+    // starting inside is left to squareAndCircle
+    if (cx2 > left && cx2 < right && cy2 > top && cy2 < bottom)
+        return false;
+    // the first side it hits
+    bool hit = false;
+    t = 1.0;
+    for (int i = 0; i < 4; i++) {
+        double sideT, nx, ny;
+        if (sweepSegmentAndCircle(corners[i][0], corners[i][1], corners[i + 1][0], corners[i + 1][1],
+                                  cx2, cy2, r2, dx, dy, sideT, nx, ny) && (! hit || sideT < t))
+        {
+            hit = true;
+            t = sideT;
+            out_nx = nx;
+            out_ny = ny;
+        }
+    }
+    return hit;
+}
+
+bool Physics::sweepPointAndCircle(double px1, double py1, double cx2, double cy2, double r2,
+                                  double dx, double dy, double & t, double & out_nx, double & out_ny)
+{
+    // solve |c + t * d - p| = r for the smaller t
+    double mx = cx2 - px1, my = cy2 - py1;
+    double a = dx * dx + dy * dy;
+    double b = mx * dx + my * dy;
+    double c = mx * mx + my * my - r2 * r2;
+    if (b >= 0.0)
+        return false; // standing still or moving away
+    if (c <= 0.0) {
+        // already touching
+        double distance = std::sqrt(mx * mx + my * my);
+        if (distance == 0.0)
+            return false;
+        t = 0.0;
+        out_nx = mx / distance;
+        out_ny = my / distance;
+        return true;
+    }
+    double discriminant = b * b - a * c;
+    if (discriminant < 0.0)
+        return false;
+    t = (-b - std::sqrt(discriminant)) / a;
+    if (t > 1.0)
+        return false;
+    out_nx = (mx + dx * t) / r2;
+    out_ny = (my + dy * t) / r2;
+    return true;
+}
+
+bool Physics::sweepSegmentAndCircle(double ax1, double ay1, double bx1, double by1, double cx2, double cy2, double r2,
+                                    double dx, double dy, double & t, double & out_nx, double & out_ny)
+{
+    double ex = bx1 - ax1, ey = by1 - ay1;
+    double length = std::sqrt(ex * ex + ey * ey);
+    if (length == 0.0)
+        return sweepPointAndCircle(ax1, ay1, cx2, cy2, r2, dx, dy, t, out_nx, out_ny);
+    // the side of the line the circle starts on
+    double nx = -ey / length, ny = ex / length;
+    double mx = cx2 - ax1, my = cy2 - ay1;
+    double distance = mx * nx + my * ny;
+    if (distance < 0.0) {
+        nx = -nx;
+        ny = -ny;
+        distance = -distance;
+    }
+
+    // the flat part of the segment. if it hits there it's the first thing
+    // it hits
+    double approach = dx * nx + dy * ny;
+    if (approach < 0.0) {
+        double flatT = Utils::max(0.0, (distance - r2) / -approach);
+        if (flatT <= 1.0) {
+            double along = ((mx + dx * flatT) * ex + (my + dy * flatT) * ey) / (length * length);
+            if (along >= 0.0 && along <= 1.0) {
+                t = flatT;
+                out_nx = nx;
+                out_ny = ny;
+                return true;
+            }
+        }
+    }
+
+    // otherwise the ends
+    double endT, endNx, endNy;
+    bool hit = false;
+    if (sweepPointAndCircle(ax1, ay1, cx2, cy2, r2, dx, dy, endT, endNx, endNy)) {
+        hit = true;
+        t = endT;
+        out_nx = endNx;
+        out_ny = endNy;
+    }
+    if (sweepPointAndCircle(bx1, by1, cx2, cy2, r2, dx, dy, endT, endNx, endNy) && (! hit || endT < t)) {
+        hit = true;
+        t = endT;
+        out_nx = endNx;
+        out_ny = endNy;
+    }
+    return hit;
+}
+
+void Physics::circleAndCircle(const double * cx1, const double * cy1, const double * r1,
+                              const double * cx2, const double * cy2, const double * r2,
+                              double * out_dx, double * out_dy, int count)
+{
+    int i = 0;
+#if defined(__AVX__) || defined(__SSE2__)
+    // circles push each other around like a point pushes a circle whose
+    // radius is the sum of both
+    for (; i + c_laneCount <= count; i += c_laneCount) {
+        Lanes dx, dy;
+        lanesPointAndCircle(lanesLoad(cx1 + i), lanesLoad(cy1 + i), lanesLoad(cx2 + i), lanesLoad(cy2 + i),
+                            lanesAdd(lanesLoad(r1 + i), lanesLoad(r2 + i)), dx, dy);
+        lanesStore(out_dx + i, dx);
+        lanesStore(out_dy + i, dy);
+    }
+#endif
+    for (; i < count; i++)
+        circleAndCircle(cx1[i], cy1[i], r1[i], cx2[i], cy2[i], r2[i], out_dx[i], out_dy[i]);
+}
+
+void Physics::squareAndCircle(const double * cx1, const double * cy1, const double * a1,
+                              const double * cx2, const double * cy2, const double * r2,
+                              double * out_dx, double * out_dy, int count)
+{
+    int i = 0;
+#if defined(__AVX__) || defined(__SSE2__)
+    // instead of switching on the zone, every lane does both the point case
+    // and the edge case, and masks pick the right answer.
+    for (; i + c_laneCount <= count; i += c_laneCount) {
+        Lanes squareX = lanesLoad(cx1 + i), squareY = lanesLoad(cy1 + i), apothem = lanesLoad(a1 + i);
+        Lanes circleX = lanesLoad(cx2 + i), circleY = lanesLoad(cy2 + i), radius = lanesLoad(r2 + i);
+        Lanes left = lanesSub(squareX, apothem), right = lanesAdd(squareX, apothem);
+        Lanes top = lanesSub(squareY, apothem), bottom = lanesAdd(squareY, apothem);
+
+        Lanes pastLeft = lanesLessThan(left, circleX), pastRight = lanesLessThan(right, circleX);
+        Lanes pastTop = lanesLessThan(top, circleY), pastBottom = lanesLessThan(bottom, circleY);
+        Lanes middleX = lanesAndNot(pastRight, pastLeft);
+        Lanes middleY = lanesAndNot(pastBottom, pastTop);
+        Lanes inside = lanesAnd(middleX, middleY);
+
+        // corners and inside
+        Lanes pointX = lanesSelect(pastRight, right, lanesSelect(pastLeft, squareX, left));
+        Lanes pointY = lanesSelect(pastBottom, bottom, lanesSelect(pastTop, squareY, top));
+        Lanes pointRadius = lanesSelect(inside, lanesAdd(radius, apothem), radius);
+        Lanes dx, dy;
+        lanesPointAndCircle(pointX, pointY, circleX, circleY, pointRadius, dx, dy);
+
+        // edges
+        Lanes zero = lanesZero();
+        Lanes westDx = lanesSub(left, lanesAdd(circleX, radius));
+        westDx = lanesSelect(lanesLessThan(westDx, zero), westDx, zero);
+        Lanes eastDx = lanesSub(right, lanesSub(circleX, radius));
+        eastDx = lanesSelect(lanesLessThan(eastDx, zero), zero, eastDx);
+        Lanes northDy = lanesSub(top, lanesAdd(circleY, radius));
+        northDy = lanesSelect(lanesLessThan(northDy, zero), northDy, zero);
+        Lanes southDy = lanesSub(bottom, lanesSub(circleY, radius));
+        southDy = lanesSelect(lanesLessThan(southDy, zero), zero, southDy);
+
+        Lanes horizontalEdge = lanesAndNot(inside, middleY);
+        Lanes verticalEdge = lanesAndNot(inside, middleX);
+        dx = lanesSelect(horizontalEdge, lanesSelect(pastLeft, eastDx, westDx), dx);
+        dy = lanesSelect(horizontalEdge, zero, dy);
+        dx = lanesSelect(verticalEdge, zero, dx);
+        dy = lanesSelect(verticalEdge, lanesSelect(pastTop, southDy, northDy), dy);
+
+        lanesStore(out_dx + i, dx);
+        lanesStore(out_dy + i, dy);
+    }
+#endif
+    for (; i < count; i++)
+        squareAndCircle(cx1[i], cy1[i], a1[i], cx2[i], cy2[i], r2[i], out_dx[i], out_dy[i]);
+}
+
+void Physics::pointAndCircle(const double * px1, const double * py1,
+                             const double * cx2, const double * cy2, const double * r2,
+                             double * out_dx, double * out_dy, int count)
+{
+    int i = 0;
+#if defined(__AVX__) || defined(__SSE2__)
+    for (; i + c_laneCount <= count; i += c_laneCount) {
+        Lanes dx, dy;
+        lanesPointAndCircle(lanesLoad(px1 + i), lanesLoad(py1 + i), lanesLoad(cx2 + i), lanesLoad(cy2 + i),
+                            lanesLoad(r2 + i), dx, dy);
+        lanesStore(out_dx + i, dx);
+        lanesStore(out_dy + i, dy);
+    }
+#endif
+    for (; i < count; i++)
+        pointAndCircle(px1[i], py1[i], cx2[i], cy2[i], r2[i], out_dx[i], out_dy[i]);
+}
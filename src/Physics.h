@@ -3,6 +3,11 @@
 
 class Physics {
 public:
+    // things that move further than this in a frame can skip over a thin
+    // wall between where they start and where they end up, so they get
+    // swept with the functions below instead of only checked at the end
+    static const double sweepDistance;
+
     // out_dx and out_dy get written to with the vector object 2 would have to move to resolve the collision
     static void circleAndCircle(double cx1, double cy1, double r1, double cx2, double cy2, double r2, double & out_dx, double & out_dy);
     static void squareAndCircle(double cx1, double cy1, double a1, double cx2, double cy2, double r2, double & out_dx, double & out_dy);
@@ -10,6 +15,33 @@ public:
     static void pointAndCircle(double px1, double py1, double cx2, double cy2, double r2, double & out_dx, double & out_dy);
 
     static void triangleNWAndCircle(double cx1, double cy1, double a1, double cx2, double cy2, double r2, double & out_dx, double & out_dy);
+
+    // time of impact. circle 2 moves by dx, dy while object 1 holds still.
+    // t gets how far along the move they first touch, from 0 to 1, and
+    // out_nx, out_ny the unit normal from object 1 toward circle 2 when they
+    // do. false if they don't touch, or if circle 2 is moving away from it
+    static bool sweepCircleAndCircle(double cx1, double cy1, double r1, double cx2, double cy2, double r2,
+                                     double dx, double dy, double & t, double & out_nx, double & out_ny);
+    static bool sweepSquareAndCircle(double cx1, double cy1, double a1, double cx2, double cy2, double r2,
+                                     double dx, double dy, double & t, double & out_nx, double & out_ny);
+    static bool sweepPointAndCircle(double px1, double py1, double cx2, double cy2, double r2,
+                                    double dx, double dy, double & t, double & out_nx, double & out_ny);
+    static bool sweepSegmentAndCircle(double ax1, double ay1, double bx1, double by1, double cx2, double cy2, double r2,
+                                      double dx, double dy, double & t, double & out_nx, double & out_ny);
+
+    // batched versions of the above. each argument is an array of count
+    // values, and element i of the outputs gets the same result as calling
+    // the single version on element i of the inputs. uses SSE2 or AVX when
+    // the compiler has them turned on.
+    static void circleAndCircle(const double * cx1, const double * cy1, const double * r1,
+                                const double * cx2, const double * cy2, const double * r2,
+                                double * out_dx, double * out_dy, int count);
+    static void squareAndCircle(const double * cx1, const double * cy1, const double * a1,
+                                const double * cx2, const double * cy2, const double * r2,
+                                double * out_dx, double * out_dy, int count);
+    static void pointAndCircle(const double * px1, const double * py1,
+                               const double * cx2, const double * cy2, const double * r2,
+                               double * out_dx, double * out_dy, int count);
 };
 
 #endif
@@ -0,0 +1,341 @@
+#include "Profiler.h"
+
+#include "Utils.h"
+
+#include <SFML/System.hpp>
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/time.h>
+#endif
+
+#ifndef RELEASE
+
+// events each thread keeps. older ones get written over
+static const unsigned int c_eventCount = 1 << 16;
+// frame times in the graph
+static const int c_frameHistory = 128;
+// zones in the list
+static const int c_topZoneCount = 8;
+// distinct zones counted in one frame
+static const int c_maxZoneTotals = 64;
+// the graph's scale, and where it draws a line for a 60 fps frame
+static const float c_graphPixelsPerMs = 3.0f;
+static const float c_frameBudgetMs = 1000.0f / 60.0f;
+
+typedef struct {
+    const char * name;
+    long long start, end;
+    int depth;
+} Event;
+
+typedef struct {
+    const char * name;
+    long long time;
+    int count;
+} ZoneTotal;
+
+class ThreadLog {
+public:
+    int id;
+    const char * name;
+    std::vector<Event> events;
+    // events ever recorded. the newest is at (next - 1) % c_eventCount
+    unsigned long long next;
+    int depth;
+    // what endFrame has already counted
+    unsigned long long frameFirst;
+    long long frameStart;
+};
+
+// what the overlay shows. written by endFrame and read by drawOverlay
+typedef struct {
+    float frameTimes[c_frameHistory];
+    int newestFrame;
+    ZoneTotal topZones[c_topZoneCount];
+    int topZoneCount;
+} Stats;
+
+static __thread ThreadLog * s_threadLog = NULL;
+static std::vector<ThreadLog *> s_threadLogs;
+static sf::Mutex s_threadLogsMutex;
+
+static Stats s_stats;
+static sf::Mutex s_statsMutex;
+static volatile int s_overlayVisible = 0;
+
+static long long systemTime();
+static ThreadLog * threadLog();
+static void writeJsonString(std::ostream & out, const char * text);
+
+static long long s_startTime = systemTime();
+
+Profiler::Zone::Zone(const char * name) :
+    m_name(name),
+    m_start(now())
+{
+    threadLog()->depth++;
+}
+
+Profiler::Zone::~Zone()
+{
+    ThreadLog * log = threadLog();
+    log->depth--;
+    Event & event = log->events[log->next % c_eventCount];
+    event.name = m_name;
+    event.start = m_start;
+    event.end = now();
+    event.depth = log->depth;
+    log->next++;
+}
+
+long long Profiler::now()
+{
+    return systemTime() - s_startTime;
+}
+
+void Profiler::nameThread(const char * name)
+{
+    ThreadLog * log = threadLog();
+    // writeTrace reads it
+    sf::Lock lock(s_threadLogsMutex);
+    log->name = name;
+}
+
+void Profiler::endFrame()
+{
+    ThreadLog * log = threadLog();
+    long long frameEnd = now();
+    float frameTime = (frameEnd - log->frameStart) / 1000.0f;
+
+    // add up the zones since the last frame. a zone's time includes the
+    // zones inside it
+    ZoneTotal totals[c_maxZoneTotals];
+    int totalCount = 0;
+    unsigned long long first = log->frameFirst;
+    if (log->next - first > c_eventCount)
+        first = log->next - c_eventCount;
+    for (unsigned long long i = first; i < log->next; i++) {
+        Event & event = log->events[i % c_eventCount];
+        int total = 0;
+        while (total < totalCount && strcmp(totals[total].name, event.name) != 0)
+            total++;
+        if (total == totalCount) {
+            if (totalCount == c_maxZoneTotals)
+                continue;
+            totals[total].name = event.name;
+            totals[total].time = 0;
+            totals[total].count = 0;
+            totalCount++;
+        }
+        totals[total].time += event.end - event.start;
+        totals[total].count++;
+    }
+    log->frameFirst = log->next;
+    log->frameStart = frameEnd;
+
+    // keep the top ones, most expensive first
+    sf::Lock lock(s_statsMutex);
+    s_stats.newestFrame = (s_stats.newestFrame + 1) % c_frameHistory;
+    s_stats.frameTimes[s_stats.newestFrame] = frameTime;
+    s_stats.topZoneCount = 0;
+    for (int i = 0; i < totalCount; i++) {
+        int place = s_stats.topZoneCount;
+        while (place > 0 && s_stats.topZones[place - 1].time < totals[i].time) {
+            if (place < c_topZoneCount)
+                s_stats.topZones[place] = s_stats.topZones[place - 1];
+            place--;
+        }
+        if (place < c_topZoneCount)
+            s_stats.topZones[place] = totals[i];
+        if (s_stats.topZoneCount < c_topZoneCount)
+            s_stats.topZoneCount++;
+    }
+}
+
+void Profiler::setOverlayVisible(bool visible)
+{
+    __sync_lock_test_and_set(&s_overlayVisible, visible ? 1 : 0);
+}
+
+bool Profiler::overlayVisible()
+{
+    return __sync_fetch_and_add(&s_overlayVisible, 0) != 0;
+}
+
+void Profiler::drawOverlay(sf::RenderWindow * window)
+{
+    if (! overlayVisible())
+        return;
+
+    Stats stats;
+    {
+        sf::Lock lock(s_statsMutex);
+        stats = s_stats;
+    }
+
+    // frame times, oldest on the left
+    float graphHeight = c_frameBudgetMs * 2.0f * c_graphPixelsPerMs;
+    window->Draw(sf::Shape::Rectangle(0, 0, c_frameHistory * 2, graphHeight, sf::Color(0, 0, 0, 160)));
+    for (int i = 0; i < c_frameHistory; i++) {
+        float frameTime = stats.frameTimes[(stats.newestFrame + 1 + i) % c_frameHistory];
+        float height = Utils::min(frameTime * c_graphPixelsPerMs, graphHeight);
+        sf::Color color = frameTime > c_frameBudgetMs ? sf::Color(255, 64, 64) : sf::Color(64, 255, 64);
+        window->Draw(sf::Shape::Rectangle(i * 2, graphHeight - height, i * 2 + 2, graphHeight, color));
+    }
+    float budgetY = graphHeight - c_frameBudgetMs * c_graphPixelsPerMs;
+    window->Draw(sf::Shape::Line(0, budgetY, c_frameHistory * 2, budgetY, 1, sf::Color(255, 255, 255, 128)));
+
+    // top zones underneath
+    std::ostringstream text;
+    text.precision(2);
+    text << std::fixed << stats.frameTimes[stats.newestFrame] << " ms\n";
+    for (int i = 0; i < stats.topZoneCount; i++) {
+        text << stats.topZones[i].time / 1000.0 << " ms  " << stats.topZones[i].name;
+        if (stats.topZones[i].count > 1)
+            text << " x" << stats.topZones[i].count;
+        text << "\n";
+    }
+    sf::String string(text.str());
+    string.SetSize(12.0f);
+    string.SetPosition(2.0f, graphHeight + 2.0f);
+    window->Draw(string);
+}
+
+bool Profiler::writeTrace(std::string filename)
+{
+    std::ofstream out(filename.c_str());
+    if (! out.good()) {
+        std::cerr << "Unable to write profile " << filename << std::endl;
+        return false;
+    }
+
+    sf::Lock lock(s_threadLogsMutex);
+    out << "{\"traceEvents\":[\n";
+    bool first = true;
+    for (unsigned int i = 0; i < s_threadLogs.size(); i++) {
+        ThreadLog * log = s_threadLogs[i];
+        if (log->name != NULL) {
+            out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+                << log->id << ",\"args\":{\"name\":";
+            writeJsonString(out, log->name);
+            out << "}}";
+            first = false;
+        }
+        unsigned long long begin = log->next > c_eventCount ? log->next - c_eventCount : 0;
+        for (unsigned long long j = begin; j < log->next; j++) {
+            Event & event = log->events[j % c_eventCount];
+            out << (first ? "" : ",\n") << "{\"name\":";
+            writeJsonString(out, event.name);
+            out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << log->id
+                << ",\"ts\":" << event.start << ",\"dur\":" << event.end - event.start << "}";
+            first = false;
+        }
+    }
+    out << "\n]}\n";
+    return out.good();
+}
+
+long long systemTime()
+{
+#ifdef _WIN32
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    // in two steps so it doesn't overflow
+    return counter.QuadPart / frequency.QuadPart * 1000000 +
+           counter.QuadPart % frequency.QuadPart * 1000000 / frequency.QuadPart;
+#else
+    timeval time;
+    gettimeofday(&time, NULL);
+    return (long long)time.tv_sec * 1000000 + time.tv_usec;
+#endif
+}
+
+ThreadLog * threadLog()
+{
+    if (s_threadLog != NULL)
+        return s_threadLog;
+
+    // first zone on this thread. logs live until the program ends so that
+    // the trace has threads that already finished
+    ThreadLog * log = new ThreadLog();
+    log->name = NULL;
+    log->events.resize(c_eventCount);
+    log->next = 0;
+    log->depth = 0;
+    log->frameFirst = 0;
+    log->frameStart = Profiler::now();
+    {
+        sf::Lock lock(s_threadLogsMutex);
+        log->id = s_threadLogs.size();
+        s_threadLogs.push_back(log);
+    }
+    s_threadLog = log;
+    return log;
+}
+
+void writeJsonString(std::ostream & out, const char * text)
+{
+    out << '"';
+    for (const char * c = text; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\')
+            out << '\\';
+        out << *c;
+    }
+    out << '"';
+}
+
+#else
+
+Profiler::Zone::Zone(const char * name) :
+    m_name(name),
+    m_start(0)
+{
+}
+
+Profiler::Zone::~Zone()
+{
+}
+
+long long Profiler::now()
+{
+    return 0;
+}
+
+void Profiler::nameThread(const char *)
+{
+}
+
+void Profiler::endFrame()
+{
+}
+
+void Profiler::setOverlayVisible(bool)
+{
+}
+
+bool Profiler::overlayVisible()
+{
+    return false;
+}
+
+void Profiler::drawOverlay(sf::RenderWindow *)
+{
+}
+
+bool Profiler::writeTrace(std::string filename)
+{
+    std::cerr << "Unable to write profile " << filename << ": profiling is compiled out of RELEASE builds" << std::endl;
+    return false;
+}
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef _PROFILER_H_
+#define _PROFILER_H_
+
+#include "version.h"
+
+#include <SFML/Graphics.hpp>
+
+#include <string>
+
+// Profiler times named zones of code. put PROFILE_ZONE("name") at the top of
+// a block and the time until the end of the block is recorded, along with
+// how deep it is inside other zones. every thread records into a ring buffer
+// of its own, so recording never waits on a lock.
+// the thread that calls endFrame gets a graph of frame times and a list of
+// its most expensive zones, which drawOverlay shows on the screen. writeTrace
+// dumps every thread's zones in Chrome's trace format (chrome://tracing).
+// all of it is compiled out in RELEASE builds.
+#ifndef RELEASE
+#define PROFILE_CONCAT_INNER(a, b) a ## b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_ZONE(name) Profiler::Zone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#else
+#define PROFILE_ZONE(name)
+#endif
+
+namespace Profiler
+{
+    // records the time from construction to destruction. name has to be a
+    // string literal, or at least last as long as the program
+    class Zone
+    {
+    public:
+        Zone(const char * name);
+        ~Zone();
+    private:
+        const char * m_name;
+        long long m_start;
+    };
+
+    // microseconds since the profiler started
+    long long now();
+
+    // what the calling thread is called in the trace
+    void nameThread(const char * name);
+
+    // call once per frame from the main loop. works out how long the frame
+    // took and which zones on this thread took the most of it
+    void endFrame();
+
+    void setOverlayVisible(bool visible);
+    bool overlayVisible();
+    // draw the frame time graph and the top zones in the corner. can be
+    // called from any thread
+    void drawOverlay(sf::RenderWindow * window);
+
+    // write all recorded zones to filename as a Chrome trace. returns false
+    // if it couldn't
+    bool writeTrace(std::string filename);
+}
+
+#endif
@@ -0,0 +1,60 @@
+#include "RenderBackend.h"
+
+#include <algorithm>
+#include <cmath>
+
+RenderBackend::RenderBackend() :
+    m_order(),
+    m_quadCount(0),
+    m_batchCount(0)
+{
+}
+
+RenderBackend::~RenderBackend()
+{
+}
+
+void RenderBackend::sortQuads(RenderCommandBuffer * buffer)
+{
+    m_order.resize(buffer->quadCount());
+    for (unsigned int i = 0; i < m_order.size(); i++)
+        m_order[i] = i;
+    // quads come in by sort key already, so this is mostly grouping the
+    // textures within the unsorted parts of each layer
+    std::sort(m_order.begin(), m_order.end(), QuadLessThan(buffer));
+
+    m_quadCount = m_order.size();
+    m_batchCount = 0;
+    int texture = -1;
+    for (unsigned int i = 0; i < m_order.size(); i++) {
+        RenderCommandBuffer::Quad * quad = buffer->quad(m_order[i]);
+        if (i == 0 || quad->texture != texture) {
+            texture = quad->texture;
+            m_batchCount++;
+        }
+    }
+}
+
+bool RenderBackend::QuadLessThan::operator()(int index1, int index2)
+{
+    RenderCommandBuffer::Quad * quad1 = m_buffer->quad(index1);
+    RenderCommandBuffer::Quad * quad2 = m_buffer->quad(index2);
+    if (quad1->sortKey != quad2->sortKey)
+        return quad1->sortKey < quad2->sortKey;
+    if (quad1->texture != quad2->texture)
+        return quad1->texture < quad2->texture;
+    // keep the order they came in, so it's the same every time
+    return index1 < index2;
+}
+
+int RenderBackend::screenX(RenderCommandBuffer::Quad * quad, double cameraX, double interpolation)
+{
+    // floor, so that tiles next to each other stay next to each other when
+    // they're partly off the screen
+    return (int)std::floor(quad->previousX + (quad->x - quad->previousX) * interpolation - cameraX);
+}
+
+int RenderBackend::screenY(RenderCommandBuffer::Quad * quad, double cameraY, double interpolation)
+{
+    return (int)std::floor(quad->previousY + (quad->y - quad->previousY) * interpolation - cameraY);
+}
@@ -0,0 +1,49 @@
+#ifndef _RENDER_BACKEND_H_
+#define _RENDER_BACKEND_H_
+
+#include "RenderCommandBuffer.h"
+
+#include <vector>
+
+// A RenderBackend plays back a RenderCommandBuffer. The base class works out
+// the order: by sort key, and within a key by texture, so that quads from the
+// same image end up next to each other. Each run of quads from one image is
+// a batch.
+class RenderBackend
+{
+public:
+    RenderBackend();
+    virtual ~RenderBackend();
+
+    // draw the buffer, interpolation of the way from its last logic frame
+    // to this one
+    virtual void render(RenderCommandBuffer * buffer, double interpolation) = 0;
+
+    // what the last render did
+    int quadCount() { return m_quadCount; }
+    int batchCount() { return m_batchCount; }
+
+protected:
+    // put the quads in drawing order. fills order() and counts the batches
+    void sortQuads(RenderCommandBuffer * buffer);
+    // quad indexes in drawing order
+    std::vector<int> * order() { return &m_order; }
+    // where a quad's top left goes on the screen
+    static int screenX(RenderCommandBuffer::Quad * quad, double cameraX, double interpolation);
+    static int screenY(RenderCommandBuffer::Quad * quad, double cameraY, double interpolation);
+
+private:
+    class QuadLessThan {
+    public:
+        QuadLessThan(RenderCommandBuffer * buffer) : m_buffer(buffer) {}
+        bool operator()(int index1, int index2);
+    private:
+        RenderCommandBuffer * m_buffer;
+    };
+
+    std::vector<int> m_order;
+    int m_quadCount;
+    int m_batchCount;
+};
+
+#endif
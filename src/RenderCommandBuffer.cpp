@@ -0,0 +1,88 @@
+#include "RenderCommandBuffer.h"
+
+#include "Graphic.h"
+
+RenderCommandBuffer::RenderCommandBuffer() :
+    m_quads(),
+    m_previousCameraX(0.0), m_previousCameraY(0.0),
+    m_cameraX(0.0), m_cameraY(0.0),
+    m_frameCount(0),
+    m_fps(1),
+    m_layer(0),
+    m_sortKey(0),
+    m_sorted(false),
+    m_serial(0)
+{
+}
+
+void RenderCommandBuffer::clear()
+{
+    m_quads.clear();
+    m_layer = 0;
+    m_sortKey = 0;
+    m_sorted = false;
+}
+
+void RenderCommandBuffer::setCamera(double previousX, double previousY, double x, double y)
+{
+    m_previousCameraX = previousX;
+    m_previousCameraY = previousY;
+    m_cameraX = x;
+    m_cameraY = y;
+}
+
+double RenderCommandBuffer::cameraX(double interpolation)
+{
+    return m_previousCameraX + (m_cameraX - m_previousCameraX) * interpolation;
+}
+
+double RenderCommandBuffer::cameraY(double interpolation)
+{
+    return m_previousCameraY + (m_cameraY - m_previousCameraY) * interpolation;
+}
+
+void RenderCommandBuffer::setTime(long long int frameCount, int fps)
+{
+    m_frameCount = frameCount;
+    m_fps = fps;
+}
+
+void RenderCommandBuffer::beginLayer(int layer)
+{
+    m_layer = layer;
+    m_sortKey++;
+    m_sorted = false;
+}
+
+void RenderCommandBuffer::beginSorted()
+{
+    m_sorted = true;
+}
+
+void RenderCommandBuffer::add(Graphic * graphic, double x, double y)
+{
+    add(graphic, x, y, x, y);
+}
+
+void RenderCommandBuffer::add(Graphic * graphic, double previousX, double previousY, double x, double y)
+{
+    // sorted quads each get a key of their own, after everything so far
+    if (m_sorted)
+        m_sortKey++;
+
+    const sf::IntRect & bounds = graphic->frameBounds(graphic->frameAt(m_frameCount, m_fps));
+    Quad quad;
+    quad.texture = graphic->texture();
+    quad.image = graphic->image();
+    quad.sourceLeft = bounds.Left;
+    quad.sourceTop = bounds.Top;
+    quad.width = bounds.GetWidth();
+    quad.height = bounds.GetHeight();
+    quad.previousX = previousX;
+    quad.previousY = previousY;
+    quad.x = x;
+    quad.y = y;
+    quad.layer = m_layer;
+    quad.sortKey = m_sortKey;
+    m_quads.push_back(quad);
+}
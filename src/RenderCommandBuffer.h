@@ -0,0 +1,81 @@
+#ifndef _RENDER_COMMAND_BUFFER_H_
+#define _RENDER_COMMAND_BUFFER_H_
+
+#include <SFML/Graphics.hpp>
+
+#include <vector>
+
+class Graphic;
+
+// RenderCommandBuffer is a recording of everything to draw for one logic
+// frame: where the screen is, and a list of sprite quads. The game records
+// into it without touching the display, and a RenderBackend plays it back.
+// Since it's just data, it can be drawn on another thread (see RenderThread)
+// or counted instead of drawn.
+// Positions are in world coordinates. Things that move also have where they
+// were the logic frame before, and drawing goes somewhere in between.
+class RenderCommandBuffer
+{
+public:
+    typedef struct {
+        // which image the quad comes from. backends batch by this
+        int texture;
+        // NULL when images aren't decoded. see Graphic::setDecodeImages
+        sf::Image * image;
+        // the part of the image to draw
+        int sourceLeft, sourceTop;
+        int width, height;
+        // top left, last logic frame and this one
+        double previousX, previousY;
+        double x, y;
+        int layer;
+        // quads are drawn in order of sortKey. quads with the same key don't
+        // overlap, so they can go in any order
+        unsigned int sortKey;
+    } Quad;
+
+    RenderCommandBuffer();
+
+    // forget the quads, keeping the memory
+    void clear();
+
+    // the top left of the screen, last logic frame and this one
+    void setCamera(double previousX, double previousY, double x, double y);
+    // where the screen is, interpolation of the way from last logic frame
+    // to this one
+    double cameraX(double interpolation);
+    double cameraY(double interpolation);
+    // the logic frame count and rate, for picking animation frames
+    void setTime(long long int frameCount, int fps);
+    long long int frameCount() { return m_frameCount; }
+    int fps() { return m_fps; }
+
+    // start a layer. everything added after this is on top of what's
+    // already there, and in no particular order, until beginSorted
+    void beginLayer(int layer);
+    // everything added to this layer from now on is drawn in the order
+    // it's added
+    void beginSorted();
+    void add(Graphic * graphic, double x, double y);
+    void add(Graphic * graphic, double previousX, double previousY, double x, double y);
+
+    int quadCount() { return m_quads.size(); }
+    Quad * quad(int index) { return &m_quads[index]; }
+
+    // numbered by whoever hands out buffers. see RenderThread
+    unsigned int serial() { return m_serial; }
+    void setSerial(unsigned int value) { m_serial = value; }
+
+private:
+    std::vector<Quad> m_quads;
+    double m_previousCameraX, m_previousCameraY;
+    double m_cameraX, m_cameraY;
+    long long int m_frameCount;
+    int m_fps;
+    int m_layer;
+    unsigned int m_sortKey;
+    bool m_sorted;
+    unsigned int m_serial;
+};
+
+#endif
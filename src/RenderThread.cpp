@@ -0,0 +1,109 @@
+#include "RenderThread.h"
+
+#include "MainWindow.h"
+#include "Profiler.h"
+
+const int RenderThread::c_fresh = 0x4;
+
+// atomically swap in value, returning the old one. a full barrier, so
+// everything written before it is seen by whoever gets value
+template <class T>
+static T exchange(volatile T * target, T value)
+{
+    T old;
+    do {
+        old = __sync_fetch_and_add(target, 0);
+    } while (__sync_val_compare_and_swap(target, old, value) != old);
+    return old;
+}
+
+RenderThread::RenderThread(sf::RenderWindow * window, int fps, float displayInterval) :
+    m_window(window),
+    m_fps(fps),
+    m_displayInterval(displayInterval),
+    m_writing(0),
+    m_nextSerial(1),
+    m_middle(1),
+    m_reading(2),
+    m_drawingSerial(0),
+    m_backend(window),
+    m_quit(0),
+    m_thread(NULL)
+{
+    // a window can only be active on one thread at a time
+    m_window->SetActive(false);
+    m_thread = new sf::Thread(&RenderThread::run, this);
+    m_thread->Launch();
+}
+
+RenderThread::~RenderThread()
+{
+    __sync_lock_test_and_set(&m_quit, 1);
+    m_thread->Wait();
+    delete m_thread;
+    m_window->SetActive(true);
+}
+
+unsigned int RenderThread::publish()
+{
+    unsigned int serial = m_nextSerial++;
+    m_buffers[m_writing].setSerial(serial);
+    m_writing = exchange(&m_middle, m_writing | c_fresh) & ~c_fresh;
+    return serial;
+}
+
+unsigned int RenderThread::oldestSerialInUse()
+{
+    // anything older than what's being drawn is never drawn again, since
+    // only newer buffers get published after it
+    return __sync_fetch_and_add(&m_drawingSerial, 0);
+}
+
+void RenderThread::run(void * renderThread)
+{
+    ((RenderThread *)renderThread)->loop();
+}
+
+void RenderThread::loop()
+{
+    m_window->SetActive(true);
+    Profiler::nameThread("render");
+
+    RenderCommandBuffer * buffer = NULL;
+    // time since the buffer came in, for interpolating
+    sf::Clock bufferClock;
+    sf::Clock displayClock;
+    while (__sync_fetch_and_add(&m_quit, 0) == 0) {
+        if (__sync_fetch_and_add(&m_middle, 0) & c_fresh) {
+            m_reading = exchange(&m_middle, m_reading) & ~c_fresh;
+            buffer = &m_buffers[m_reading];
+            // done with the old one
+            exchange(&m_drawingSerial, buffer->serial());
+            bufferClock.Reset();
+        }
+        if (buffer == NULL) {
+            // nothing to draw yet
+            sf::Sleep(0.001f);
+            continue;
+        }
+
+        // a buffer shows up every logic frame, so it takes one logic
+        // frame to get from the one before to this one
+        double interpolation = bufferClock.GetElapsedTime() * m_fps;
+        if (interpolation > 1.0)
+            interpolation = 1.0;
+
+        {
+            PROFILE_ZONE("RenderThread::render");
+            m_backend.render(buffer, interpolation);
+        }
+        Profiler::drawOverlay(m_window);
+        m_window->Display();
+
+        if (m_displayInterval > 0.0f)
+            MainWindow::waitUntil(displayClock, m_displayInterval);
+        displayClock.Reset();
+    }
+
+    m_window->SetActive(false);
+}
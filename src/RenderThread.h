@@ -0,0 +1,64 @@
+#ifndef _RENDER_THREAD_H_
+#define _RENDER_THREAD_H_
+
+#include "RenderCommandBuffer.h"
+#include "SfmlRenderBackend.h"
+
+#include <SFML/Graphics.hpp>
+#include <SFML/System.hpp>
+
+// RenderThread draws on a thread of its own, so that drawing one frame and
+// running the logic for the next one happen at the same time.
+// The logic records into a RenderCommandBuffer and publishes it. The render
+// thread keeps drawing the newest buffer it has, moving between its last two
+// logic frames as time goes by, until a newer one shows up.
+// Buffers are triple buffered: one is being filled, one is being drawn, and
+// the newest finished one waits in between. Handing one over is a single
+// atomic exchange, so neither side ever waits for the other.
+// The window belongs to the render thread while this exists.
+class RenderThread
+{
+public:
+    // fps is logic frames per second. displayInterval is the least time
+    // between drawn frames, or 0 for no limit
+    RenderThread(sf::RenderWindow * window, int fps, float displayInterval);
+    // waits for the frame being drawn to finish
+    ~RenderThread();
+
+    // the buffer to record into. only touch it from one thread
+    RenderCommandBuffer * backBuffer() { return &m_buffers[m_writing]; }
+    // hand the back buffer over to be drawn. returns its serial
+    unsigned int publish();
+
+    // the serial of the oldest buffer that might still be drawn. graphics
+    // that only older buffers point to can be deleted
+    unsigned int oldestSerialInUse();
+
+private: //variables
+    // set on the middle index when it holds a buffer that hasn't been drawn
+    static const int c_fresh;
+
+    sf::RenderWindow * m_window;
+    int m_fps;
+    float m_displayInterval;
+
+    RenderCommandBuffer m_buffers[3];
+    // owned by the logic thread
+    int m_writing;
+    unsigned int m_nextSerial;
+    // swapped atomically by both
+    volatile int m_middle;
+    // owned by the render thread
+    int m_reading;
+    volatile unsigned int m_drawingSerial;
+    SfmlRenderBackend m_backend;
+
+    volatile int m_quit;
+    sf::Thread * m_thread;
+
+private: //methods
+    static void run(void * renderThread);
+    void loop();
+};
+
+#endif
@@ -138,6 +138,21 @@ char * ResourceFile::getResource(std::string resourceName)
     return buffer;
 }
 
+int ResourceFile::getResourcePrefix(std::string resourceName, char * buffer,
+    int bufferSize)
+{
+    ResourceRecord * record = getResourceRecord(resourceName);
+
+    if( ! record )
+        return -1;
+
+    int size = (int) record->size < bufferSize ? (int) record->size : bufferSize;
+    m_file.seekg(record->offset, std::ios::beg);
+    m_file.read(buffer, size);
+
+    return size;
+}
+
 unsigned long int ResourceFile::recordLocation(unsigned long int resourceIndex)
 {
     return sizeof(ResourceHeader) + resourceIndex * sizeof(ResourceRecord);
@@ -189,7 +204,10 @@ void ResourceFile::addResource(std::string resourceName, const char * data,
     // add the new resource record
     m_file.seekp(0, std::ios::end);
 
+    // zero the unused end of the name, so the same resources always make
+    // the same file
     ResourceRecord record;
+    std::memset(&record, 0, sizeof(ResourceRecord));
     std::strcpy(record.name, resourceName.c_str());
     record.size = dataSize;
     record.dateModified = dateModified;
@@ -216,6 +234,17 @@ void ResourceFile::addResource(std::string resourceName, const char * data,
 
 }
 
+void ResourceFile::reserve(unsigned long int resourceCount)
+{
+    if( recordLocation(resourceCount) <= m_header.dataStart )
+        return;
+
+    std::vector<ResourceRecord> table;
+    loadRecordTable(table);
+    moveData(table, recordLocation(resourceCount) - m_header.dataStart);
+    saveRecordTable(table);
+}
+
 bool ResourceFile::deleteResource(std::string resourceName)
 {
     // load the string table into a vector
@@ -329,26 +358,7 @@ void ResourceFile::saveRecordTable(std::vector<ResourceRecord> & v)
     if( recordLocation(m_header.resourceCount) > m_header.dataStart ) {
         // pad for double the current size
         unsigned long int newMaxCount = m_header.resourceCount * 2;
-        unsigned long int offset = newMaxCount * sizeof(ResourceRecord);
-
-        // move all data down by offset
-        unsigned long int dataSize = fileSize()-m_header.dataStart;
-
-        char * data = new char[dataSize]; // ow, my memory!
-        m_file.seekg(m_header.dataStart, std::ios::beg);
-        m_file.read(data, dataSize);
-
-        // write the data to the new offset 
-        m_header.dataStart += offset;
-        m_file.seekp(m_header.dataStart, std::ios::beg);
-        m_file.write(data, dataSize);
-
-        delete[] data;
-
-        // adjust the offsets in the record table
-        for(unsigned int i = 0; i < v.size(); ++i) {
-            v[i].offset += offset;
-        }
+        moveData(v, newMaxCount * sizeof(ResourceRecord));
     }
 
     // write changes to the header
@@ -366,6 +376,37 @@ void ResourceFile::saveRecordTable(std::vector<ResourceRecord> & v)
     updateRecordCache();
 }
 
+void ResourceFile::moveData(std::vector<ResourceRecord> & v,
+    unsigned long int offset)
+{
+    // move all data down by offset
+    unsigned long int dataSize = fileSize()-m_header.dataStart;
+
+    char * data = new char[dataSize]; // ow, my memory!
+    m_file.seekg(m_header.dataStart, std::ios::beg);
+    m_file.read(data, dataSize);
+
+    // the old spot becomes room for records. clearing it also makes the
+    // file long enough when there's no data yet
+    char * padding = new char[offset];
+    std::memset(padding, 0, offset);
+    m_file.seekp(m_header.dataStart, std::ios::beg);
+    m_file.write(padding, offset);
+    delete[] padding;
+
+    // write the data to the new offset 
+    m_header.dataStart += offset;
+    m_file.seekp(m_header.dataStart, std::ios::beg);
+    m_file.write(data, dataSize);
+
+    delete[] data;
+
+    // adjust the offsets in the record table
+    for(unsigned int i = 0; i < v.size(); ++i) {
+        v[i].offset += offset;
+    }
+}
+
 void ResourceFile::updateRecordCache()
 {
     CacheEntry entry;
@@ -32,6 +32,12 @@ class ResourceFile
         // it's your job to deallocate the resource.
         char * getResource(std::string resourceName);
 
+        // copy at most bufferSize bytes from the start of a resource into
+        // buffer. returns how many bytes were copied, or -1 if the
+        // resource does not exist.
+        int getResourcePrefix(std::string resourceName, char * buffer,
+            int bufferSize);
+
         // size in bytes of a resource
         int resourceSize(std::string resourceName);
 
@@ -44,6 +50,11 @@ class ResourceFile
         void updateResource(std::string resourceName, const char * data,
             unsigned long dataSize, time_t dateModified = -1);
 
+        // make room in the record table for resourceCount resources.
+        // growing the table moves all the data in the file, so call this
+        // before adding lots of resources
+        void reserve(unsigned long int resourceCount);
+
         // delete a resource from a file
         bool deleteResource(std::string resourceName);
 
@@ -99,6 +110,8 @@ class ResourceFile
         void loadRecordTable(std::vector<ResourceRecord> & v);
         void saveRecordTable(std::vector<ResourceRecord> & v);
         unsigned long int fileSize();
+        void moveData(std::vector<ResourceRecord> & v,
+            unsigned long int offset);
         static bool recordSortPredicate(const ResourceRecord &r1,
             const ResourceRecord &r2);
         ResourceRecord * getResourceRecord(std::string & resourceName);
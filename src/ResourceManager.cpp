@@ -2,50 +2,84 @@
 
 #include "Universe.h"
 #include "Entity.h"
+#include "Graphic.h"
 
+#include "Utils.h"
 #include "Debug.h"
 
 ResourceFile * ResourceManager::resourceFile = NULL;
+sf::Mutex ResourceManager::s_mutex;
 
 std::map<std::string, const char *> ResourceManager::s_worlds;
-std::map<std::string, const char *> ResourceManager::s_maps;
 std::map<std::string, const char *> ResourceManager::s_entities;
+std::map<std::string, const char *> ResourceManager::s_prefetched;
 
 std::map<std::string, Graphic*> ResourceManager::s_graphics;
+std::map<Graphic*, ResourceManager::GraphicRecord> ResourceManager::s_graphicRecords;
+
+bool ResourceManager::s_deferGraphicDeletes = false;
+unsigned int ResourceManager::s_graphicGeneration = 0;
+std::vector<ResourceManager::ReleasedGraphic> ResourceManager::s_releasedGraphics;
 
 Universe * ResourceManager::loadUniverse(std::string resourceFilePath, std::string id) {
     resourceFile = new ResourceFile(resourceFilePath);
-    const char * buffer = resourceFile->getResource(id);
-    if (buffer == NULL) {
-        std::cerr << "Unable to find Universe: " << id << std::endl;
+    if (! resourceFile->isOpen()) {
+        std::cerr << "Unable to open resource file: " << resourceFilePath << std::endl;
         delete resourceFile;
+        resourceFile = NULL;
         return NULL;
     }
-    char actualTypeCode = *buffer;
-    if (actualTypeCode != 'U') {
-        std::cerr << "Wrong type code in resource " << id << ". " <<
-                "Should be 'U' but it's '" << actualTypeCode << "'." << std::endl;
-        delete resourceFile;
-        delete buffer;
+    char * buffer = readResource("Universe", 'U', id);
+    if (buffer == NULL) {
+        close();
         return NULL;
     }
     Universe * universe = Universe::load(buffer + sizeof(char));
-    delete resourceFile;
-    resourceFile = NULL;
+    delete[] buffer;
     if (universe == NULL) {
         std::cerr << "Unable to return universe - it did not load correctly." << std::endl;
+        close();
         return NULL;
     }
-    // TODO: clean caches of buffers
+    // the resource file stays open so that maps can be loaded on demand
     return universe;
 }
 
+void ResourceManager::close()
+{
+    sf::Lock lock(s_mutex);
+
+    delete resourceFile;
+    resourceFile = NULL;
+
+    std::map<std::string, const char *> * buffers[] = { &s_worlds, &s_entities, &s_prefetched };
+    for (int i = 0; i < 3; i++) {
+        for (std::map<std::string, const char *>::iterator it = buffers[i]->begin(); it != buffers[i]->end(); it++)
+            delete[] it->second;
+        buffers[i]->clear();
+    }
+
+    // anything still referenced at this point is leaked by its owner
+    for (std::map<std::string, Graphic*>::iterator it = s_graphics.begin(); it != s_graphics.end(); it++)
+        delete it->second;
+    s_graphics.clear();
+    s_graphicRecords.clear();
+    for (unsigned int i = 0; i < s_releasedGraphics.size(); i++)
+        delete s_releasedGraphics[i].graphic;
+    s_releasedGraphics.clear();
+}
+
 World * ResourceManager::getWorld(std::string id) {
     return loadFromCachedBuffer<World>("World", s_worlds, 'W', id);
 }
 
 Map * ResourceManager::getMap(std::string id) {
-    return loadFromCachedBuffer<Map>("Map", s_maps, 'M', id);
+    char * buffer = readMapBuffer(id);
+    if (buffer == NULL)
+        return NULL;
+    Map * map = loadMap(buffer);
+    delete[] buffer;
+    return map;
 }
 
 Entity * ResourceManager::getEntity(std::string id) {
@@ -53,6 +87,180 @@ Entity * ResourceManager::getEntity(std::string id) {
 }
 
 Graphic * ResourceManager::getGraphic(std::string id) {
-    return loadCachedResource<Graphic>("Graphic", s_graphics, 'G', id);
+    assert(resourceFile != NULL);
+    Graphic * graphic = NULL;
+    {
+        sf::Lock lock(s_mutex);
+        graphic = find(s_graphics, id);
+        if (graphic != NULL) {
+            s_graphicRecords[graphic].references++;
+            // nobody needs a prefetched copy of something that's loaded
+            std::map<std::string, const char *>::iterator it = s_prefetched.find(id);
+            if (it != s_prefetched.end()) {
+                delete[] it->second;
+                s_prefetched.erase(it);
+            }
+            return graphic;
+        }
+    }
+
+    // decode outside of the lock so the loader thread isn't held up
+    char * buffer = readResource("Graphic", 'G', id);
+    if (buffer == NULL)
+        return NULL;
+    graphic = Graphic::load(buffer + sizeof(char));
+    delete[] buffer;
+    if (graphic == NULL)
+        return NULL;
+
+    sf::Lock lock(s_mutex);
+    s_graphics[id] = graphic;
+    GraphicRecord record;
+    record.id = id;
+    record.references = 1;
+    s_graphicRecords[graphic] = record;
+    return graphic;
+}
+
+void ResourceManager::retainGraphic(Graphic * graphic)
+{
+    sf::Lock lock(s_mutex);
+    std::map<Graphic*, GraphicRecord>::iterator it = s_graphicRecords.find(graphic);
+    assert(it != s_graphicRecords.end());
+    it->second.references++;
+}
+
+void ResourceManager::releaseGraphic(Graphic * graphic)
+{
+    sf::Lock lock(s_mutex);
+    std::map<Graphic*, GraphicRecord>::iterator it = s_graphicRecords.find(graphic);
+    assert(it != s_graphicRecords.end());
+    if (it == s_graphicRecords.end())
+        return;
+    it->second.references--;
+    if (it->second.references > 0)
+        return;
+
+    s_graphics.erase(it->second.id);
+    s_graphicRecords.erase(it);
+    if (s_deferGraphicDeletes) {
+        ReleasedGraphic released;
+        released.graphic = graphic;
+        released.generation = s_graphicGeneration;
+        s_releasedGraphics.push_back(released);
+    } else {
+        delete graphic;
+    }
+}
+
+void ResourceManager::setDeferGraphicDeletes(bool value)
+{
+    {
+        sf::Lock lock(s_mutex);
+        s_deferGraphicDeletes = value;
+        if (value)
+            s_graphicGeneration = 0;
+    }
+    if (! value)
+        deleteReleasedGraphics(s_graphicGeneration + 1);
+}
+
+void ResourceManager::setGraphicGeneration(unsigned int generation)
+{
+    sf::Lock lock(s_mutex);
+    s_graphicGeneration = generation;
 }
 
+void ResourceManager::deleteReleasedGraphics(unsigned int oldestGenerationInUse)
+{
+    sf::Lock lock(s_mutex);
+    unsigned int kept = 0;
+    for (unsigned int i = 0; i < s_releasedGraphics.size(); i++) {
+        if (s_releasedGraphics[i].generation < oldestGenerationInUse)
+            delete s_releasedGraphics[i].graphic;
+        else
+            s_releasedGraphics[kept++] = s_releasedGraphics[i];
+    }
+    s_releasedGraphics.resize(kept);
+}
+
+int ResourceManager::graphicCount()
+{
+    sf::Lock lock(s_mutex);
+    return s_graphics.size();
+}
+
+bool ResourceManager::readMapSize(std::string id, int & sizeX, int & sizeY)
+{
+    // type code, version, sizeX, sizeY
+    char header[sizeof(char) + 3 * sizeof(int)];
+    int bytesRead;
+    {
+        sf::Lock lock(s_mutex);
+        assert(resourceFile != NULL);
+        bytesRead = resourceFile->getResourcePrefix(id, header, sizeof(header));
+    }
+    if (bytesRead == -1) {
+        std::cerr << "Unable to find Map: " << id << std::endl;
+        return false;
+    }
+    if (bytesRead != (int)sizeof(header) || header[0] != 'M') {
+        std::cerr << "Resource " << id << " is not a Map." << std::endl;
+        return false;
+    }
+    const char * cursor = header + sizeof(char);
+    Utils::readInt(&cursor); // version
+    sizeX = Utils::readInt(&cursor);
+    sizeY = Utils::readInt(&cursor);
+    return true;
+}
+
+char * ResourceManager::readMapBuffer(std::string id)
+{
+    return readResource("Map", 'M', id);
+}
+
+Map * ResourceManager::loadMap(const char * buffer)
+{
+    return Map::load(buffer + sizeof(char));
+}
+
+void ResourceManager::prefetchGraphic(std::string id)
+{
+    sf::Lock lock(s_mutex);
+    if (resourceFile == NULL)
+        return;
+    if (s_graphics.find(id) != s_graphics.end() || s_prefetched.find(id) != s_prefetched.end())
+        return;
+    char * buffer = resourceFile->getResource(id);
+    if (buffer != NULL)
+        s_prefetched[id] = buffer;
+}
+
+char * ResourceManager::readResource(std::string resourceTypeName, char typeCode, std::string id)
+{
+    char * buffer = NULL;
+    {
+        sf::Lock lock(s_mutex);
+        std::map<std::string, const char *>::iterator it = s_prefetched.find(id);
+        if (it != s_prefetched.end()) {
+            buffer = (char *)it->second;
+            s_prefetched.erase(it);
+        } else {
+            assert(resourceFile != NULL);
+            buffer = resourceFile->getResource(id);
+        }
+    }
+    if (buffer == NULL) {
+        std::cerr << "Unable to find " + resourceTypeName + ": " << id << std::endl;
+        return NULL;
+    }
+    char actualTypeCode = *buffer;
+    if (actualTypeCode != typeCode) {
+        std::cerr << "Wrong type code in resource " << id << ". " <<
+                "Should be '" << typeCode << "' but it's '" << actualTypeCode << "'." << std::endl;
+        delete[] buffer;
+        return NULL;
+    }
+    return buffer;
+}
@@ -6,28 +6,89 @@
 
 #include "Debug.h"
 
+#include <SFML/System.hpp>
+
 class Universe;
 class Map;
 class Graphic;
 class Entity;
 
+// ResourceManager keeps the resource file open while the game is running and
+// hands out game objects loaded from it.
+// Everything that touches the disk is protected by a mutex, so the methods
+// marked as thread safe can be called from a background loader.
 class ResourceManager {
 public:
     static Universe * loadUniverse(std::string resourceFilePath, std::string id);
+    // close the resource file and free the caches
+    static void close();
 
     static World * getWorld(std::string id);
+    // maps are not cached. every call parses a new Map.
     static Map * getMap(std::string id);
-    static Graphic * getGraphic(std::string id);
     static Entity * getEntity(std::string id);
 
+    // graphics are shared and reference counted. every getGraphic (and
+    // retainGraphic) must be matched by a releaseGraphic.
+    static Graphic * getGraphic(std::string id);
+    static void retainGraphic(Graphic * graphic);
+    static void releaseGraphic(Graphic * graphic);
+    // number of graphics in memory
+    static int graphicCount();
+
+    // while another thread might still be drawing a graphic, releasing the
+    // last reference can't delete it right away. it's kept, tagged with the
+    // current generation, until deleteReleasedGraphics is told that nothing
+    // from that generation is in use anymore. see RenderThread.
+    // turning it on starts the generations over at 0. turning it off
+    // deletes everything that was waiting
+    static void setDeferGraphicDeletes(bool value);
+    static void setGraphicGeneration(unsigned int generation);
+    // delete the released graphics from generations older than this one
+    static void deleteReleasedGraphics(unsigned int oldestGenerationInUse);
+
+    // read the size of a map (in tiles) without loading it. returns success
+    static bool readMapSize(std::string id, int & sizeX, int & sizeY);
+
+    // thread safe. read a map resource into memory, returning NULL on error.
+    // it's your job to delete[] the buffer, after passing it to loadMap.
+    static char * readMapBuffer(std::string id);
+    // parse a buffer returned by readMapBuffer
+    static Map * loadMap(const char * buffer);
+    // thread safe. read a graphic resource ahead of time, so that loading it
+    // later doesn't have to wait for the disk.
+    static void prefetchGraphic(std::string id);
+
 private:
+    typedef struct {
+        std::string id;
+        int references;
+    } GraphicRecord;
+
     static ResourceFile * resourceFile;
+    // protects resourceFile, s_prefetched, s_graphics and s_graphicRecords
+    static sf::Mutex s_mutex;
 
     static std::map<std::string, const char *> s_worlds;
-    static std::map<std::string, const char *> s_maps;
     static std::map<std::string, const char *> s_entities;
+    // raw resources read ahead of time by prefetchGraphic
+    static std::map<std::string, const char *> s_prefetched;
 
     static std::map<std::string, Graphic*> s_graphics;
+    static std::map<Graphic*, GraphicRecord> s_graphicRecords;
+
+    typedef struct {
+        Graphic * graphic;
+        unsigned int generation;
+    } ReleasedGraphic;
+
+    static bool s_deferGraphicDeletes;
+    static unsigned int s_graphicGeneration;
+    static std::vector<ReleasedGraphic> s_releasedGraphics;
+
+    // read a resource, using a prefetched copy if there is one. checks the
+    // type code. it's your job to delete[] the buffer.
+    static char * readResource(std::string resourceTypeName, char typeCode, std::string id);
 
     template <class T>
     static T * find(std::map<std::string, T*> & map, std::string id) {
@@ -42,48 +103,14 @@ private:
         assert(resourceFile != NULL);
         const char * buffer = find(cache, id);
         if (buffer == NULL) {
-            buffer = resourceFile->getResource(id);
-            if (buffer == NULL) {
-                std::cerr << "Unable to find " + resourceTypeName + ": " << id << std::endl;
-                return NULL;
-            }
-            char actualTypeCode = *buffer;
-            if (actualTypeCode != typeCode) {
-                std::cerr << "Wrong type code in resource " << id << ". " <<
-                        "Should be '" << typeCode << "' but it's '" << actualTypeCode << "'." << std::endl;
-                delete buffer;
+            buffer = readResource(resourceTypeName, typeCode, id);
+            if (buffer == NULL)
                 return NULL;
-            }
             cache[id] = buffer;
         }
         T * resource = T::load(buffer + sizeof(char));
         return resource;
     }
-
-    template <class T>
-    static T * loadCachedResource(std::string resourceTypeName, std::map<std::string, T*> & cache, char typeCode, std::string id) {
-        assert(resourceFile != NULL);
-        T * resource = find(cache, id);
-        if (resource == NULL) {
-            const char * buffer = resourceFile->getResource(id);
-            if (buffer == NULL) {
-                std::cerr << "Unable to find " + resourceTypeName + ": " << id << std::endl;
-                return NULL;
-            }
-            char actualTypeCode = *buffer;
-            if (actualTypeCode != typeCode) {
-                std::cerr << "Wrong type code in resource " << id << ". " <<
-                        "Should be '" << typeCode << "' but it's '" << actualTypeCode << "'." << std::endl;
-                delete buffer;
-                return NULL;
-            }
-            resource = T::load(buffer + sizeof(char));
-            delete buffer;
-            if (resource != NULL)
-                cache[id] = resource;
-        }
-        return resource;
-    }
 };
 
 #endif
@@ -0,0 +1,32 @@
+#include "SfmlRenderBackend.h"
+
+SfmlRenderBackend::SfmlRenderBackend(sf::RenderWindow * window) :
+    m_window(window),
+    m_sprite()
+{
+}
+
+void SfmlRenderBackend::render(RenderCommandBuffer * buffer, double interpolation)
+{
+    // generic background color
+    m_window->Clear();
+
+    sortQuads(buffer);
+    double cameraX = buffer->cameraX(interpolation);
+    double cameraY = buffer->cameraY(interpolation);
+    std::vector<int> * quads = order();
+    sf::Image * image = NULL;
+    for (unsigned int i = 0; i < quads->size(); i++) {
+        RenderCommandBuffer::Quad * quad = buffer->quad((*quads)[i]);
+        if (quad->image == NULL)
+            continue;
+        if (quad->image != image) {
+            image = quad->image;
+            m_sprite.SetImage(*image);
+        }
+        m_sprite.SetSubRect(sf::IntRect(quad->sourceLeft, quad->sourceTop,
+                                        quad->sourceLeft + quad->width, quad->sourceTop + quad->height));
+        m_sprite.SetPosition(screenX(quad, cameraX, interpolation), screenY(quad, cameraY, interpolation));
+        m_window->Draw(m_sprite);
+    }
+}
@@ -0,0 +1,23 @@
+#ifndef _SFML_RENDER_BACKEND_H_
+#define _SFML_RENDER_BACKEND_H_
+
+#include "RenderBackend.h"
+
+#include <SFML/Graphics.hpp>
+
+// draws to an SFML window. each batch sets the image once and then draws
+// its quads, instead of switching images for every sprite
+class SfmlRenderBackend : public RenderBackend
+{
+public:
+    SfmlRenderBackend(sf::RenderWindow * window);
+
+    // clears the window and draws. showing it is up to the caller
+    void render(RenderCommandBuffer * buffer, double interpolation);
+
+private:
+    sf::RenderWindow * m_window;
+    sf::Sprite m_sprite;
+};
+
+#endif
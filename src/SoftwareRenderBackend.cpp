@@ -0,0 +1,199 @@
+#include "SoftwareRenderBackend.h"
+
+#include <SFML/Graphics.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// the framebuffer is cleared to this. opaque black
+static const sf::Uint8 c_clearColor[4] = { 0, 0, 0, 255 };
+// picks out the alpha byte of each pixel, whatever the byte order
+static const sf::Uint8 c_alphaMask[16] = {
+    0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255,
+};
+
+// .png needs a crc on every chunk and an adler32 on the zlib stream
+static sf::Uint32 crc32(sf::Uint32 crc, const sf::Uint8 * data, int size);
+static sf::Uint32 adler32(sf::Uint32 adler, const sf::Uint8 * data, int size);
+static void writeUint32(std::vector<sf::Uint8> & out, sf::Uint32 value);
+static void writeChunk(std::ofstream & out, const char * type, const std::vector<sf::Uint8> & data);
+
+SoftwareRenderBackend::SoftwareRenderBackend(int width, int height) :
+    m_width(width), m_height(height),
+    m_pixels(width * height),
+    m_pixelCount(0)
+{
+}
+
+void SoftwareRenderBackend::render(RenderCommandBuffer * buffer, double interpolation)
+{
+    sf::Uint32 clearColor;
+    memcpy(&clearColor, c_clearColor, sizeof(clearColor));
+    std::fill(m_pixels.begin(), m_pixels.end(), clearColor);
+
+    sortQuads(buffer);
+    double cameraX = buffer->cameraX(interpolation);
+    double cameraY = buffer->cameraY(interpolation);
+    std::vector<int> * quads = order();
+    m_pixelCount = 0;
+    for (unsigned int i = 0; i < quads->size(); i++) {
+        RenderCommandBuffer::Quad * quad = buffer->quad((*quads)[i]);
+        if (quad->image == NULL)
+            continue;
+
+        // clip to the screen
+        int x = screenX(quad, cameraX, interpolation);
+        int y = screenY(quad, cameraY, interpolation);
+        int left = x < 0 ? -x : 0;
+        int top = y < 0 ? -y : 0;
+        int right = x + quad->width > m_width ? m_width - x : quad->width;
+        int bottom = y + quad->height > m_height ? m_height - y : quad->height;
+        if (left >= right || top >= bottom)
+            continue;
+
+        int imageWidth = quad->image->GetWidth();
+        const sf::Uint32 * source = (const sf::Uint32 *) quad->image->GetPixelsPtr();
+        source += (quad->sourceTop + top) * imageWidth + quad->sourceLeft + left;
+        sf::Uint32 * dest = &m_pixels[(y + top) * m_width + x + left];
+        for (int row = top; row < bottom; row++) {
+            blitRow(dest, source, right - left);
+            source += imageWidth;
+            dest += m_width;
+        }
+        m_pixelCount += (long long)(right - left) * (bottom - top);
+    }
+}
+
+void SoftwareRenderBackend::blitRow(sf::Uint32 * dest, const sf::Uint32 * source, int count)
+{
+    int i = 0;
+#if defined(__SSE2__)
+    // 4 pixels at a time: where the alpha is 0 keep dest, otherwise take source
+    __m128i alphaMasks = _mm_loadu_si128((const __m128i *) c_alphaMask);
+    __m128i zero = _mm_setzero_si128();
+    for (; i + 4 <= count; i += 4) {
+        __m128i src = _mm_loadu_si128((const __m128i *)(source + i));
+        __m128i dst = _mm_loadu_si128((const __m128i *)(dest + i));
+        __m128i clear = _mm_cmpeq_epi32(_mm_and_si128(src, alphaMasks), zero);
+        dst = _mm_or_si128(_mm_and_si128(clear, dst), _mm_andnot_si128(clear, src));
+        _mm_storeu_si128((__m128i *)(dest + i), dst);
+    }
+#endif
+    sf::Uint32 alphaMask;
+    memcpy(&alphaMask, c_alphaMask, sizeof(alphaMask));
+    for (; i < count; i++) {
+        if (source[i] & alphaMask)
+            dest[i] = source[i];
+    }
+}
+
+bool SoftwareRenderBackend::savePng(std::string filename)
+{
+    std::ofstream out(filename.c_str(), std::ios::out | std::ios::binary);
+    if (! out.good()) {
+        std::cerr << "Unable to write image " << filename << std::endl;
+        return false;
+    }
+    const sf::Uint8 signature[8] = { 137, 'P', 'N', 'G', '\r', '\n', 26, '\n' };
+    out.write((const char *) signature, sizeof(signature));
+
+    std::vector<sf::Uint8> header;
+    writeUint32(header, m_width);
+    writeUint32(header, m_height);
+    header.push_back(8); // bits per channel
+    header.push_back(6); // RGBA
+    header.push_back(0); // deflate
+    header.push_back(0); // the only filter method
+    header.push_back(0); // not interlaced
+    writeChunk(out, "IHDR", header);
+
+    // every row starts with a filter type, 0 being none
+    int rowSize = m_width * 4 + 1;
+    std::vector<sf::Uint8> rows(rowSize * m_height);
+    for (int y = 0; y < m_height; y++) {
+        rows[y * rowSize] = 0;
+        memcpy(&rows[y * rowSize + 1], &m_pixels[y * m_width], m_width * 4);
+    }
+
+    // a zlib stream of uncompressed deflate blocks. bigger files, but nothing
+    // to get wrong and nothing to depend on
+    std::vector<sf::Uint8> data;
+    data.push_back(0x78);
+    data.push_back(0x01);
+    const int blockSize = 65535;
+    int offset = 0;
+    do {
+        int size = (int)rows.size() - offset;
+        if (size > blockSize)
+            size = blockSize;
+        bool last = offset + size == (int)rows.size();
+        data.push_back(last ? 1 : 0);
+        data.push_back(size & 0xff);
+        data.push_back((size >> 8) & 0xff);
+        data.push_back(~size & 0xff);
+        data.push_back((~size >> 8) & 0xff);
+        data.insert(data.end(), rows.begin() + offset, rows.begin() + offset + size);
+        offset += size;
+    } while (offset < (int)rows.size());
+    writeUint32(data, adler32(1, &rows[0], rows.size()));
+    writeChunk(out, "IDAT", data);
+
+    writeChunk(out, "IEND", std::vector<sf::Uint8>());
+    return out.good();
+}
+
+sf::Uint32 crc32(sf::Uint32 crc, const sf::Uint8 * data, int size)
+{
+    static sf::Uint32 table[256];
+    static bool tableReady = false;
+    if (! tableReady) {
+        for (sf::Uint32 i = 0; i < 256; i++) {
+            sf::Uint32 value = i;
+            for (int bit = 0; bit < 8; bit++)
+                value = value & 1 ? 0xedb88320 ^ (value >> 1) : value >> 1;
+            table[i] = value;
+        }
+        tableReady = true;
+    }
+    crc = ~crc;
+    for (int i = 0; i < size; i++)
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+sf::Uint32 adler32(sf::Uint32 adler, const sf::Uint8 * data, int size)
+{
+    sf::Uint32 a = adler & 0xffff;
+    sf::Uint32 b = adler >> 16;
+    for (int i = 0; i < size; i++) {
+        a = (a + data[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    return (b << 16) | a;
+}
+
+void writeUint32(std::vector<sf::Uint8> & out, sf::Uint32 value)
+{
+    // .png is big endian
+    out.push_back((value >> 24) & 0xff);
+    out.push_back((value >> 16) & 0xff);
+    out.push_back((value >> 8) & 0xff);
+    out.push_back(value & 0xff);
+}
+
+void writeChunk(std::ofstream & out, const char * type, const std::vector<sf::Uint8> & data)
+{
+    std::vector<sf::Uint8> chunk;
+    writeUint32(chunk, data.size());
+    chunk.insert(chunk.end(), type, type + 4);
+    chunk.insert(chunk.end(), data.begin(), data.end());
+    // the crc covers the type and the data but not the length
+    writeUint32(chunk, crc32(0, &chunk[4], chunk.size() - 4));
+    out.write((const char *) &chunk[0], chunk.size());
+}
@@ -0,0 +1,46 @@
+#ifndef _SOFTWARE_RENDER_BACKEND_H_
+#define _SOFTWARE_RENDER_BACKEND_H_
+
+#include "RenderBackend.h"
+
+#include <SFML/Config.hpp>
+
+#include <string>
+#include <vector>
+
+// draws into an RGBA framebuffer in memory, without OpenGL. pixels that the
+// color key masked out are skipped and everything else is copied as is,
+// which is all the blending the game does.
+// for comparing frames against known good ones, and for timing drawing on
+// machines with no graphics card.
+class SoftwareRenderBackend : public RenderBackend
+{
+public:
+    SoftwareRenderBackend(int width, int height);
+
+    // clears to black and draws
+    void render(RenderCommandBuffer * buffer, double interpolation);
+
+    int width() { return m_width; }
+    int height() { return m_height; }
+    // 4 bytes per pixel, in the same order as sf::Image
+    const sf::Uint8 * pixels() { return (const sf::Uint8 *) &m_pixels[0]; }
+
+    // how many pixels the last render copied, counting overdraw
+    long long pixelCount() { return m_pixelCount; }
+
+    // write the framebuffer out as a .png. returns false if the file couldn't
+    // be written
+    bool savePng(std::string filename);
+
+private: //variables
+    int m_width, m_height;
+    std::vector<sf::Uint32> m_pixels;
+    long long m_pixelCount;
+
+private: //methods
+    // copy count pixels, leaving dest alone where source has no alpha
+    static void blitRow(sf::Uint32 * dest, const sf::Uint32 * source, int count);
+};
+
+#endif
@@ -1,9 +1,9 @@
 #include "Tile.h"
 
 #include "Utils.h"
-#include "Gameplay.h"
 #include "ResourceManager.h"
 #include "Physics.h"
+#include "RenderCommandBuffer.h"
 
 #include <cmath>
 
@@ -23,6 +23,7 @@ Tile * Tile::loadFromMemory(const char** cursor)
         delete out;
         return NULL;
     }
+    out->m_tall = out->m_graphic->height() > sizeInt;
 
     return out;
 }
@@ -30,24 +31,38 @@ Tile * Tile::loadFromMemory(const char** cursor)
 Tile::Tile() :
     m_shape(tsSolidWall),
     m_surfaceType(stNormal),
-    m_graphic(NULL)
+    m_graphic(NULL),
+    m_tall(false)
 {
 }
 
 Tile::Tile(const Tile & tile) :
     m_shape(tile.m_shape),
     m_surfaceType(tile.m_surfaceType),
-    m_graphic(tile.m_graphic)
+    m_graphic(tile.m_graphic),
+    m_tall(tile.m_tall)
 {
+    if (m_graphic != NULL)
+        ResourceManager::retainGraphic(m_graphic);
 }
 
 Tile::~Tile() {
+    if (m_graphic != NULL)
+        ResourceManager::releaseGraphic(m_graphic);
 }
 
-void Tile::draw(int screenX, int screenY) {
+void Tile::draw(RenderCommandBuffer * commands, double x, double y) {
     if (m_graphic == NULL)
         return;
-    m_graphic->draw(Gameplay::instance()->screen(), screenX, screenY);
+    commands->add(m_graphic, x, y);
+}
+
+int Tile::graphicWidth() {
+    return m_graphic == NULL ? 0 : m_graphic->width();
+}
+
+int Tile::graphicHeight() {
+    return m_graphic == NULL ? 0 : m_graphic->height();
 }
 
 bool Tile::hasMinPresence(PhysicalPresence minPresence) {
@@ -131,6 +146,156 @@ void Tile::resolveCircleCollision(double tileX, double tileY, double & objectCen
     }
 }
 
+bool Tile::raycast(double tileX, double tileY, double fromX, double fromY, double dx, double dy,
+                   double tEnter, double tExit, PhysicalPresence minPresence, double & t)
+{
+    if (!hasMinPresence(minPresence))
+        return false;
+    // the floor under the diagonals and rails is in the way too when the
+    // threshold is that low, so it's the whole square
+    if (minPresence <= ppFloor) {
+        t = tEnter;
+        return true;
+    }
+
+    double localX = fromX - tileX, localY = fromY - tileY;
+    switch (m_shape) {
+    case tsSolidWall:
+        t = tEnter;
+        return true;
+    // floor + wall diagonals. tsDiag(pp1)(pp2)(where-pp2-is)
+    case tsDiagFloorWallNW:
+        return raycastHalfPlane(1.0, 1.0, -Tile::size, localX, localY, dx, dy, tEnter, tExit, t);
+    case tsDiagFloorWallNE:
+        return raycastHalfPlane(-1.0, 1.0, 0.0, localX, localY, dx, dy, tEnter, tExit, t);
+    case tsDiagFloorWallSE:
+        return raycastHalfPlane(-1.0, -1.0, Tile::size, localX, localY, dx, dy, tEnter, tExit, t);
+    case tsDiagFloorWallSW:
+        return raycastHalfPlane(1.0, -1.0, 0.0, localX, localY, dx, dy, tEnter, tExit, t);
+    // floor + rail orientations
+    case tsFloorRailN:
+        return raycastEdge(0.0, localY, dy, tEnter, tExit, t);
+    case tsFloorRailE:
+        return raycastEdge(Tile::size, localX, dx, tEnter, tExit, t);
+    case tsFloorRailS:
+        return raycastEdge(Tile::size, localY, dy, tEnter, tExit, t);
+    case tsFloorRailW:
+        return raycastEdge(0.0, localX, dx, tEnter, tExit, t);
+    default:
+        // floors and holes only get this far when the threshold is low
+        // enough to block on the whole square
+        assert(false);
+        return false;
+    }
+}
+
+bool Tile::raycastHalfPlane(double a, double b, double c, double fromX, double fromY, double dx, double dy,
+                            double tEnter, double tExit, double & t)
+{
+    // how far into the wall side, linear in t. negative is in the wall
+    double sideAtStart = a * fromX + b * fromY + c;
+    double slope = a * dx + b * dy;
+    if (sideAtStart + slope * tEnter <= 0.0) {
+        t = tEnter;
+        return true;
+    }
+    if (slope >= 0.0)
+        return false;
+    t = -sideAtStart / slope;
+    return t <= tExit;
+}
+
+bool Tile::raycastEdge(double edge, double from, double d, double tEnter, double tExit, double & t)
+{
+    // running along the rail only grazes it
+    if (d == 0.0)
+        return false;
+    t = (edge - from) / d;
+    // the ray enters or leaves through the edge, but tEnter and tExit were
+    // worked out in a different order, so allow a little rounding
+    double slack = 1e-6 / std::fabs(d);
+    if (t < tEnter - slack || t > tExit + slack)
+        return false;
+    t = Utils::min(Utils::max(t, tEnter), tExit);
+    return true;
+}
+
+bool Tile::sweepCircle(double tileX, double tileY, double fromX, double fromY, double dx, double dy,
+                       double radius, double & t, double & normalX, double & normalY)
+{
+    const double square[4][2] = { {0.0, 0.0}, {size, 0.0}, {size, size}, {0.0, size} };
+    const double triangleNW[3][2] = { {0.0, 0.0}, {size, 0.0}, {0.0, size} };
+    const double triangleNE[3][2] = { {0.0, 0.0}, {size, 0.0}, {size, size} };
+    const double triangleSE[3][2] = { {size, 0.0}, {size, size}, {0.0, size} };
+    const double triangleSW[3][2] = { {0.0, 0.0}, {size, size}, {0.0, size} };
+
+    double localX = fromX - tileX, localY = fromY - tileY;
+    switch (m_shape) {
+    case tsSolidWall:
+        return sweepCircleOnPolygon(square, 4, localX, localY, dx, dy, radius, t, normalX, normalY);
+    case tsSolidFloor:
+    case tsSolidHole:
+        return false;
+    // floor + wall diagonals. tsDiag(pp1)(pp2)(where-pp2-is)
+    case tsDiagFloorWallNW:
+        return sweepCircleOnPolygon(triangleNW, 3, localX, localY, dx, dy, radius, t, normalX, normalY);
+    case tsDiagFloorWallNE:
+        return sweepCircleOnPolygon(triangleNE, 3, localX, localY, dx, dy, radius, t, normalX, normalY);
+    case tsDiagFloorWallSE:
+        return sweepCircleOnPolygon(triangleSE, 3, localX, localY, dx, dy, radius, t, normalX, normalY);
+    case tsDiagFloorWallSW:
+        return sweepCircleOnPolygon(triangleSW, 3, localX, localY, dx, dy, radius, t, normalX, normalY);
+    // floor + rail orientations. rails only push back toward the tile, so
+    // only moving out over one stops at it
+    case tsFloorRailN:
+        return dy < 0.0 && Physics::sweepSegmentAndCircle(0.0, 0.0, size, 0.0, localX, localY, radius,
+                                                          dx, dy, t, normalX, normalY);
+    case tsFloorRailE:
+        return dx > 0.0 && Physics::sweepSegmentAndCircle(size, 0.0, size, size, localX, localY, radius,
+                                                          dx, dy, t, normalX, normalY);
+    case tsFloorRailS:
+        return dy > 0.0 && Physics::sweepSegmentAndCircle(0.0, size, size, size, localX, localY, radius,
+                                                          dx, dy, t, normalX, normalY);
+    case tsFloorRailW:
+        return dx < 0.0 && Physics::sweepSegmentAndCircle(0.0, 0.0, 0.0, size, localX, localY, radius,
+                                                          dx, dy, t, normalX, normalY);
+    default:
+        assert(false);
+        return false;
+    }
+}
+
+bool Tile::sweepCircleOnPolygon(const double (*corners)[2], int count, double fromX, double fromY,
+                                double dx, double dy, double radius, double & t,
+                                double & normalX, double & normalY)
+{
+    // starting inside is for resolveCircleCollision to sort out. inside a
+    // convex shape is on the same side of every edge
+    int sides = 0;
+    for (int i = 0; i < count; i++) {
+        const double * a = corners[i], * b = corners[(i + 1) % count];
+        double cross = (b[0] - a[0]) * (fromY - a[1]) - (b[1] - a[1]) * (fromX - a[0]);
+        sides += cross > 0.0 ? 1 : (cross < 0.0 ? -1 : 0);
+    }
+    if (sides == count || sides == -count)
+        return false;
+
+    bool hit = false;
+    for (int i = 0; i < count; i++) {
+        const double * a = corners[i], * b = corners[(i + 1) % count];
+        double edgeT, nx, ny;
+        if (Physics::sweepSegmentAndCircle(a[0], a[1], b[0], b[1], fromX, fromY, radius, dx, dy, edgeT, nx, ny) &&
+            (! hit || edgeT < t))
+        {
+            hit = true;
+            t = edgeT;
+            normalX = nx;
+            normalY = ny;
+        }
+    }
+    return hit;
+}
+
 void Tile::resolveCircleOnSquare(double tileX, double tileY, double & objectCenterX, double & objectCenterY, double objectRadius) {
     double dx, dy;
     Physics::squareAndCircle(tileX + Tile::size * 0.5, tileY + Tile::size * 0.5, Tile::size * 0.5, objectCenterX, objectCenterY, objectRadius, dx, dy);
@@ -3,6 +3,8 @@
 
 #include "Graphic.h"
 
+class RenderCommandBuffer;
+
 class Tile
 {
 public: //variables
@@ -54,10 +56,31 @@ public: //methods
     Tile(); // null constructor - constructs a null tile
     ~Tile();
 
-    // screenX and screenY is the absolute coordinates of 0,0 on the screen
-    void draw(int screenX, int screenY);
+    // record it with its top left at x, y in the world
+    void draw(RenderCommandBuffer * commands, double x, double y);
+    // tiles whose graphic is taller than a tile stick out over the tiles
+    // below them, so they get depth sorted with the entities instead of
+    // drawn with the rest of the layer
+    bool isTall() { return m_tall; }
+    // size of the graphic in pixels
+    int graphicWidth();
+    int graphicHeight();
     bool hasMinPresence(PhysicalPresence minPresence);
     void resolveCircleCollision(double tileX, double tileY, double & objectCenterX, double & objectCenterY, double objectRadius);
+    // the segment from + t * (dx, dy) runs through the tile for t in
+    // [tEnter, tExit]. finds the first t where it runs into a part of the
+    // tile that sticks up at least minPresence. returns false if it gets
+    // through
+    bool raycast(double tileX, double tileY, double fromX, double fromY, double dx, double dy,
+                 double tEnter, double tExit, PhysicalPresence minPresence, double & t);
+    // a circle moving from fromX, fromY by dx, dy. finds the first t from 0
+    // to 1 where it runs into a wall, a diagonal, or a rail it's moving out
+    // over, and the unit normal pointing back out at it. that includes the
+    // north and south rails, which resolveCircleCollision doesn't handle
+    // yet. returns false if it gets through, or starts inside a wall or a
+    // diagonal and is left to resolveCircleCollision
+    bool sweepCircle(double tileX, double tileY, double fromX, double fromY, double dx, double dy,
+                     double radius, double & t, double & normalX, double & normalY);
 
     void setShape(Shape shape) { m_shape = shape; }
     Shape shape() { return m_shape; }
@@ -71,11 +94,22 @@ private:
     static void resolveCircleOnTriangleSE(double tileX, double tileY, double & objectCenterX, double & objectCenterY, double objectRadius);
     static void resolveCircleOnTriangleSW(double tileX, double tileY, double & objectCenterX, double & objectCenterY, double objectRadius);
     static void resolveCircleOnPoint(double pointX, double pointY, double & objectCenterX, double & objectCenterY, double objectRadius);
+    // the wall half of a diagonal is where a * x + b * y + c <= 0, with x and
+    // y relative to the tile
+    static bool raycastHalfPlane(double a, double b, double c, double fromX, double fromY, double dx, double dy,
+                                 double tEnter, double tExit, double & t);
+    // rails are a line along one edge. one dimension of the ray at a time
+    static bool raycastEdge(double edge, double from, double d, double tEnter, double tExit, double & t);
+    // corners are relative to the tile, going around a convex shape
+    static bool sweepCircleOnPolygon(const double (*corners)[2], int count, double fromX, double fromY,
+                                     double dx, double dy, double radius, double & t,
+                                     double & normalX, double & normalY);
 
     Shape m_shape;
     SurfaceType m_surfaceType;
 
     Graphic * m_graphic;
+    bool m_tall;
 };
 
 #endif
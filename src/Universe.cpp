@@ -17,6 +17,9 @@ Universe::Universe() :
 
 Universe::~Universe()
 {
+    for (unsigned int i = 0; i < m_worlds.size(); i++)
+        delete m_worlds[i];
+    delete m_player;
 }
 
 Universe * Universe::load(const char * buffer)
@@ -0,0 +1,185 @@
+#include "WorkerPool.h"
+
+#include "Parking.h"
+#include "Profiler.h"
+#include "Utils.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+const int WorkerPool::c_spinCount = 1000;
+
+int WorkerPool::processorCount()
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return Utils::max(1, (int)info.dwNumberOfProcessors);
+#else
+    return Utils::max(1, (int)sysconf(_SC_NPROCESSORS_ONLN));
+#endif
+}
+
+WorkerPool::WorkerPool(int threadCount) :
+    m_workers(),
+    m_job(NULL),
+    m_context(NULL),
+    m_remaining(0),
+    m_quit(0),
+    m_generation(0),
+    m_parking(new Parking()),
+    m_chunkCount(0),
+    m_stealCount(0)
+{
+    if (threadCount < 0)
+        threadCount = processorCount() - 1;
+
+    for (int i = 0; i < threadCount + 1; i++) {
+        Worker * worker = new Worker();
+        worker->pool = this;
+        worker->index = i;
+        worker->first = 0;
+        worker->thread = NULL;
+        m_workers.push_back(worker);
+    }
+    // worker 0 is whoever calls run
+    for (unsigned int i = 1; i < m_workers.size(); i++) {
+        m_workers[i]->thread = new sf::Thread(&WorkerPool::threadMain, m_workers[i]);
+        m_workers[i]->thread->Launch();
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    __sync_lock_test_and_set(&m_quit, 1);
+    unpark();
+    // everyone has to stop before the queues go away, since idle workers
+    // look in each other's queues
+    for (unsigned int i = 1; i < m_workers.size(); i++) {
+        m_workers[i]->thread->Wait();
+        delete m_workers[i]->thread;
+    }
+    for (unsigned int i = 0; i < m_workers.size(); i++)
+        delete m_workers[i];
+    delete m_parking;
+}
+
+void WorkerPool::run(Job job, void * context, int count, int grain)
+{
+    if (count <= 0)
+        return;
+    grain = Utils::max(grain, 1);
+    int chunkCount = (count + grain - 1) / grain;
+    if (chunkCount == 1 || m_workers.size() == 1) {
+        // not worth waking anybody up
+        job(context, 0, 0, count);
+        return;
+    }
+
+    m_job = job;
+    m_context = context;
+    m_chunkCount = chunkCount;
+    m_stealCount = 0;
+    __sync_lock_test_and_set(&m_remaining, chunkCount);
+
+    // deal out contiguous runs of chunks, so neighboring items tend to stay
+    // on the same worker
+    int workerCount = m_workers.size();
+    for (int w = 0; w < workerCount; w++) {
+        Worker * worker = m_workers[w];
+        sf::Lock lock(worker->mutex);
+        worker->chunks.clear();
+        worker->first = 0;
+        for (int c = chunkCount * w / workerCount; c < chunkCount * (w + 1) / workerCount; c++) {
+            Chunk chunk;
+            chunk.begin = c * grain;
+            chunk.end = Utils::min(count, chunk.begin + grain);
+            worker->chunks.push_back(chunk);
+        }
+    }
+    unpark();
+
+    // the atomic read makes the workers' results visible to us
+    while (__sync_fetch_and_add(&m_remaining, 0) > 0) {
+        if (! runOneChunk(m_workers[0]))
+            sf::Sleep(0.0f); // someone else is finishing the last chunks
+    }
+}
+
+void WorkerPool::threadMain(void * worker)
+{
+    Worker * self = (Worker *)worker;
+    self->pool->workerLoop(self);
+}
+
+void WorkerPool::workerLoop(Worker * worker)
+{
+    Profiler::nameThread("worker");
+    int idle = 0;
+    int generation;
+    {
+        Parking::Lock lock(*m_parking);
+        generation = m_generation;
+    }
+    while (! __sync_fetch_and_add(&m_quit, 0)) {
+        if (runOneChunk(worker)) {
+            idle = 0;
+        } else if (++idle > c_spinCount) {
+            park(generation);
+            idle = 0;
+        }
+    }
+}
+
+void WorkerPool::park(int & generation)
+{
+    // a run that came and went while we were spinning counts as new work,
+    // which just means one more look before really parking
+    Parking::Lock lock(*m_parking);
+    while (m_generation == generation && ! __sync_fetch_and_add(&m_quit, 0))
+        m_parking->wait();
+    generation = m_generation;
+}
+
+void WorkerPool::unpark()
+{
+    Parking::Lock lock(*m_parking);
+    m_generation++;
+    m_parking->wakeAll(m_workers.size() - 1);
+}
+
+bool WorkerPool::runOneChunk(Worker * worker)
+{
+    Chunk chunk;
+    bool found = false;
+    {
+        // newest first from our own queue
+        sf::Lock lock(worker->mutex);
+        if (worker->chunks.size() > worker->first) {
+            chunk = worker->chunks.back();
+            worker->chunks.pop_back();
+            found = true;
+        }
+    }
+    for (unsigned int i = 1; ! found && i < m_workers.size(); i++) {
+        // oldest first from somebody else's
+        Worker * victim = m_workers[(worker->index + i) % m_workers.size()];
+        sf::Lock lock(victim->mutex);
+        if (victim->chunks.size() > victim->first) {
+            chunk = victim->chunks[victim->first];
+            victim->first++;
+            found = true;
+            __sync_fetch_and_add(&m_stealCount, 1);
+        }
+    }
+    if (! found)
+        return false;
+
+    m_job(m_context, worker->index, chunk.begin, chunk.end);
+    __sync_fetch_and_sub(&m_remaining, 1);
+    return true;
+}
@@ -0,0 +1,89 @@
+#ifndef _WORKER_POOL_H_
+#define _WORKER_POOL_H_
+
+#include <SFML/System.hpp>
+
+#include <vector>
+
+class Parking;
+
+// WorkerPool runs a job over a range of items on several threads.
+// The range is cut into chunks which are dealt out to the workers. A worker
+// that runs out of chunks steals from the others, so one slow chunk doesn't
+// hold everyone up. The thread that calls run is worker 0 and helps out.
+// Workers that stay out of work for a while park until the next run, so an
+// idle pool doesn't use any processor time.
+//
+// which worker runs which chunk is not deterministic, so jobs must only
+// write to things that belong to their own items (or to per-worker scratch
+// space picked by the worker index).
+class WorkerPool
+{
+public:
+    // run the job on items [begin, end). worker is in [0, workerCount())
+    typedef void (*Job)(void * context, int worker, int begin, int end);
+
+    // threadCount is how many threads to start besides the calling one.
+    // -1 uses every processor.
+    WorkerPool(int threadCount);
+    ~WorkerPool();
+
+    int workerCount() { return m_workers.size(); }
+
+    // run job on [0, count) in chunks of grain items, and wait until it's done
+    void run(Job job, void * context, int count, int grain);
+
+    // metrics
+    int chunkCount() { return m_chunkCount; }
+    // how many chunks were run by a worker they weren't dealt to
+    int stealCount() { return m_stealCount; }
+
+    static int processorCount();
+
+private: //variables
+    // how many times an idle worker looks for work before parking
+    static const int c_spinCount;
+
+    typedef struct {
+        int begin, end;
+    } Chunk;
+
+    class Worker {
+    public:
+        WorkerPool * pool;
+        int index;
+        sf::Mutex mutex;
+        // chunks [first, chunks.size()) are left. the owner takes from the
+        // back and thieves take from the front. reused every run, so it
+        // doesn't allocate once it's big enough
+        std::vector<Chunk> chunks;
+        unsigned int first;
+        sf::Thread * thread;
+    };
+
+    std::vector<Worker *> m_workers;
+    Job m_job;
+    void * m_context;
+    // chunks that haven't finished yet
+    volatile int m_remaining;
+    volatile int m_quit;
+    // bumped by every run that wakes the workers. parked workers wait for
+    // it to change. guarded by m_parking
+    int m_generation;
+    Parking * m_parking;
+
+    int m_chunkCount;
+    volatile int m_stealCount;
+
+private: //methods
+    static void threadMain(void * worker);
+    void workerLoop(Worker * worker);
+    // wait until run is called again or the pool is going away
+    void park(int & generation);
+    // wake every parked worker
+    void unpark();
+    // find a chunk and run it. returns false if there wasn't any work
+    bool runOneChunk(Worker * worker);
+};
+
+#endif
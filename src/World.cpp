@@ -3,6 +3,10 @@
 #include "Utils.h"
 #include "ResourceManager.h"
 
+#include <cmath>
+
+const int World::c_maxCellsPerMap = 16;
+
 World * World::load(const char * buffer)
 {
     World * out = new World();
@@ -16,32 +20,79 @@ World * World::load(const char * buffer)
     }
     int mapCount = Utils::readInt(&cursor);
     for (int i = 0; i < mapCount; i++) {
-        int x = Utils::readInt(&cursor);
-        int y = Utils::readInt(&cursor);
-        int z = Utils::readInt(&cursor);
-        std::string mapId = Utils::readString(&cursor);
-        Map * map = ResourceManager::getMap(mapId);
-        if (map == NULL) {
-            std::cerr << "Cannot load world because loading its maps failed" << std::endl;
+        MapPlacement placement;
+        placement.left = Utils::readInt(&cursor);
+        placement.top = Utils::readInt(&cursor);
+        placement.story = Utils::readInt(&cursor);
+        placement.id = Utils::readString(&cursor);
+        // only peek at the size; the map itself gets loaded on demand
+        int sizeX, sizeY;
+        if (! ResourceManager::readMapSize(placement.id, sizeX, sizeY)) {
+            std::cerr << "Cannot load world because reading its maps failed" << std::endl;
             delete out;
             return NULL;
         }
-        map->setPosition(x, y, z);
-        out->m_maps.push_back(map);
+        placement.width = sizeX * Tile::size;
+        placement.height = sizeY * Tile::size;
+        out->m_placements.push_back(placement);
     }
 
+    out->buildIndex();
     return out;
 }
 
 World::World() :
-    m_maps()
+    m_placements(),
+    m_mapGeneration(0),
+    m_gridLeft(0.0), m_gridTop(0.0),
+    m_cellSize(1.0),
+    m_gridSizeX(0), m_gridSizeY(0),
+    m_cells()
 {
-    m_maps.clear();
 }
 
 World::~World()
 {
+    for (unsigned int i = 0; i < m_placements.size(); i++)
+        unloadMap(i);
+}
+
+bool World::loadMap(int index)
+{
+    if (m_placements[index].map != NULL)
+        return true;
+    return placeMap(index, ResourceManager::getMap(m_placements[index].id));
+}
+
+bool World::loadMap(int index, const char * buffer)
+{
+    if (m_placements[index].map != NULL)
+        return true;
+    return placeMap(index, ResourceManager::loadMap(buffer));
+}
+
+bool World::placeMap(int index, Map * map)
+{
+    MapPlacement * placement = &m_placements[index];
+    if (map == NULL) {
+        std::cerr << "Unable to load map " << placement->id << std::endl;
+        return false;
+    }
+    map->setPosition(placement->left, placement->top, placement->story);
+    placement->map = map;
+    placement->generation++;
+    m_mapGeneration++;
+    return true;
+}
 
+void World::unloadMap(int index)
+{
+    if (m_placements[index].map == NULL)
+        return;
+    delete m_placements[index].map;
+    m_placements[index].map = NULL;
+    m_placements[index].generation++;
+    m_mapGeneration++;
 }
 
 Universe::Location World::locationOf(double absoluteX, double absoluteY) {
@@ -54,16 +105,12 @@ Universe::Location World::locationOf(double absoluteX, double absoluteY) {
     loc.z = -1; // don't know
 
     // find the map
-    for (unsigned int i = 0; i < m_maps.size(); i++) {
-        Map * map = m_maps[i];
-        if (absoluteX >= map->left() && absoluteX < map->left() + map->width() &&
-            absoluteY >= map->top() && absoluteY < map->top() + map->height())
-        {
-            loc.map = map;
-            loc.mapX = map->left();
-            loc.mapY = map->top();
-            return loc;
-        }
+    Map * map = mapAt(absoluteX, absoluteY);
+    if (map != NULL) {
+        loc.map = map;
+        loc.mapX = map->left();
+        loc.mapY = map->top();
+        return loc;
     }
 
     // can't find a map
@@ -72,3 +119,178 @@ Universe::Location World::locationOf(double absoluteX, double absoluteY) {
     loc.map = NULL;
     return loc;
 }
+
+Map * World::mapAt(double absoluteX, double absoluteY)
+{
+    int index = placementAt(absoluteX, absoluteY);
+    if (index == -1)
+        return NULL;
+    return m_placements[index].map;
+}
+
+void World::mapsIntersecting(std::vector<Map*> & maps, double left, double top, double width, double height)
+{
+    int cellLeft, cellTop, cellRight, cellBottom;
+    if (! cellRange(left, top, width, height, cellLeft, cellTop, cellRight, cellBottom))
+        return;
+
+    double right = left + width, bottom = top + height;
+    unsigned int firstResult = maps.size();
+    for (int cellY = cellTop; cellY < cellBottom; cellY++) {
+        for (int cellX = cellLeft; cellX < cellRight; cellX++) {
+            std::vector<int> & cell = m_cells[cellX + cellY * m_gridSizeX];
+            for (unsigned int i = 0; i < cell.size(); i++) {
+                Map * map = m_placements[cell[i]].map;
+                if (map == NULL || ! intersects(cell[i], left, top, right, bottom))
+                    continue;
+                // maps that span several cells show up more than once.
+                // results are tiny, so a linear search beats a set.
+                bool duplicate = false;
+                for (unsigned int j = firstResult; j < maps.size(); j++) {
+                    if (maps[j] == map) {
+                        duplicate = true;
+                        break;
+                    }
+                }
+                if (! duplicate)
+                    maps.push_back(map);
+            }
+        }
+    }
+}
+
+int World::placementAt(double absoluteX, double absoluteY)
+{
+    int cellLeft, cellTop, cellRight, cellBottom;
+    if (! cellRange(absoluteX, absoluteY, 0.0, 0.0, cellLeft, cellTop, cellRight, cellBottom))
+        return -1;
+
+    std::vector<int> & cell = m_cells[cellLeft + cellTop * m_gridSizeX];
+    for (unsigned int i = 0; i < cell.size(); i++) {
+        MapPlacement * placement = &m_placements[cell[i]];
+        if (absoluteX >= placement->left && absoluteX < placement->left + placement->width &&
+            absoluteY >= placement->top && absoluteY < placement->top + placement->height)
+        {
+            return cell[i];
+        }
+    }
+    return -1;
+}
+
+void World::placementsIntersecting(std::vector<int> & placements, double left, double top, double width, double height)
+{
+    int cellLeft, cellTop, cellRight, cellBottom;
+    if (! cellRange(left, top, width, height, cellLeft, cellTop, cellRight, cellBottom))
+        return;
+
+    double right = left + width, bottom = top + height;
+    unsigned int firstResult = placements.size();
+    for (int cellY = cellTop; cellY < cellBottom; cellY++) {
+        for (int cellX = cellLeft; cellX < cellRight; cellX++) {
+            std::vector<int> & cell = m_cells[cellX + cellY * m_gridSizeX];
+            for (unsigned int i = 0; i < cell.size(); i++) {
+                if (! intersects(cell[i], left, top, right, bottom))
+                    continue;
+                bool duplicate = false;
+                for (unsigned int j = firstResult; j < placements.size(); j++) {
+                    if (placements[j] == cell[i]) {
+                        duplicate = true;
+                        break;
+                    }
+                }
+                if (! duplicate)
+                    placements.push_back(cell[i]);
+            }
+        }
+    }
+}
+
+bool World::raycast(std::vector<Map*> & maps, Ray & ray)
+{
+    maps.clear();
+    mapsIntersecting(maps, Utils::min(ray.fromX, ray.toX), Utils::min(ray.fromY, ray.toY),
+                     std::fabs(ray.toX - ray.fromX), std::fabs(ray.toY - ray.fromY));
+    // every map gets a look, but only hits closer than the closest so far
+    // count
+    ray.hit = false;
+    for (unsigned int i = 0; i < maps.size(); i++) {
+        if (maps[i]->raycast(ray.fromX, ray.fromY, ray.toX, ray.toY, ray.layer, ray.minPresence,
+                             ray.result, ray.hit ? ray.result.t : 1.0))
+        {
+            ray.hit = true;
+        }
+    }
+    return ray.hit;
+}
+
+bool World::intersects(int index, double left, double top, double right, double bottom)
+{
+    MapPlacement * placement = &m_placements[index];
+    return ! (placement->left > right || placement->left + placement->width < left ||
+              placement->top > bottom || placement->top + placement->height < top);
+}
+
+void World::buildIndex()
+{
+    m_cells.clear();
+    m_gridSizeX = 0;
+    m_gridSizeY = 0;
+    if (m_placements.size() == 0)
+        return;
+
+    // bounds of the whole world, and the average map size
+    double left = m_placements[0].left, top = m_placements[0].top;
+    double right = left, bottom = top;
+    double totalSize = 0.0;
+    for (unsigned int i = 0; i < m_placements.size(); i++) {
+        MapPlacement * placement = &m_placements[i];
+        left = Utils::min(left, placement->left);
+        top = Utils::min(top, placement->top);
+        right = Utils::max(right, placement->left + placement->width);
+        bottom = Utils::max(bottom, placement->top + placement->height);
+        totalSize += Utils::max(placement->width, placement->height);
+    }
+
+    // a cell about the size of a map means a query touches only a few maps.
+    // grow the cells if the maps are spread out so the grid stays small.
+    m_cellSize = Utils::max(totalSize / m_placements.size(), (double)Tile::size);
+    int maxCells = c_maxCellsPerMap * m_placements.size();
+    while (std::ceil((right - left) / m_cellSize) * std::ceil((bottom - top) / m_cellSize) > maxCells)
+        m_cellSize *= 2.0;
+
+    m_gridLeft = left;
+    m_gridTop = top;
+    m_gridSizeX = Utils::max(1, (int)std::ceil((right - left) / m_cellSize));
+    m_gridSizeY = Utils::max(1, (int)std::ceil((bottom - top) / m_cellSize));
+    m_cells.resize(m_gridSizeX * m_gridSizeY);
+
+    for (unsigned int i = 0; i < m_placements.size(); i++) {
+        MapPlacement * placement = &m_placements[i];
+        int cellLeft, cellTop, cellRight, cellBottom;
+        if (! cellRange(placement->left, placement->top, placement->width, placement->height, cellLeft, cellTop, cellRight, cellBottom))
+            continue;
+        for (int cellY = cellTop; cellY < cellBottom; cellY++)
+            for (int cellX = cellLeft; cellX < cellRight; cellX++)
+                m_cells[cellX + cellY * m_gridSizeX].push_back(i);
+    }
+}
+
+bool World::cellRange(double left, double top, double width, double height,
+                      int & cellLeft, int & cellTop, int & cellRight, int & cellBottom)
+{
+    if (m_cells.size() == 0)
+        return false;
+
+    double localLeft = (left - m_gridLeft) / m_cellSize;
+    double localTop = (top - m_gridTop) / m_cellSize;
+    double localRight = (left + width - m_gridLeft) / m_cellSize;
+    double localBottom = (top + height - m_gridTop) / m_cellSize;
+    if (localRight < 0.0 || localBottom < 0.0 || localLeft >= m_gridSizeX || localTop >= m_gridSizeY)
+        return false;
+
+    cellLeft = Utils::max((int)std::floor(localLeft), 0);
+    cellTop = Utils::max((int)std::floor(localTop), 0);
+    cellRight = Utils::min((int)std::floor(localRight) + 1, m_gridSizeX);
+    cellBottom = Utils::min((int)std::floor(localBottom) + 1, m_gridSizeY);
+    return true;
+}
@@ -3,13 +3,41 @@
 
 #include <vector>
 #include <set>
+#include <string>
 #include "Map.h"
 #include "Universe.h"
 
 class World
 {
 public:
+    // where a map goes in the world. the bounds are known up front, but the
+    // map itself is only in memory while it is resident.
+    class MapPlacement {
+    public:
+        std::string id;
+        double left, top;
+        double width, height;
+        int story;
+        Map * map; // NULL unless the map is resident
+        // goes up every time the map is loaded or unloaded
+        int generation;
+        MapPlacement() : id(), left(0), top(0), width(0), height(0), story(0), map(NULL), generation(0) {}
+    };
+
+    // a segment for raycast to follow. fill in the first part and raycast
+    // fills in the rest
+    typedef struct {
+        double fromX, fromY, toX, toY;
+        int layer;
+        // what stops it. see Tile::hasMinPresence
+        Tile::PhysicalPresence minPresence;
+        bool hit;
+        // where it stopped, if it hit something
+        Map::RayHit result;
+    } Ray;
+
     // load a world from memory. returns NULL on error
+    // maps are not loaded; see loadMap.
     static World * load(const char * buffer);
     // create an empty world
     World();
@@ -18,9 +46,58 @@ public:
     // return the Location at specified coordinates
     Universe::Location locationOf(double absoluteX, double absoluteY);
 
-    std::vector<Map*> * maps() { return &m_maps; }
-private:
-    std::vector<Map*> m_maps;
+    // return the resident map containing the point, or NULL if there isn't one
+    Map * mapAt(double absoluteX, double absoluteY);
+    // append every resident map whose bounds intersect the rectangle. each
+    // map is appended at most once.
+    void mapsIntersecting(std::vector<Map*> & maps, double left, double top, double width, double height);
+
+    // same as above, but for all placements whether they're resident or not.
+    // returns -1 / appends placement indexes.
+    int placementAt(double absoluteX, double absoluteY);
+    void placementsIntersecting(std::vector<int> & placements, double left, double top, double width, double height);
+
+    // follow the ray across the resident maps. maps is scratch space, so
+    // that rays can be cast on several threads at once. returns ray.hit
+    bool raycast(std::vector<Map*> & maps, Ray & ray);
+
+    int mapCount() { return m_placements.size(); }
+    // goes up every time any map is loaded or unloaded
+    int mapGeneration() { return m_mapGeneration; }
+    MapPlacement * placement(int index) { return &m_placements[index]; }
+
+    // make a map resident, reading it from the resource file. returns success
+    bool loadMap(int index);
+    // make a map resident from a buffer returned by ResourceManager::readMapBuffer
+    bool loadMap(int index, const char * buffer);
+    // delete a resident map
+    void unloadMap(int index);
+
+private: //variables
+    // don't let the grid get much bigger than the number of maps
+    static const int c_maxCellsPerMap;
+
+    std::vector<MapPlacement> m_placements;
+    int m_mapGeneration;
+
+    // uniform grid over the bounds of all the maps. each cell holds the
+    // indexes of the placements that overlap it.
+    double m_gridLeft, m_gridTop;
+    double m_cellSize;
+    int m_gridSizeX, m_gridSizeY;
+    std::vector<std::vector<int> > m_cells;
+
+private: //methods
+    // rebuild the grid. call after the maps move.
+    void buildIndex();
+    // convert a rectangle into a range of cell indexes, clamped to the grid.
+    // returns false if the rectangle is completely outside the grid.
+    bool cellRange(double left, double top, double width, double height,
+                   int & cellLeft, int & cellTop, int & cellRight, int & cellBottom);
+    // whether a placement overlaps a rectangle (touching counts)
+    bool intersects(int index, double left, double top, double right, double bottom);
+    // put a freshly loaded map into place
+    bool placeMap(int index, Map * map);
 };
 
 #endif
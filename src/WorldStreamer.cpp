@@ -0,0 +1,279 @@
+#include "WorldStreamer.h"
+
+#include "World.h"
+#include "Map.h"
+#include "ResourceManager.h"
+#include "Profiler.h"
+#include "Utils.h"
+#include "Debug.h"
+
+#include <algorithm>
+
+const double WorldStreamer::c_lookaheadFrames = 60.0;
+const double WorldStreamer::c_unloadFactor = 1.5;
+const int WorldStreamer::c_maxParsesPerFrame = 2;
+
+WorldStreamer::WorldStreamer(World * world, double radius, bool synchronous) :
+    m_world(world),
+    m_radius(radius),
+    m_synchronous(synchronous),
+    m_states(world->mapCount(), msUnloaded),
+    m_residentIndexes(),
+    m_residentMaps(),
+    m_nearby(),
+    m_wanted(),
+    m_byDistance(),
+    m_stallCount(0),
+    m_loadCount(0),
+    m_unloadCount(0),
+    m_parking(),
+    m_requests(),
+    m_finished(),
+    m_quit(false),
+    m_thread(&WorldStreamer::threadMain, this)
+{
+    // maps that were loaded before we got here are already resident
+    for (int i = 0; i < m_world->mapCount(); i++) {
+        if (m_world->placement(i)->map != NULL) {
+            m_states[i] = msResident;
+            m_residentIndexes.push_back(i);
+        }
+    }
+    updateResidentMaps();
+
+    if (! m_synchronous)
+        m_thread.Launch();
+}
+
+WorldStreamer::~WorldStreamer()
+{
+    {
+        Parking::Lock lock(m_parking);
+        m_quit = true;
+        m_parking.wakeAll(1);
+    }
+    if (! m_synchronous)
+        m_thread.Wait();
+
+    for (unsigned int i = 0; i < m_finished.size(); i++)
+        delete[] m_finished[i].buffer;
+}
+
+void WorldStreamer::threadMain(void * streamer)
+{
+    ((WorldStreamer *)streamer)->backgroundLoop();
+}
+
+void WorldStreamer::backgroundLoop()
+{
+    while (true) {
+        Request request;
+        {
+            // sleep until update asks for something
+            Parking::Lock lock(m_parking);
+            while (! m_quit && m_requests.size() == 0)
+                m_parking.wait();
+            if (m_quit)
+                return;
+            request = m_requests.front();
+            m_requests.pop_front();
+        }
+
+        Finished finished;
+        finished.index = request.index;
+        finished.buffer = ResourceManager::readMapBuffer(request.id);
+        if (finished.buffer != NULL) {
+            // get the graphics off the disk too, so parsing doesn't block
+            std::vector<std::string> graphicIds;
+            Map::paletteGraphicIds(finished.buffer + sizeof(char), graphicIds);
+            for (unsigned int i = 0; i < graphicIds.size(); i++)
+                ResourceManager::prefetchGraphic(graphicIds[i]);
+        }
+
+        Parking::Lock lock(m_parking);
+        m_finished.push_back(finished);
+    }
+}
+
+void WorldStreamer::loadAround(double x, double y)
+{
+    findWanted(x, y, x, y);
+    for (unsigned int i = 0; i < m_wanted.size(); i++)
+        loadNow(m_wanted[i]);
+    updateResidentMaps();
+}
+
+void WorldStreamer::update(double focusX, double focusY, double velocityX, double velocityY,
+                           double requiredLeft, double requiredTop, double requiredWidth, double requiredHeight)
+{
+    PROFILE_ZONE("WorldStreamer::update");
+    double aheadX = focusX + velocityX * c_lookaheadFrames;
+    double aheadY = focusY + velocityY * c_lookaheadFrames;
+
+    // request what we'll need soon, closest to where the camera is going first
+    findWanted(focusX, focusY, aheadX, aheadY);
+    if (m_synchronous) {
+        for (unsigned int i = 0; i < m_wanted.size(); i++)
+            loadNow(m_wanted[i]);
+    } else {
+        Parking::Lock lock(m_parking);
+        for (unsigned int i = 0; i < m_wanted.size(); i++) {
+            int index = m_wanted[i];
+            if (m_states[index] != msUnloaded)
+                continue;
+            Request request;
+            request.index = index;
+            request.id = m_world->placement(index)->id;
+            m_requests.push_back(request);
+            m_states[index] = msRequested;
+        }
+        if (m_requests.size() > 0)
+            m_parking.wakeAll(1);
+    }
+
+    parseFinished(c_maxParsesPerFrame);
+
+    // what's on screen can't wait
+    m_nearby.clear();
+    m_world->placementsIntersecting(m_nearby, requiredLeft, requiredTop, requiredWidth, requiredHeight);
+    bool parsedEverything = false;
+    for (unsigned int i = 0; i < m_nearby.size(); i++) {
+        int index = m_nearby[i];
+        if (m_states[index] == msResident)
+            continue;
+        m_stallCount++;
+        // it might be sitting in the finished list already
+        if (! parsedEverything) {
+            parseFinished(-1);
+            parsedEverything = true;
+        }
+        loadNow(index);
+    }
+
+    // drop what's far behind
+    double unloadDistance = m_radius * c_unloadFactor;
+    for (unsigned int i = 0; i < m_residentIndexes.size(); ) {
+        int index = m_residentIndexes[i];
+        if (distanceTo(index, focusX, focusY) > unloadDistance && distanceTo(index, aheadX, aheadY) > unloadDistance)
+            unload(index); // removes it from m_residentIndexes
+        else
+            i++;
+    }
+
+    updateResidentMaps();
+}
+
+int WorldStreamer::pendingCount()
+{
+    Parking::Lock lock(m_parking);
+    return m_requests.size() + m_finished.size();
+}
+
+double WorldStreamer::distanceTo(int index, double x, double y)
+{
+    World::MapPlacement * placement = m_world->placement(index);
+    double nearestX = Utils::max(placement->left, Utils::min(x, placement->left + placement->width));
+    double nearestY = Utils::max(placement->top, Utils::min(y, placement->top + placement->height));
+    return Utils::distance(x, y, nearestX, nearestY);
+}
+
+void WorldStreamer::findWanted(double x1, double y1, double x2, double y2)
+{
+    m_nearby.clear();
+    m_world->placementsIntersecting(m_nearby, x1 - m_radius, y1 - m_radius, m_radius * 2.0, m_radius * 2.0);
+    m_world->placementsIntersecting(m_nearby, x2 - m_radius, y2 - m_radius, m_radius * 2.0, m_radius * 2.0);
+
+    // sort by how close they are to the second point, dropping duplicates
+    // and the corners of the boxes that are outside the radius
+    std::vector<std::pair<double, int> > & byDistance = m_byDistance;
+    byDistance.clear();
+    for (unsigned int i = 0; i < m_nearby.size(); i++) {
+        int index = m_nearby[i];
+        if (distanceTo(index, x1, y1) > m_radius && distanceTo(index, x2, y2) > m_radius)
+            continue;
+        byDistance.push_back(std::pair<double, int>(distanceTo(index, x2, y2), index));
+    }
+    std::sort(byDistance.begin(), byDistance.end());
+
+    m_wanted.clear();
+    for (unsigned int i = 0; i < byDistance.size(); i++) {
+        if (i > 0 && byDistance[i].second == byDistance[i - 1].second)
+            continue;
+        m_wanted.push_back(byDistance[i].second);
+    }
+}
+
+void WorldStreamer::parseFinished(int maxCount)
+{
+    std::vector<Finished> finished;
+    {
+        Parking::Lock lock(m_parking);
+        int count = maxCount < 0 ? m_finished.size() : Utils::min(maxCount, (int)m_finished.size());
+        finished.assign(m_finished.begin(), m_finished.begin() + count);
+        m_finished.erase(m_finished.begin(), m_finished.begin() + count);
+    }
+
+    for (unsigned int i = 0; i < finished.size(); i++) {
+        int index = finished[i].index;
+        char * buffer = finished[i].buffer;
+        if (m_states[index] == msRequested) {
+            if (buffer != NULL && m_world->loadMap(index, buffer)) {
+                makeResident(index);
+            } else {
+                // try again next time it's needed
+                m_states[index] = msUnloaded;
+            }
+        }
+        delete[] buffer;
+    }
+}
+
+bool WorldStreamer::loadNow(int index)
+{
+    if (m_states[index] == msResident)
+        return true;
+    if (! m_world->loadMap(index))
+        return false;
+    // if it was requested, the buffer that comes back will be thrown away
+    makeResident(index);
+    return true;
+}
+
+void WorldStreamer::makeResident(int index)
+{
+    m_states[index] = msResident;
+    m_residentIndexes.push_back(index);
+    m_loadCount++;
+}
+
+void WorldStreamer::unload(int index)
+{
+    Map * map = m_world->placement(index)->map;
+
+    // entities that wandered onto another resident map go with that map
+    std::vector<Entity*> * entities = map->entities();
+    unsigned int keptCount = 0;
+    for (unsigned int i = 0; i < entities->size(); i++) {
+        Entity * entity = (*entities)[i];
+        Map * newHome = m_world->mapAt(entity->centerX(), entity->centerY());
+        if (newHome != NULL && newHome != map)
+            newHome->entities()->push_back(entity);
+        else
+            (*entities)[keptCount++] = entity;
+    }
+    entities->resize(keptCount);
+
+    m_world->unloadMap(index);
+    m_states[index] = msUnloaded;
+    m_residentIndexes.erase(std::find(m_residentIndexes.begin(), m_residentIndexes.end(), index));
+    m_unloadCount++;
+}
+
+void WorldStreamer::updateResidentMaps()
+{
+    // keep them in world order so a run doesn't depend on load timing
+    std::sort(m_residentIndexes.begin(), m_residentIndexes.end());
+    m_residentMaps.clear();
+    for (unsigned int i = 0; i < m_residentIndexes.size(); i++)
+        m_residentMaps.push_back(m_world->placement(m_residentIndexes[i])->map);
+}
@@ -0,0 +1,124 @@
+#ifndef _WORLD_STREAMER_H_
+#define _WORLD_STREAMER_H_
+
+#include "Parking.h"
+
+#include <SFML/System.hpp>
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <utility>
+
+class World;
+class Map;
+
+// WorldStreamer keeps the maps of a World that are near the player resident
+// and unloads the ones that are far away.
+// Map resources (and the graphics in their palettes) are read from disk on a
+// background thread ahead of the camera. The main thread only parses them,
+// a couple per frame, so walking around never waits on the disk unless the
+// player outruns the loader. When that happens it's counted as a stall.
+// In synchronous mode there is no background thread: every wanted map is
+// loaded in update, so what's resident only depends on where the player is
+// and how the camera moves. Recordings and headless runs need that to come
+// out the same every time.
+class WorldStreamer
+{
+public:
+    // maps closer than radius to the player are kept resident
+    WorldStreamer(World * world, double radius, bool synchronous = false);
+    ~WorldStreamer();
+
+    // synchronously load every map within the radius of a point. use this
+    // when entering a world.
+    void loadAround(double x, double y);
+
+    // call once per frame.
+    // focus is the player, velocity is how fast the camera is moving. maps
+    // ahead of the camera are requested first. maps touching the required
+    // rectangle (usually the screen) must be resident after this call, so
+    // they are loaded synchronously if they aren't ready.
+    void update(double focusX, double focusY, double velocityX, double velocityY,
+                double requiredLeft, double requiredTop, double requiredWidth, double requiredHeight);
+
+    // the maps that are in memory right now
+    std::vector<Map*> * residentMaps() { return &m_residentMaps; }
+
+    // metrics
+    int residentCount() { return m_residentMaps.size(); }
+    int pendingCount();
+    // how many times a map had to be loaded synchronously in update
+    int stallCount() { return m_stallCount; }
+    int loadCount() { return m_loadCount; }
+    int unloadCount() { return m_unloadCount; }
+
+private: //variables
+    // how many frames of camera movement to look ahead
+    static const double c_lookaheadFrames;
+    // maps get unloaded when they are this many radiuses away, so that
+    // walking back and forth across the edge doesn't thrash
+    static const double c_unloadFactor;
+    // how many loaded buffers get parsed per frame
+    static const int c_maxParsesPerFrame;
+
+    enum MapState {
+        msUnloaded,
+        msRequested, // waiting on the background thread
+        msResident,
+    };
+
+    typedef struct {
+        int index;
+        std::string id;
+    } Request;
+
+    typedef struct {
+        int index;
+        char * buffer; // NULL if the read failed
+    } Finished;
+
+    World * m_world;
+    double m_radius;
+    bool m_synchronous;
+
+    // only touched by the main thread
+    std::vector<MapState> m_states;
+    std::vector<int> m_residentIndexes;
+    std::vector<Map*> m_residentMaps;
+    std::vector<int> m_nearby;
+    std::vector<int> m_wanted;
+    // findWanted's scratch space, kept so it doesn't reallocate every frame
+    std::vector<std::pair<double, int> > m_byDistance;
+    int m_stallCount;
+    int m_loadCount;
+    int m_unloadCount;
+
+    // shared with the background thread. protected by m_parking, which the
+    // background thread also sleeps on while there's nothing to read
+    Parking m_parking;
+    std::deque<Request> m_requests;
+    std::vector<Finished> m_finished;
+    bool m_quit;
+
+    sf::Thread m_thread;
+
+private: //methods
+    static void threadMain(void * streamer);
+    void backgroundLoop();
+
+    // distance from a point to the bounds of a placement
+    double distanceTo(int index, double x, double y);
+    // find the maps that are within the radius of either point
+    void findWanted(double x1, double y1, double x2, double y2);
+    // parse up to maxCount finished buffers
+    void parseFinished(int maxCount);
+    // make a map resident right now. returns success
+    bool loadNow(int index);
+    void makeResident(int index);
+    void unload(int index);
+    // rebuild m_residentMaps from m_residentIndexes
+    void updateResidentMaps();
+};
+
+#endif
@@ -0,0 +1,923 @@
+// motrs-bench times the hot paths of the game one at a time and prints the
+// results as JSON, so they can be kept per commit and compared.
+//
+// usage: motrs-bench [--resources=resources.dat] [--time=200] [--samples=5]
+//                    [--filter=Physics] [--out=bench.json]
+//        motrs-bench --check
+//
+// every benchmark is run for about --time milliseconds, --samples times. the
+// results are nanoseconds per operation, the fastest sample and the median.
+// --filter only runs benchmarks with that in their name. the JSON goes to
+// --out, or to stdout without it.
+// --check doesn't time anything. it runs the batched Physics functions on
+// random and edge case inputs, compares them with the single versions, and
+// exits with 1 if any result is off.
+
+#include "Physics.h"
+#include "Tile.h"
+#include "Map.h"
+#include "Array3.h"
+#include "Utils.h"
+#include "ResourceFile.h"
+#include "ResourceManager.h"
+#include "Universe.h"
+#include "World.h"
+#include "Graphic.h"
+#include "FrameArena.h"
+#include "EntityIndex.h"
+#include "Config.h"
+#include "ConfigManager.h"
+
+#include <SFML/System.hpp>
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+using namespace std;
+
+// runs the operation being timed iterations times
+typedef void (*BenchmarkFunction)(void * context, int iterations);
+
+typedef struct {
+    string name;
+    BenchmarkFunction function;
+    void * context;
+} Benchmark;
+
+typedef struct {
+    string name;
+    long long iterations;
+    double fastest; // ns per operation
+    double median;
+} Result;
+
+// inputs are picked from arrays this long, so the timing isn't of one
+// lucky case
+static const int c_inputCount = 1024;
+
+// results are added up here so the compiler can't throw the work away
+static volatile double s_sink = 0.0;
+
+Result run(Benchmark & benchmark, float sampleTime, int samples);
+void writeJson(ostream & out, const vector<Result> & results);
+double randomDouble(double low, double high);
+
+// Physics
+typedef struct {
+    double x1[c_inputCount], y1[c_inputCount], size1[c_inputCount];
+    double x2[c_inputCount], y2[c_inputCount], size2[c_inputCount];
+    double dx[c_inputCount], dy[c_inputCount];
+} PhysicsInputs;
+void fillPhysicsInputs(PhysicsInputs & inputs);
+void benchCircleAndCircle(void * context, int iterations);
+void benchSquareAndCircle(void * context, int iterations);
+void benchSquareAndSquare(void * context, int iterations);
+void benchPointAndCircle(void * context, int iterations);
+void benchCircleAndCircleBatch(void * context, int iterations);
+void benchSquareAndCircleBatch(void * context, int iterations);
+void benchPointAndCircleBatch(void * context, int iterations);
+// returns the number of results that differ from the single versions
+int checkBatchKernels();
+
+// Tile
+typedef struct {
+    Tile * tile;
+    PhysicsInputs * inputs;
+} TileContext;
+void benchResolveCircleCollision(void * context, int iterations);
+
+// Map
+typedef struct {
+    Map * map;
+    FrameArena * arena;
+    PhysicsInputs * inputs;
+} MapContext;
+Map * makeMap(int size, const string & graphicId);
+void benchIntersectingTiles(void * context, int iterations);
+void benchMapRaycast(void * context, int iterations);
+
+// Array3
+void benchArray3Get(void * context, int iterations);
+void benchArray3Set(void * context, int iterations);
+void benchArray3Redim(void * context, int iterations);
+void benchArray3ExpandLeft(void * context, int iterations);
+void benchArray3ExpandTop(void * context, int iterations);
+void benchArray3ExpandRight(void * context, int iterations);
+void benchArray3ExpandBottom(void * context, int iterations);
+
+// EntityIndex, and the loops over every entity that it replaces
+typedef struct {
+    EntityIndex * index;
+    int count;
+    vector<double> x, y, radius;
+    // where the queries are
+    vector<double> queryX, queryY;
+    vector<int> results;
+    vector<pair<double, int> > distances;
+} EntityIndexContext;
+void makeEntityIndexContext(EntityIndexContext & context, int count);
+void benchIndexInRadius(void * context, int iterations);
+void benchBruteInRadius(void * context, int iterations);
+void benchIndexInRectangle(void * context, int iterations);
+void benchBruteInRectangle(void * context, int iterations);
+void benchIndexNearest(void * context, int iterations);
+void benchBruteNearest(void * context, int iterations);
+void benchIndexMove(void * context, int iterations);
+
+// Utils
+void benchReadInt(void * context, int iterations);
+void benchReadString(void * context, int iterations);
+
+// ResourceFile
+typedef struct {
+    ResourceFile * file;
+    vector<string> names;
+} ResourceContext;
+void benchResourceSize(void * context, int iterations);
+void benchResourcePrefix(void * context, int iterations);
+
+int main(int argc, char * argv[])
+{
+    Config::initialize(argc, argv, "config.ini");
+    ConfigManager args;
+    args.addArgs(argc, argv);
+
+    string resourceFile = args.value("resources", "resources.dat");
+    float sampleTime = Utils::stringToInt(args.value("time", "200")) / 1000.0f;
+    int samples = Utils::max(1, Utils::stringToInt(args.value("samples", "5")));
+    string filter = args.value("filter");
+    string outFile = args.value("out");
+
+    // same numbers every run
+    srand(1);
+    if (args.value("check") == "true")
+        return checkBatchKernels() == 0 ? 0 : 1;
+    // the maps need graphics for their tiles, but not their pixels
+    Graphic::setDecodeImages(false);
+    Universe * universe = ResourceManager::loadUniverse(resourceFile, "main.universe");
+    if (universe == NULL)
+        return 1;
+    // borrow a graphic from a real map for the made up ones
+    World * world = universe->startWorld();
+    string graphicId;
+    vector<string> resourceNames;
+    resourceNames.push_back("main.universe");
+    for (int i = 0; i < world->mapCount(); i++) {
+        string mapId = world->placement(i)->id;
+        resourceNames.push_back(mapId);
+        if (graphicId.size() > 0)
+            continue;
+        char * buffer = ResourceManager::readMapBuffer(mapId);
+        if (buffer == NULL)
+            continue;
+        vector<string> ids;
+        Map::paletteGraphicIds(buffer + sizeof(char), ids);
+        delete[] buffer;
+        if (ids.size() > 0)
+            graphicId = ids[0];
+    }
+    if (graphicId.size() == 0) {
+        cerr << "No tile graphics in " << resourceFile << endl;
+        return 1;
+    }
+    resourceNames.push_back(graphicId);
+
+    vector<Benchmark> benchmarks;
+    Benchmark benchmark;
+
+    PhysicsInputs * physicsInputs = new PhysicsInputs();
+    fillPhysicsInputs(*physicsInputs);
+    const char * physicsNames[] = {
+        "Physics::circleAndCircle", "Physics::squareAndCircle", "Physics::squareAndSquare",
+        "Physics::pointAndCircle", "Physics::circleAndCircle batch", "Physics::squareAndCircle batch",
+        "Physics::pointAndCircle batch",
+    };
+    BenchmarkFunction physicsFunctions[] = {
+        benchCircleAndCircle, benchSquareAndCircle, benchSquareAndSquare,
+        benchPointAndCircle, benchCircleAndCircleBatch, benchSquareAndCircleBatch,
+        benchPointAndCircleBatch,
+    };
+    for (unsigned int i = 0; i < sizeof(physicsFunctions) / sizeof(physicsFunctions[0]); i++) {
+        benchmark.name = physicsNames[i];
+        benchmark.function = physicsFunctions[i];
+        benchmark.context = physicsInputs;
+        benchmarks.push_back(benchmark);
+    }
+
+    // every shape that resolveCircleCollision handles
+    const char * shapeNames[] = {
+        "SolidWall", "SolidFloor", "SolidHole", "DiagFloorWallNW", "DiagFloorWallNE",
+        "DiagFloorWallSE", "DiagFloorWallSW", "FloorRailN", "FloorRailE", "FloorRailS", "FloorRailW",
+    };
+    vector<TileContext> tileContexts(Tile::tsCount);
+    for (int shape = 0; shape < Tile::tsCount; shape++) {
+        if (shape == Tile::tsSolidHole || shape == Tile::tsFloorRailN || shape == Tile::tsFloorRailS)
+            continue; // not done yet
+        tileContexts[shape].tile = new Tile();
+        tileContexts[shape].tile->setShape((Tile::Shape)shape);
+        tileContexts[shape].inputs = physicsInputs;
+        benchmark.name = string("Tile::resolveCircleCollision ") + shapeNames[shape];
+        benchmark.function = benchResolveCircleCollision;
+        benchmark.context = &tileContexts[shape];
+        benchmarks.push_back(benchmark);
+    }
+
+    const int mapSizes[] = { 16, 64, 256 };
+    const int mapSizeCount = sizeof(mapSizes) / sizeof(mapSizes[0]);
+    vector<MapContext> mapContexts(mapSizeCount);
+    FrameArena arena;
+    for (int i = 0; i < mapSizeCount; i++) {
+        mapContexts[i].map = makeMap(mapSizes[i], graphicId);
+        if (mapContexts[i].map == NULL)
+            return 1;
+        mapContexts[i].arena = &arena;
+        mapContexts[i].inputs = new PhysicsInputs();
+        // circles anywhere on the map, and rays from them to somewhere
+        // within a couple hundred pixels
+        double mapSize = mapSizes[i] * Tile::size;
+        for (int j = 0; j < c_inputCount; j++) {
+            mapContexts[i].inputs->x2[j] = randomDouble(0.0, mapSize);
+            mapContexts[i].inputs->y2[j] = randomDouble(0.0, mapSize);
+            mapContexts[i].inputs->size2[j] = randomDouble(4.0, 24.0);
+            mapContexts[i].inputs->x1[j] = mapContexts[i].inputs->x2[j] + randomDouble(-200.0, 200.0);
+            mapContexts[i].inputs->y1[j] = mapContexts[i].inputs->y2[j] + randomDouble(-200.0, 200.0);
+        }
+        string size = Utils::intToString(mapSizes[i]) + "x" + Utils::intToString(mapSizes[i]);
+        benchmark.name = "Map::intersectingTiles " + size;
+        benchmark.function = benchIntersectingTiles;
+        benchmark.context = &mapContexts[i];
+        benchmarks.push_back(benchmark);
+        benchmark.name = "Map::raycast " + size;
+        benchmark.function = benchMapRaycast;
+        benchmarks.push_back(benchmark);
+    }
+
+    // the same number of entities per screen, in bigger and bigger areas
+    const int entityCounts[] = { 100, 1000, 10000 };
+    const int entityCountCount = sizeof(entityCounts) / sizeof(entityCounts[0]);
+    vector<EntityIndexContext> indexContexts(entityCountCount);
+    const char * indexNames[] = {
+        "EntityIndex::inRadius", "brute force inRadius", "EntityIndex::inRectangle",
+        "brute force inRectangle", "EntityIndex::nearest 8", "brute force nearest 8",
+        "EntityIndex::move",
+    };
+    BenchmarkFunction indexFunctions[] = {
+        benchIndexInRadius, benchBruteInRadius, benchIndexInRectangle,
+        benchBruteInRectangle, benchIndexNearest, benchBruteNearest,
+        benchIndexMove,
+    };
+    for (int i = 0; i < entityCountCount; i++) {
+        makeEntityIndexContext(indexContexts[i], entityCounts[i]);
+        for (unsigned int j = 0; j < sizeof(indexFunctions) / sizeof(indexFunctions[0]); j++) {
+            benchmark.name = string(indexNames[j]) + " " + Utils::intToString(entityCounts[i]);
+            benchmark.function = indexFunctions[j];
+            benchmark.context = &indexContexts[i];
+            benchmarks.push_back(benchmark);
+        }
+    }
+
+    const char * array3Names[] = {
+        "Array3::get", "Array3::set", "Array3::redim 64x64x4", "Array3::expandLeft 64x64x4",
+        "Array3::expandTop 64x64x4", "Array3::expandRight 64x64x4", "Array3::expandBottom 64x64x4",
+    };
+    BenchmarkFunction array3Functions[] = {
+        benchArray3Get, benchArray3Set, benchArray3Redim, benchArray3ExpandLeft,
+        benchArray3ExpandTop, benchArray3ExpandRight, benchArray3ExpandBottom,
+    };
+    for (unsigned int i = 0; i < sizeof(array3Functions) / sizeof(array3Functions[0]); i++) {
+        benchmark.name = array3Names[i];
+        benchmark.function = array3Functions[i];
+        benchmark.context = NULL;
+        benchmarks.push_back(benchmark);
+    }
+
+    benchmark.name = "Utils::readInt";
+    benchmark.function = benchReadInt;
+    benchmark.context = NULL;
+    benchmarks.push_back(benchmark);
+    benchmark.name = "Utils::readString";
+    benchmark.function = benchReadString;
+    benchmarks.push_back(benchmark);
+
+    ResourceContext resources;
+    resources.file = new ResourceFile(resourceFile);
+    resources.names = resourceNames;
+    benchmark.name = "ResourceFile::resourceSize";
+    benchmark.function = benchResourceSize;
+    benchmark.context = &resources;
+    benchmarks.push_back(benchmark);
+    benchmark.name = "ResourceFile::getResourcePrefix";
+    benchmark.function = benchResourcePrefix;
+    benchmarks.push_back(benchmark);
+
+    vector<Result> results;
+    for (unsigned int i = 0; i < benchmarks.size(); i++) {
+        if (filter.size() > 0 && benchmarks[i].name.find(filter) == string::npos)
+            continue;
+        cerr << benchmarks[i].name << "... ";
+        Result result = run(benchmarks[i], sampleTime, samples);
+        cerr << result.fastest << " ns" << endl;
+        results.push_back(result);
+    }
+
+    bool good = true;
+    if (outFile.size() > 0) {
+        ofstream out(outFile.c_str());
+        writeJson(out, results);
+        good = out.good();
+        if (! good)
+            cerr << "Unable to write " << outFile << endl;
+    } else {
+        writeJson(cout, results);
+    }
+
+    delete resources.file;
+    for (int i = 0; i < mapSizeCount; i++) {
+        delete mapContexts[i].map;
+        delete mapContexts[i].inputs;
+    }
+    for (int i = 0; i < entityCountCount; i++)
+        delete indexContexts[i].index;
+    for (unsigned int i = 0; i < tileContexts.size(); i++)
+        delete tileContexts[i].tile;
+    delete physicsInputs;
+    delete universe;
+    ResourceManager::close();
+    return good ? 0 : 1;
+}
+
+Result run(Benchmark & benchmark, float sampleTime, int samples)
+{
+    // find how many iterations take about sampleTime
+    sf::Clock clock;
+    int iterations = 1;
+    while (true) {
+        clock.Reset();
+        benchmark.function(benchmark.context, iterations);
+        float time = clock.GetElapsedTime();
+        if (time >= sampleTime || iterations >= (1 << 28))
+            break;
+        // aim a bit past it, but don't trust tiny times too much
+        float scale = time > 0.0f ? sampleTime / time * 1.2f : 10.0f;
+        iterations = (int)(iterations * Utils::min(Utils::max(scale, 2.0f), 10.0f));
+    }
+
+    vector<double> times;
+    for (int i = 0; i < samples; i++) {
+        clock.Reset();
+        benchmark.function(benchmark.context, iterations);
+        times.push_back(clock.GetElapsedTime() * 1e9 / iterations);
+    }
+    sort(times.begin(), times.end());
+
+    Result result;
+    result.name = benchmark.name;
+    result.iterations = iterations;
+    result.fastest = times[0];
+    result.median = times[times.size() / 2];
+    return result;
+}
+
+void writeJson(ostream & out, const vector<Result> & results)
+{
+    out << "{\n  \"unit\": \"ns/op\",\n  \"benchmarks\": [\n";
+    for (unsigned int i = 0; i < results.size(); i++) {
+        // names are made up above, so they don't need escaping
+        out << "    {\"name\": \"" << results[i].name << "\", "
+            << "\"iterations\": " << results[i].iterations << ", "
+            << "\"fastest\": " << results[i].fastest << ", "
+            << "\"median\": " << results[i].median << "}"
+            << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+double randomDouble(double low, double high)
+{
+    return low + (high - low) * rand() / RAND_MAX;
+}
+
+void fillPhysicsInputs(PhysicsInputs & inputs)
+{
+    // a tile sized object 1, and object 2 somewhere around it, overlapping
+    // it most of the time
+    for (int i = 0; i < c_inputCount; i++) {
+        inputs.x1[i] = Tile::size * 0.5;
+        inputs.y1[i] = Tile::size * 0.5;
+        inputs.size1[i] = Tile::size * 0.5;
+        inputs.size2[i] = randomDouble(4.0, 24.0);
+        inputs.x2[i] = randomDouble(-inputs.size2[i], Tile::size + inputs.size2[i]);
+        inputs.y2[i] = randomDouble(-inputs.size2[i], Tile::size + inputs.size2[i]);
+    }
+}
+
+void benchCircleAndCircle(void * context, int iterations)
+{
+    PhysicsInputs * in = (PhysicsInputs *)context;
+    double sum = 0.0;
+    for (int i = 0; i < iterations; i++) {
+        int j = i % c_inputCount;
+        double dx, dy;
+        Physics::circleAndCircle(in->x1[j], in->y1[j], in->size1[j], in->x2[j], in->y2[j], in->size2[j], dx, dy);
+        sum += dx + dy;
+    }
+    s_sink += sum;
+}
+
+void benchSquareAndCircle(void * context, int iterations)
+{
+    PhysicsInputs * in = (PhysicsInputs *)context;
+    double sum = 0.0;
+    for (int i = 0; i < iterations; i++) {
+        int j = i % c_inputCount;
+        double dx, dy;
+        Physics::squareAndCircle(in->x1[j], in->y1[j], in->size1[j], in->x2[j], in->y2[j], in->size2[j], dx, dy);
+        sum += dx + dy;
+    }
+    s_sink += sum;
+}
+
+void benchSquareAndSquare(void * context, int iterations)
+{
+    PhysicsInputs * in = (PhysicsInputs *)context;
+    double sum = 0.0;
+    for (int i = 0; i < iterations; i++) {
+        int j = i % c_inputCount;
+        double dx, dy;
+        Physics::squareAndSquare(in->x1[j], in->y1[j], in->size1[j], in->x2[j], in->y2[j], in->size2[j], dx, dy);
+        sum += dx + dy;
+    }
+    s_sink += sum;
+}
+
+void benchPointAndCircle(void * context, int iterations)
+{
+    PhysicsInputs * in = (PhysicsInputs *)context;
+    double sum = 0.0;
+    for (int i = 0; i < iterations; i++) {
+        int j = i % c_inputCount;
+        double dx, dy;
+        Physics::pointAndCircle(in->x1[j], in->y1[j], in->x2[j], in->y2[j], in->size2[j], dx, dy);
+        sum += dx + dy;
+    }
+    s_sink += sum;
+}
+
+// the batch versions count each pair as one operation, so they compare
+// directly with the single ones
+void benchCircleAndCircleBatch(void * context, int iterations)
+{
+    PhysicsInputs * in = (PhysicsInputs *)context;
+    for (int done = 0; done < iterations; done += c_inputCount) {
+        int count = Utils::min(c_inputCount, iterations - done);
+        Physics::circleAndCircle(in->x1, in->y1, in->size1, in->x2, in->y2, in->size2, in->dx, in->dy, count);
+        s_sink += in->dx[0];
+    }
+}
+
+void benchSquareAndCircleBatch(void * context, int iterations)
+{
+    PhysicsInputs * in = (PhysicsInputs *)context;
+    for (int done = 0; done < iterations; done += c_inputCount) {
+        int count = Utils::min(c_inputCount, iterations - done);
+        Physics::squareAndCircle(in->x1, in->y1, in->size1, in->x2, in->y2, in->size2, in->dx, in->dy, count);
+        s_sink += in->dx[0];
+    }
+}
+
+void benchPointAndCircleBatch(void * context, int iterations)
+{
+    PhysicsInputs * in = (PhysicsInputs *)context;
+    for (int done = 0; done < iterations; done += c_inputCount) {
+        int count = Utils::min(c_inputCount, iterations - done);
+        Physics::pointAndCircle(in->x1, in->y1, in->x2, in->y2, in->size2, in->dx, in->dy, count);
+        s_sink += in->dx[0];
+    }
+}
+
+// the same value, with 0 and -0 counting as the same, or both NaN. the
+// single and batched versions do the same operations in the same order, so
+// anything else is a bug
+static bool sameResult(double value1, double value2)
+{
+    if (value1 != value1 && value2 != value2)
+        return true;
+    return memcmp(&value1, &value2, sizeof(double)) == 0 || (value1 == 0.0 && value2 == 0.0);
+}
+
+int checkBatchKernels()
+{
+    PhysicsInputs * in = new PhysicsInputs();
+    fillPhysicsInputs(*in);
+    // the first few land exactly on the edges and corners of object 1, on
+    // its center, and exactly touching
+    double edges[] = { 0.0, Tile::size * 0.5, Tile::size };
+    int next = 0;
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            in->x2[next] = edges[i];
+            in->y2[next] = edges[j];
+            next++;
+        }
+    }
+    in->x2[next] = in->x1[next] + in->size1[next] + in->size2[next];
+    in->y2[next] = in->y1[next];
+    next++;
+    in->x2[next] = in->x1[next];
+    in->y2[next] = in->y1[next] - in->size1[next] - in->size2[next];
+    next++;
+
+    const char * names[] = {
+        "Physics::circleAndCircle batch", "Physics::squareAndCircle batch", "Physics::pointAndCircle batch",
+    };
+    int totalMismatches = 0;
+    for (int kernel = 0; kernel < 3; kernel++) {
+        int mismatches = 0;
+        // an odd count, so the leftovers after the vector lanes get done
+        // one at a time too
+        int count = c_inputCount - 1;
+        if (kernel == 0)
+            Physics::circleAndCircle(in->x1, in->y1, in->size1, in->x2, in->y2, in->size2, in->dx, in->dy, count);
+        else if (kernel == 1)
+            Physics::squareAndCircle(in->x1, in->y1, in->size1, in->x2, in->y2, in->size2, in->dx, in->dy, count);
+        else
+            Physics::pointAndCircle(in->x1, in->y1, in->x2, in->y2, in->size2, in->dx, in->dy, count);
+        for (int i = 0; i < count; i++) {
+            double dx, dy;
+            if (kernel == 0)
+                Physics::circleAndCircle(in->x1[i], in->y1[i], in->size1[i], in->x2[i], in->y2[i], in->size2[i], dx, dy);
+            else if (kernel == 1)
+                Physics::squareAndCircle(in->x1[i], in->y1[i], in->size1[i], in->x2[i], in->y2[i], in->size2[i], dx, dy);
+            else
+                Physics::pointAndCircle(in->x1[i], in->y1[i], in->x2[i], in->y2[i], in->size2[i], dx, dy);
+            if (! sameResult(dx, in->dx[i]) || ! sameResult(dy, in->dy[i])) {
+                if (mismatches < 5) {
+                    cerr << names[kernel] << " input " << i << ": " << in->dx[i] << ", " << in->dy[i]
+                         << " instead of " << dx << ", " << dy << endl;
+                }
+                mismatches++;
+            }
+        }
+        cerr << names[kernel] << ": " << (mismatches == 0 ? "ok" : Utils::intToString(mismatches) + " wrong")
+             << endl;
+        totalMismatches += mismatches;
+    }
+    delete in;
+    return totalMismatches;
+}
+
+void benchResolveCircleCollision(void * context, int iterations)
+{
+    TileContext * tileContext = (TileContext *)context;
+    PhysicsInputs * in = tileContext->inputs;
+    double sum = 0.0;
+    for (int i = 0; i < iterations; i++) {
+        int j = i % c_inputCount;
+        double x = in->x2[j], y = in->y2[j];
+        tileContext->tile->resolveCircleCollision(0.0, 0.0, x, y, in->size2[j]);
+        sum += x + y;
+    }
+    s_sink += sum;
+}
+
+Map * makeMap(int size, const string & graphicId)
+{
+    // a version 4 .map: one tile of every shape in the palette, and one
+    // full layer of random tiles
+    ostringstream buffer;
+    const int version = 4;
+    buffer.write((const char *)&version, sizeof(int));
+    buffer.write((const char *)&size, sizeof(int));
+    buffer.write((const char *)&size, sizeof(int));
+    const int tileCount = Tile::tsCount;
+    buffer.write((const char *)&tileCount, sizeof(int));
+    for (int shape = 0; shape < tileCount; shape++) {
+        const int surfaceType = Tile::stNormal;
+        const int idSize = graphicId.size();
+        buffer.write((const char *)&shape, sizeof(int));
+        buffer.write((const char *)&surfaceType, sizeof(int));
+        buffer.write((const char *)&idSize, sizeof(int));
+        buffer.write(graphicId.c_str(), idSize);
+    }
+    const int layerCount = 1;
+    const int layerType = Map::ltFull;
+    buffer.write((const char *)&layerCount, sizeof(int));
+    buffer.write((const char *)&layerType, sizeof(int));
+    for (int i = 0; i < size * size; i++) {
+        // palette index 0 is the null tile
+        int tile = rand() % (tileCount + 1);
+        buffer.write((const char *)&tile, sizeof(int));
+    }
+    const int none = 0;
+    buffer.write((const char *)&none, sizeof(int)); // submaps
+    buffer.write((const char *)&none, sizeof(int)); // triggers
+    buffer.write((const char *)&none, sizeof(int)); // entities
+
+    string data = buffer.str();
+    Map * map = Map::load(data.c_str());
+    if (map == NULL)
+        cerr << "Unable to make a " << size << "x" << size << " map" << endl;
+    return map;
+}
+
+void benchIntersectingTiles(void * context, int iterations)
+{
+    MapContext * mapContext = (MapContext *)context;
+    PhysicsInputs * in = mapContext->inputs;
+    long long found = 0;
+    for (int i = 0; i < iterations; i++) {
+        int j = i % c_inputCount;
+        // what the game does for every entity every frame
+        mapContext->arena->reset();
+        Map::TileList tiles(ArenaAllocator<Map::TileAndLocation>(mapContext->arena));
+        mapContext->map->intersectingTiles(tiles, in->x2[j], in->y2[j], in->size2[j], 0, Tile::ppRail);
+        found += tiles.size();
+    }
+    s_sink += found;
+}
+
+void benchMapRaycast(void * context, int iterations)
+{
+    MapContext * mapContext = (MapContext *)context;
+    PhysicsInputs * in = mapContext->inputs;
+    double sum = 0.0;
+    for (int i = 0; i < iterations; i++) {
+        int j = i % c_inputCount;
+        // line of sight for something that can see over rails
+        Map::RayHit hit;
+        if (mapContext->map->raycast(in->x2[j], in->y2[j], in->x1[j], in->y1[j], 0, Tile::ppEmbrasure, hit))
+            sum += hit.t;
+        else
+            sum += 1.0;
+    }
+    s_sink += sum;
+}
+
+void benchArray3Get(void * context, int iterations)
+{
+    Array3<int> array(64, 64, 4);
+    array.clear();
+    long long sum = 0;
+    int x = 0, y = 0, z = 0;
+    for (int i = 0; i < iterations; i++) {
+        sum += array.get(x, y, z);
+        // walk it the way maps are walked, by rows
+        if (++x == 64) {
+            x = 0;
+            if (++y == 64) {
+                y = 0;
+                z = (z + 1) % 4;
+            }
+        }
+    }
+    s_sink += sum;
+}
+
+void benchArray3Set(void * context, int iterations)
+{
+    Array3<int> array(64, 64, 4);
+    array.clear();
+    int x = 0, y = 0, z = 0;
+    for (int i = 0; i < iterations; i++) {
+        array.set(x, y, z, i);
+        if (++x == 64) {
+            x = 0;
+            if (++y == 64) {
+                y = 0;
+                z = (z + 1) % 4;
+            }
+        }
+    }
+    s_sink += array.get(0, 0, 0);
+}
+
+// these go back and forth between two sizes, so every operation does the
+// same amount of work
+void benchArray3Redim(void * context, int iterations)
+{
+    Array3<int> array(64, 64, 4);
+    for (int i = 0; i < iterations; i++) {
+        int size = i % 2 == 0 ? 65 : 64;
+        array.redim(size, size, 4, 0);
+    }
+    s_sink += array.sizeX();
+}
+
+void benchArray3ExpandLeft(void * context, int iterations)
+{
+    Array3<int> array(64, 64, 4);
+    for (int i = 0; i < iterations; i++)
+        array.expandLeft(i % 2 == 0 ? 1 : -1, 0);
+    s_sink += array.sizeX();
+}
+
+void benchArray3ExpandTop(void * context, int iterations)
+{
+    Array3<int> array(64, 64, 4);
+    for (int i = 0; i < iterations; i++)
+        array.expandTop(i % 2 == 0 ? 1 : -1, 0);
+    s_sink += array.sizeY();
+}
+
+void benchArray3ExpandRight(void * context, int iterations)
+{
+    Array3<int> array(64, 64, 4);
+    for (int i = 0; i < iterations; i++)
+        array.expandRight(i % 2 == 0 ? 1 : -1, 0);
+    s_sink += array.sizeX();
+}
+
+void benchArray3ExpandBottom(void * context, int iterations)
+{
+    Array3<int> array(64, 64, 4);
+    for (int i = 0; i < iterations; i++)
+        array.expandBottom(i % 2 == 0 ? 1 : -1, 0);
+    s_sink += array.sizeY();
+}
+
+void makeEntityIndexContext(EntityIndexContext & context, int count)
+{
+    // about 50 pixels square each, which is crowded but not packed
+    double side = sqrt((double)count) * 50.0;
+    context.index = new EntityIndex();
+    context.count = count;
+    for (int i = 0; i < count; i++) {
+        context.x.push_back(randomDouble(0.0, side));
+        context.y.push_back(randomDouble(0.0, side));
+        context.radius.push_back(randomDouble(4.0, 16.0));
+        context.index->insert(i, context.x[i], context.y[i], context.radius[i], 0);
+    }
+    for (int i = 0; i < c_inputCount; i++) {
+        context.queryX.push_back(randomDouble(0.0, side));
+        context.queryY.push_back(randomDouble(0.0, side));
+    }
+    context.results.reserve(count);
+    context.distances.reserve(count);
+}
+
+// a sword's reach, and a screen's worth of tiles
+static const double c_queryRadius = 48.0;
+static const double c_queryWidth = 256.0;
+static const int c_nearestCount = 8;
+
+void benchIndexInRadius(void * context, int iterations)
+{
+    EntityIndexContext * in = (EntityIndexContext *)context;
+    long long sum = 0;
+    for (int i = 0; i < iterations; i++) {
+        in->results.clear();
+        in->index->inRadius(in->results, in->queryX[i % c_inputCount], in->queryY[i % c_inputCount], c_queryRadius, 0);
+        sum += in->results.size();
+    }
+    s_sink += sum;
+}
+
+void benchBruteInRadius(void * context, int iterations)
+{
+    EntityIndexContext * in = (EntityIndexContext *)context;
+    long long sum = 0;
+    for (int i = 0; i < iterations; i++) {
+        double x = in->queryX[i % c_inputCount], y = in->queryY[i % c_inputCount];
+        in->results.clear();
+        for (int j = 0; j < in->count; j++) {
+            double reach = c_queryRadius + in->radius[j];
+            if (Utils::distance2(x, y, in->x[j], in->y[j]) < reach * reach)
+                in->results.push_back(j);
+        }
+        sum += in->results.size();
+    }
+    s_sink += sum;
+}
+
+void benchIndexInRectangle(void * context, int iterations)
+{
+    EntityIndexContext * in = (EntityIndexContext *)context;
+    long long sum = 0;
+    for (int i = 0; i < iterations; i++) {
+        in->results.clear();
+        in->index->inRectangle(in->results, in->queryX[i % c_inputCount], in->queryY[i % c_inputCount],
+                               c_queryWidth, c_queryWidth, 0);
+        sum += in->results.size();
+    }
+    s_sink += sum;
+}
+
+void benchBruteInRectangle(void * context, int iterations)
+{
+    EntityIndexContext * in = (EntityIndexContext *)context;
+    long long sum = 0;
+    for (int i = 0; i < iterations; i++) {
+        double left = in->queryX[i % c_inputCount], top = in->queryY[i % c_inputCount];
+        in->results.clear();
+        for (int j = 0; j < in->count; j++) {
+            double radius = in->radius[j];
+            if (in->x[j] - radius < left + c_queryWidth && in->x[j] + radius > left &&
+                in->y[j] - radius < top + c_queryWidth && in->y[j] + radius > top)
+            {
+                in->results.push_back(j);
+            }
+        }
+        sum += in->results.size();
+    }
+    s_sink += sum;
+}
+
+void benchIndexNearest(void * context, int iterations)
+{
+    EntityIndexContext * in = (EntityIndexContext *)context;
+    long long sum = 0;
+    for (int i = 0; i < iterations; i++) {
+        in->results.clear();
+        in->index->nearest(in->results, in->queryX[i % c_inputCount], in->queryY[i % c_inputCount], c_nearestCount, 0);
+        sum += in->results[0];
+    }
+    s_sink += sum;
+}
+
+void benchBruteNearest(void * context, int iterations)
+{
+    EntityIndexContext * in = (EntityIndexContext *)context;
+    long long sum = 0;
+    for (int i = 0; i < iterations; i++) {
+        double x = in->queryX[i % c_inputCount], y = in->queryY[i % c_inputCount];
+        in->distances.clear();
+        for (int j = 0; j < in->count; j++)
+            in->distances.push_back(make_pair(Utils::distance2(x, y, in->x[j], in->y[j]), j));
+        int count = Utils::min(c_nearestCount, in->count);
+        partial_sort(in->distances.begin(), in->distances.begin() + count, in->distances.end());
+        sum += in->distances[0].second;
+    }
+    s_sink += sum;
+}
+
+void benchIndexMove(void * context, int iterations)
+{
+    // a step the size of a running one, back and forth so nobody wanders off
+    EntityIndexContext * in = (EntityIndexContext *)context;
+    for (int i = 0; i < iterations; i++) {
+        int entity = i % in->count;
+        double step = (i / in->count) % 2 == 0 ? 3.0 : -3.0;
+        in->x[entity] += step;
+        in->index->move(entity, in->x[entity], in->y[entity], in->radius[entity], 0);
+    }
+}
+
+void benchReadInt(void * context, int iterations)
+{
+    static int values[c_inputCount];
+    long long sum = 0;
+    for (int done = 0; done < iterations; done += c_inputCount) {
+        const char * cursor = (const char *)values;
+        int count = Utils::min(c_inputCount, iterations - done);
+        for (int i = 0; i < count; i++)
+            sum += Utils::readInt(&cursor);
+    }
+    s_sink += sum;
+}
+
+void benchReadString(void * context, int iterations)
+{
+    // a typical resource id, over and over
+    static vector<char> buffer;
+    const char * id = "graphics/tiles/grass.graphic";
+    const int idSize = strlen(id);
+    if (buffer.size() == 0) {
+        for (int i = 0; i < c_inputCount; i++) {
+            buffer.insert(buffer.end(), (const char *)&idSize, (const char *)&idSize + sizeof(int));
+            buffer.insert(buffer.end(), id, id + idSize);
+        }
+    }
+    long long sum = 0;
+    for (int done = 0; done < iterations; done += c_inputCount) {
+        const char * cursor = &buffer[0];
+        int count = Utils::min(c_inputCount, iterations - done);
+        for (int i = 0; i < count; i++)
+            sum += Utils::readString(&cursor).size();
+    }
+    s_sink += sum;
+}
+
+void benchResourceSize(void * context, int iterations)
+{
+    ResourceContext * resources = (ResourceContext *)context;
+    long long sum = 0;
+    for (int i = 0; i < iterations; i++)
+        sum += resources->file->resourceSize(resources->names[i % resources->names.size()]);
+    s_sink += sum;
+}
+
+void benchResourcePrefix(void * context, int iterations)
+{
+    ResourceContext * resources = (ResourceContext *)context;
+    char buffer[64];
+    long long sum = 0;
+    for (int i = 0; i < iterations; i++)
+        sum += resources->file->getResourcePrefix(resources->names[i % resources->names.size()], buffer, sizeof(buffer));
+    s_sink += sum;
+}
@@ -0,0 +1,239 @@
+// motrs-headless runs the game loop without a window, as fast as it can or
+// at a fixed rate, and prints how many ticks per second it gets.
+//
+// usage: motrs-headless [--resources=resources.dat] [--frames=3600]
+//                       [--rate=0] [--fps=60] [--script=input.txt]
+//                       [--record=input.rec] [--replay=input.rec]
+//                       [--draw[=software]] [--snapshot=frame.png]
+//                       [--profile-out=trace.json]
+//
+// --frames=0 runs forever. --rate=0 runs as fast as possible.
+// --replay plays back input recorded with --record (in the game or here)
+// and runs for as long as the recording unless --frames says otherwise.
+// the state hash printed at the end matches the recording run's when the
+// simulation is deterministic.
+// --draw records what would be drawn every tick and reports how many quads
+// and texture batches it comes to, without a display. --draw=software draws
+// it too, into memory, and reports quads and pixels per second of drawing.
+// --snapshot draws in software and saves the last frame as a .png, to compare
+// against a known good one.
+// --profile-out=trace.json writes where the time went, for chrome://tracing.
+// the script is one "<frame> <keys>" per line, where keys are the ones held
+// down from that frame on: any of n e s w (directions), j (jump),
+// a (attack), or - for none. without a script the player walks in circles.
+// any config.ini setting can be overridden too, e.g. --simulation.threads=0
+
+#include "Gameplay.h"
+#include "Graphic.h"
+#include "Input.h"
+#include "Config.h"
+#include "ConfigManager.h"
+#include "WorldStreamer.h"
+#include "InputRecording.h"
+#include "Profiler.h"
+#include "RenderCommandBuffer.h"
+#include "NullRenderBackend.h"
+#include "SoftwareRenderBackend.h"
+#include "Utils.h"
+
+#include <SFML/System.hpp>
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <cstdlib>
+using namespace std;
+
+typedef struct {
+    long long frame;
+    string keys;
+} ScriptLine;
+
+bool loadScript(string filename, vector<ScriptLine> & script);
+// fills in the script and returns how many frames long it is
+long long defaultScript(vector<ScriptLine> & script);
+void applyKeys(Input * input, const string & keys);
+
+int main(int argc, char * argv[])
+{
+    Config::initialize(argc, argv, "config.ini");
+    ConfigManager args;
+    args.addArgs(argc, argv);
+
+    string resourceFile = args.value("resources", "resources.dat");
+    int rate = Utils::stringToInt(args.value("rate", "0"));
+    int fps = Utils::stringToInt(args.value("fps", "60"));
+    string drawMode = args.value("draw", Utils::boolToString(false));
+    string snapshotFile = args.value("snapshot");
+    bool software = drawMode == "software" || snapshotFile.size() > 0;
+    bool draw = software || Utils::stringToBool(drawMode);
+
+    vector<ScriptLine> script;
+    // the default script repeats; a script from a file doesn't
+    long long loopLength = 0;
+    string scriptFile = args.value("script");
+    if (scriptFile.size() > 0) {
+        if (! loadScript(scriptFile, script))
+            return 1;
+    } else {
+        loopLength = defaultScript(script);
+    }
+
+    // nobody is going to look at them, unless they're drawn in software
+    Graphic::setDecodeImages(software);
+
+    Gameplay * gameplay = new Gameplay(resourceFile, fps);
+    if (! gameplay->isGood()) {
+        cerr << "Gameplay did not initialize properly." << endl;
+        delete gameplay;
+        return 1;
+    }
+    string defaultFrames = "3600";
+    if (gameplay->replay() != NULL)
+        defaultFrames = Utils::intToString(gameplay->replay()->frameCount());
+    long long frames = Utils::stringToInt(args.value("frames", defaultFrames));
+
+    RenderCommandBuffer commands;
+    NullRenderBackend * nullBackend = NULL;
+    SoftwareRenderBackend * softwareBackend = NULL;
+    RenderBackend * backend = NULL;
+    if (software) {
+        softwareBackend = new SoftwareRenderBackend((int)gameplay->screenWidth(), (int)gameplay->screenHeight());
+        backend = softwareBackend;
+    } else if (draw) {
+        nullBackend = new NullRenderBackend((int)gameplay->screenWidth(), (int)gameplay->screenHeight());
+        backend = nullBackend;
+    }
+    sf::Clock drawClock;
+    float drawTime = 0.0f;
+    long long quadsDrawn = 0;
+    long long pixelsDrawn = 0;
+
+    Profiler::nameThread("main");
+    sf::Clock clock;
+    float reportTime = 1.0f;
+    long long reportFrame = 0;
+    float goalTime = 0.0f;
+    unsigned int scriptIndex = 0;
+    for (long long frame = 0; frames == 0 || frame < frames; frame++) {
+        long long scriptFrame = loopLength > 0 ? frame % loopLength : frame;
+        if (scriptFrame == 0)
+            scriptIndex = 0;
+        while (scriptIndex < script.size() && script[scriptIndex].frame <= scriptFrame) {
+            applyKeys(gameplay->input(), script[scriptIndex].keys);
+            scriptIndex++;
+        }
+
+        gameplay->nextFrame();
+        if (draw) {
+            gameplay->recordFrame(&commands);
+            drawClock.Reset();
+            PROFILE_ZONE("RenderBackend::render");
+            backend->render(&commands, 1.0);
+            drawTime += drawClock.GetElapsedTime();
+            quadsDrawn += backend->quadCount();
+            if (software)
+                pixelsDrawn += softwareBackend->pixelCount();
+        }
+
+        if (rate > 0) {
+            goalTime += 1.0f / rate;
+            float wait = goalTime - clock.GetElapsedTime();
+            if (wait > 0.0f)
+                sf::Sleep(wait);
+        }
+
+        float now = clock.GetElapsedTime();
+        if (now >= reportTime) {
+            cout << "ticks/s: " << (frame + 1 - reportFrame) / (now - reportTime + 1.0f)
+                 << "  resident maps: " << gameplay->streamer()->residentCount()
+                 << "  contact pairs: " << gameplay->broadphase()->candidateCount()
+                 << "  active: " << gameplay->activeEntityCount()
+                 << "  sleeping: " << gameplay->sleepingEntityCount()
+                 << "  heap allocations last frame: " << gameplay->heapAllocationsLastFrame();
+            if (draw) {
+                cout << "  quads: " << backend->quadCount()
+                     << "  batches: " << backend->batchCount();
+            }
+            if (nullBackend != NULL)
+                cout << "  on screen: " << nullBackend->visibleQuadCount();
+            if (softwareBackend != NULL)
+                cout << "  pixels: " << softwareBackend->pixelCount();
+            cout << endl;
+            reportFrame = frame + 1;
+            reportTime = now + 1.0f;
+        }
+    }
+
+    float elapsed = clock.GetElapsedTime();
+    cout << frames << " ticks in " << elapsed << " s, "
+         << (elapsed > 0.0f ? frames / elapsed : 0.0f) << " ticks/s" << endl;
+    if (software) {
+        cout << "drawing took " << drawTime << " s, "
+             << (drawTime > 0.0f ? quadsDrawn / drawTime : 0.0f) << " quads/s, "
+             << (drawTime > 0.0f ? pixelsDrawn / drawTime : 0.0f) << " pixels/s" << endl;
+    }
+    cout << "state hash: " << hex << gameplay->stateHash() << dec << endl;
+
+    bool good = true;
+    if (snapshotFile.size() > 0)
+        good = softwareBackend->savePng(snapshotFile);
+    string profileFile = Config::instance()->profileOutFile();
+    if (profileFile.size() > 0)
+        good = Profiler::writeTrace(profileFile) && good;
+
+    delete nullBackend;
+    delete softwareBackend;
+    delete gameplay;
+    return good ? 0 : 1;
+}
+
+bool loadScript(string filename, vector<ScriptLine> & script)
+{
+    ifstream in(filename.c_str());
+    if (! in.good()) {
+        cerr << "Unable to open script " << filename << endl;
+        return false;
+    }
+    string line;
+    int lineNumber = 0;
+    while (getline(in, line)) {
+        lineNumber++;
+        if (Utils::trim(line).size() == 0)
+            continue;
+        istringstream words(line);
+        ScriptLine scriptLine;
+        if (! (words >> scriptLine.frame >> scriptLine.keys)) {
+            cerr << "Parse error in script " << filename << " line " << lineNumber << endl;
+            return false;
+        }
+        script.push_back(scriptLine);
+    }
+    return true;
+}
+
+long long defaultScript(vector<ScriptLine> & script)
+{
+    const char * steps[] = { "e", "es", "s", "sw", "wj", "w", "nw", "n", "na", "ne" };
+    const int stepCount = sizeof(steps) / sizeof(steps[0]);
+    const int stepLength = 60;
+    for (int i = 0; i < stepCount; i++) {
+        ScriptLine line;
+        line.frame = i * stepLength;
+        line.keys = steps[i];
+        script.push_back(line);
+    }
+    return stepCount * stepLength;
+}
+
+void applyKeys(Input * input, const string & keys)
+{
+    input->setState(Input::North, keys.find('n') != string::npos);
+    input->setState(Input::East, keys.find('e') != string::npos);
+    input->setState(Input::South, keys.find('s') != string::npos);
+    input->setState(Input::West, keys.find('w') != string::npos);
+    input->setState(Input::Jump, keys.find('j') != string::npos);
+    input->setState(Input::Attack_1, keys.find('a') != string::npos);
+}
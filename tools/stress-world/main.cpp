@@ -0,0 +1,498 @@
+// stress-world writes a resources.dat full of made up content, for seeing how
+// the game copes with worlds far bigger than the real ones.
+//
+// usage: stress-world [--out=stress.dat] [--seed=1] [--worlds=1] [--maps=4]
+//                     [--map-size=256] [--layers=2] [--walls=10]
+//                     [--diagonals=4] [--rails=2] [--entities=1000]
+//                     [--triggers=0] [--graphics=4]
+//
+// every world is a square grid of --maps maps, each --map-size tiles on a
+// side, so --maps=1600 --map-size=250 makes a 10000x10000 tile world.
+// --walls, --diagonals and --rails are the percent of the bottom layer's
+// tiles that get those shapes. the rest are floor. the layers above it are
+// sparse, with a tile from the same mix on a tenth of the spots.
+// --entities is per world, scattered over its maps on the bottom layer, one
+// to a tile.
+// --triggers is per map, rectangles and circles a few tiles across on the
+// bottom layer, anywhere on the map.
+// --graphics is how many different looks each tile shape and entity gets.
+// the same seed always makes the same universe. the player starts in the top
+// left corner of the first world. run it with
+// motrs-headless --resources=stress.dat
+// resources.dat can't hold more than 4 GB.
+
+#include "ResourceFile.h"
+#include "ConfigManager.h"
+#include "Utils.h"
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cmath>
+#include <ctime>
+using namespace std;
+
+// tile shapes, as stored in .map files. see Tile.h
+enum {
+    tsSolidWall = 0,
+    tsSolidFloor = 1,
+    tsDiagFloorWallNW = 3,
+    tsDiagFloorWallNE = 4,
+    tsDiagFloorWallSE = 5,
+    tsDiagFloorWallSW = 6,
+    tsFloorRailE = 8,
+    tsFloorRailW = 10,
+};
+
+// the shapes every graphic variation comes in, in palette order. rails N and
+// S aren't in the game yet
+static const int c_shapes[] = {
+    tsSolidFloor, tsSolidWall,
+    tsDiagFloorWallNW, tsDiagFloorWallNE, tsDiagFloorWallSE, tsDiagFloorWallSW,
+    tsFloorRailE, tsFloorRailW,
+};
+static const char * c_shapeNames[] = {
+    "floor", "wall",
+    "diagonal NW", "diagonal NE", "diagonal SE", "diagonal SW",
+    "rail E", "rail W",
+};
+static const int c_shapeCount = sizeof(c_shapes) / sizeof(c_shapes[0]);
+
+// see Tile.h and Map.h
+static const int c_tileSize = 16;
+static const int c_layerFull = 1;
+static const int c_layerSparse = 2;
+// percent of the spots on the upper layers that have a tile
+static const int c_upperLayerFill = 10;
+// the color that graphics leave out
+static const unsigned char c_colorKey[3] = { 255, 0, 255 };
+
+typedef struct {
+    unsigned char r, g, b;
+} Color;
+
+typedef struct {
+    int walls, diagonals, rails;
+    int graphics;
+} TileMix;
+
+// same numbers on every platform, unlike rand()
+static unsigned long long s_randomState = 0;
+void seedRandom(int seed);
+int randomInt(int count);
+
+// resources are built in memory the same way compile-resources packs them
+void writeInt(string & out, int value);
+void writeDouble(string & out, double value);
+void writeString(string & out, const string & value);
+
+string makeBitmap(int width, int height, const vector<Color> & pixels);
+string makeGraphic(int width, int height, const vector<Color> & pixels);
+string makeTileGraphic(int shape, Color color, bool tall);
+string makeEntityGraphic(Color color, int radius);
+string makeEntity(const string & graphicId, int radius, double speed, double mass);
+string makeMap(int size, int left, int top, int layers, const TileMix & mix, int entityCount,
+               const vector<string> & entityIds, int triggerCount);
+int randomTile(const TileMix & mix);
+Color randomColor();
+string mapId(int world, int map);
+
+int main(int argc, char * argv[])
+{
+    ConfigManager args;
+    args.addArgs(argc, argv);
+
+    string outFile = args.value("out", "stress.dat");
+    int seed = Utils::stringToInt(args.value("seed", "1"));
+    int worldCount = Utils::max(1, Utils::stringToInt(args.value("worlds", "1")));
+    int mapCount = Utils::max(1, Utils::stringToInt(args.value("maps", "4")));
+    int mapSize = Utils::max(2, Utils::stringToInt(args.value("map-size", "256")));
+    int layerCount = Utils::max(1, Utils::stringToInt(args.value("layers", "2")));
+    int entityCount = Utils::max(0, Utils::stringToInt(args.value("entities", "1000")));
+    int triggerCount = Utils::max(0, Utils::stringToInt(args.value("triggers", "0")));
+    TileMix mix;
+    mix.walls = Utils::max(0, Utils::stringToInt(args.value("walls", "10")));
+    mix.diagonals = Utils::max(0, Utils::stringToInt(args.value("diagonals", "4")));
+    mix.rails = Utils::max(0, Utils::stringToInt(args.value("rails", "2")));
+    mix.graphics = Utils::max(1, Utils::stringToInt(args.value("graphics", "4")));
+    if (mix.walls + mix.diagonals + mix.rails > 100) {
+        cerr << "--walls, --diagonals and --rails add up to more than 100 percent" << endl;
+        return 1;
+    }
+
+    ResourceFile dat("");
+    dat.createNew(outFile);
+    if (! dat.isOpen()) {
+        cerr << "Error opening " << outFile << endl;
+        return 1;
+    }
+    // so the record table doesn't grow, and move everything, as maps go in
+    dat.reserve(worldCount * (1 + mapCount) + mix.graphics * (c_shapeCount + 2) + 3);
+
+    clock_t startTime = clock();
+    seedRandom(seed);
+
+    // graphics. walls of every other look are taller than a tile, so some
+    // tiles get depth sorted with the entities
+    for (int variation = 0; variation < mix.graphics; variation++) {
+        Color color = randomColor();
+        for (int i = 0; i < c_shapeCount; i++) {
+            stringstream id;
+            id << c_shapeNames[i] << " " << variation << ".bmp";
+            string graphic = makeTileGraphic(c_shapes[i], color, variation % 2 == 1);
+            dat.addResource(id.str(), graphic.data(), graphic.size());
+        }
+    }
+
+    // entities. they're all circles of different sizes, speeds and masses
+    vector<string> entityIds;
+    for (int variation = 0; variation < mix.graphics; variation++) {
+        stringstream graphicId, id;
+        graphicId << "critter " << variation << ".bmp";
+        id << "critter " << variation << ".entity";
+        int radius = 3 + randomInt(5);
+        string graphic = makeEntityGraphic(randomColor(), radius);
+        dat.addResource(graphicId.str(), graphic.data(), graphic.size());
+        string entity = makeEntity(graphicId.str(), radius, 1.0 + randomInt(30) / 10.0, 1.0 + randomInt(10));
+        dat.addResource(id.str(), entity.data(), entity.size());
+        entityIds.push_back(id.str());
+    }
+    string playerGraphic = makeEntityGraphic(randomColor(), 6);
+    dat.addResource("player.bmp", playerGraphic.data(), playerGraphic.size());
+    string player = makeEntity("player.bmp", 6, 2.5, 5.0);
+    dat.addResource("player.entity", player.data(), player.size());
+
+    // entities get a tile each, since two in the same spot have no direction
+    // to push each other in. leave room to find free ones quickly
+    int mapCapacity = mapSize * mapSize / 2;
+    if (entityCount > mapCount * mapCapacity) {
+        entityCount = mapCount * mapCapacity;
+        cerr << "Only room for " << entityCount << " entities per world" << endl;
+    }
+
+    // worlds, with their maps in a square grid
+    int gridSize = (int)ceil(sqrt((double)mapCount));
+    long long mapBytes = 0;
+    for (int world = 0; world < worldCount; world++) {
+        // deal the entities out to the maps
+        vector<int> mapEntityCounts(mapCount, 0);
+        for (int i = 0; i < entityCount; i++) {
+            int map = randomInt(mapCount);
+            while (mapEntityCounts[map] == mapCapacity)
+                map = (map + 1) % mapCount;
+            mapEntityCounts[map]++;
+        }
+
+        string worldData = "W";
+        writeInt(worldData, 1); // version
+        writeInt(worldData, mapCount);
+        for (int map = 0; map < mapCount; map++) {
+            int left = map % gridSize * mapSize * c_tileSize;
+            int top = map / gridSize * mapSize * c_tileSize;
+            writeInt(worldData, left);
+            writeInt(worldData, top);
+            writeInt(worldData, 0); // story
+            writeString(worldData, mapId(world, map));
+
+            string mapData = makeMap(mapSize, left, top, layerCount, mix, mapEntityCounts[map],
+                                     entityIds, triggerCount);
+            dat.addResource(mapId(world, map), mapData.data(), mapData.size());
+            mapBytes += mapData.size();
+        }
+        stringstream worldId;
+        worldId << "stress " << world << ".world";
+        dat.addResource(worldId.str(), worldData.data(), worldData.size());
+    }
+
+    string universe = "U";
+    writeInt(universe, 2); // version
+    writeInt(universe, worldCount);
+    for (int world = 0; world < worldCount; world++) {
+        stringstream worldId;
+        worldId << "stress " << world << ".world";
+        writeString(universe, worldId.str());
+    }
+    writeString(universe, "player.entity");
+    // world, x, y, layer. makeMap keeps the first tile of every map clear
+    writeInt(universe, 0);
+    writeInt(universe, c_tileSize / 2);
+    writeInt(universe, c_tileSize / 2);
+    writeInt(universe, 0);
+    dat.addResource("main.universe", universe.data(), universe.size());
+
+    int tilesPerSide = gridSize * mapSize;
+    cout << "Wrote " << worldCount << " worlds of " << mapCount << " maps, up to "
+         << tilesPerSide << "x" << tilesPerSide << " tiles and " << entityCount
+         << " entities each, " << mapBytes / (1024 * 1024) << " MB of maps, to "
+         << outFile << " in " << (double)(clock() - startTime) / CLOCKS_PER_SEC << " s" << endl;
+    return 0;
+}
+
+void seedRandom(int seed)
+{
+    s_randomState = (unsigned long long)seed;
+    randomInt(1);
+}
+
+int randomInt(int count)
+{
+    // Knuth's MMIX constants. the top bits are the random ones
+    s_randomState = s_randomState * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (int)((s_randomState >> 33) % (unsigned long long)count);
+}
+
+void writeInt(string & out, int value)
+{
+    out.append((const char *)&value, sizeof(value));
+}
+
+void writeDouble(string & out, double value)
+{
+    out.append((const char *)&value, sizeof(value));
+}
+
+void writeString(string & out, const string & value)
+{
+    writeInt(out, value.size());
+    out.append(value);
+}
+
+string makeBitmap(int width, int height, const vector<Color> & pixels)
+{
+    // 24 bit .bmp, rows bottom to top and padded to 4 bytes
+    int rowSize = (width * 3 + 3) / 4 * 4;
+    int headerSize = 14 + 40;
+    string out = "BM";
+    writeInt(out, headerSize + rowSize * height); // file size
+    writeInt(out, 0); // reserved
+    writeInt(out, headerSize); // where the pixels are
+    writeInt(out, 40); // info header size
+    writeInt(out, width);
+    writeInt(out, height);
+    out.append("\x01\x00\x18\x00", 4); // 1 plane, 24 bits per pixel
+    writeInt(out, 0); // not compressed
+    writeInt(out, rowSize * height);
+    writeInt(out, 2835); // 72 dpi
+    writeInt(out, 2835);
+    writeInt(out, 0); // no palette
+    writeInt(out, 0);
+    for (int y = height - 1; y >= 0; y--) {
+        for (int x = 0; x < width; x++) {
+            const Color & color = pixels[y * width + x];
+            out += (char)color.b;
+            out += (char)color.g;
+            out += (char)color.r;
+        }
+        out.append(rowSize - width * 3, '\0');
+    }
+    return out;
+}
+
+string makeGraphic(int width, int height, const vector<Color> & pixels)
+{
+    // see compile_bitmap in compile-resources
+    string bitmap = makeBitmap(width, height, pixels);
+    string out = "G";
+    writeInt(out, 1); // version
+    writeInt(out, 1); // image
+    writeInt(out, 0); // .bmp
+    out.append((const char *)c_colorKey, 3);
+    writeInt(out, 1); // frame count
+    writeInt(out, 1); // frames per second
+    writeInt(out, width);
+    writeInt(out, height);
+    writeInt(out, bitmap.size());
+    out += bitmap;
+    return out;
+}
+
+string makeTileGraphic(int shape, Color color, bool tall)
+{
+    int height = shape == tsSolidWall && tall ? c_tileSize * 3 / 2 : c_tileSize;
+    Color dark = { (unsigned char)(color.r / 2), (unsigned char)(color.g / 2), (unsigned char)(color.b / 2) };
+    vector<Color> pixels(c_tileSize * height);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < c_tileSize; x++) {
+            // dark where it's solid, with a dark edge so the grid shows
+            int last = c_tileSize - 1;
+            bool solid = false;
+            switch (shape) {
+                case tsSolidWall: solid = true; break;
+                case tsDiagFloorWallNW: solid = x + y < last; break;
+                case tsDiagFloorWallNE: solid = x > y; break;
+                case tsDiagFloorWallSE: solid = x + y > last; break;
+                case tsDiagFloorWallSW: solid = x < y; break;
+                case tsFloorRailE: solid = x >= c_tileSize - 3; break;
+                case tsFloorRailW: solid = x < 3; break;
+            }
+            bool edge = x == last || y == height - 1;
+            pixels[y * c_tileSize + x] = solid || edge ? dark : color;
+        }
+    }
+    return makeGraphic(c_tileSize, height, pixels);
+}
+
+string makeEntityGraphic(Color color, int radius)
+{
+    // a circle the size of the contact circle, on the color key
+    int size = radius * 2;
+    Color clear = { c_colorKey[0], c_colorKey[1], c_colorKey[2] };
+    vector<Color> pixels(size * size, clear);
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            double dx = x + 0.5 - radius, dy = y + 0.5 - radius;
+            if (dx * dx + dy * dy <= radius * radius)
+                pixels[y * size + x] = color;
+        }
+    }
+    return makeGraphic(size, size, pixels);
+}
+
+string makeEntity(const string & graphicId, int radius, double speed, double mass)
+{
+    // see compile_entity in compile-resources
+    string out = "E";
+    writeInt(out, 7); // version
+    writeInt(out, 1); // circle
+    writeInt(out, radius); // center x, y and radius
+    writeInt(out, radius);
+    writeInt(out, radius);
+    writeDouble(out, speed);
+    writeDouble(out, mass);
+    // stand, walk, run and sword, in all 9 directions
+    for (int i = 0; i < 4 * 9; i++)
+        writeString(out, graphicId);
+    return out;
+}
+
+string makeMap(int size, int left, int top, int layers, const TileMix & mix, int entityCount,
+               const vector<string> & entityIds, int triggerCount)
+{
+    // see compile_map in compile-resources
+    string out = "M";
+    writeInt(out, 4); // version
+    writeInt(out, size);
+    writeInt(out, size);
+
+    // palette. entry 0 is the null tile, and isn't in the file
+    writeInt(out, mix.graphics * c_shapeCount);
+    for (int variation = 0; variation < mix.graphics; variation++) {
+        for (int i = 0; i < c_shapeCount; i++) {
+            stringstream id;
+            id << c_shapeNames[i] << " " << variation << ".bmp";
+            writeInt(out, c_shapes[i]);
+            writeInt(out, 0); // surface type
+            writeString(out, id.str());
+        }
+    }
+
+    // the bottom layer is all tiles, and the ones above are mostly empty.
+    // the first tile stays clear for the player to start on
+    vector<int> bottom(size * size);
+    for (int i = 0; i < size * size; i++)
+        bottom[i] = randomTile(mix);
+    bottom[0] = 1;
+
+    // entities stand on floor, so make some where they land. one to a tile,
+    // and not on the player's
+    vector<bool> taken(size * size, false);
+    taken[0] = true;
+    vector<int> entities(entityCount * 3);
+    for (int i = 0; i < entityCount; i++) {
+        int x, y;
+        do {
+            x = randomInt(size);
+            y = randomInt(size);
+        } while (taken[y * size + x]);
+        taken[y * size + x] = true;
+        bottom[y * size + x] = 1 + randomInt(mix.graphics) * c_shapeCount;
+        entities[i * 3] = x;
+        entities[i * 3 + 1] = y;
+        entities[i * 3 + 2] = randomInt(entityIds.size());
+    }
+
+    writeInt(out, layers);
+    writeInt(out, c_layerFull);
+    for (int i = 0; i < size * size; i++)
+        writeInt(out, bottom[i]);
+    for (int z = 1; z < layers; z++) {
+        string sparse;
+        int count = 0;
+        for (int y = 0; y < size; y++) {
+            for (int x = 0; x < size; x++) {
+                if (randomInt(100) >= c_upperLayerFill)
+                    continue;
+                writeInt(sparse, x);
+                writeInt(sparse, y);
+                writeInt(sparse, randomTile(mix));
+                count++;
+            }
+        }
+        writeInt(out, c_layerSparse);
+        writeInt(out, count);
+        out += sparse;
+    }
+
+    writeInt(out, 0); // submaps
+
+    // triggers are relative to the map
+    writeInt(out, triggerCount);
+    for (int i = 0; i < triggerCount; i++) {
+        // no bigger than the map, which can be as small as 2 tiles
+        int width = Utils::min((2 + randomInt(7)) * c_tileSize, size * c_tileSize);
+        int height = Utils::min((2 + randomInt(7)) * c_tileSize, size * c_tileSize);
+        writeInt(out, 1 + randomInt(2)); // rectangle or circle
+        writeInt(out, 0); // layer
+        writeInt(out, randomInt(size * c_tileSize - width + 1));
+        writeInt(out, randomInt(size * c_tileSize - height + 1));
+        writeInt(out, width);
+        writeInt(out, height);
+        stringstream id;
+        id << "trigger " << i;
+        writeString(out, id.str());
+    }
+
+    // entities are in world coordinates
+    writeInt(out, entityCount);
+    for (int i = 0; i < entityCount; i++) {
+        // in the middle of their tile
+        writeInt(out, left + entities[i * 3] * c_tileSize + c_tileSize / 2);
+        writeInt(out, top + entities[i * 3 + 1] * c_tileSize + c_tileSize / 2);
+        writeInt(out, 0); // layer
+        writeString(out, entityIds[entities[i * 3 + 2]]);
+    }
+    return out;
+}
+
+int randomTile(const TileMix & mix)
+{
+    // palette index of a tile from the mix, in one of the looks
+    int shape = 0; // floor
+    int roll = randomInt(100);
+    if (roll < mix.walls)
+        shape = 1;
+    else if (roll < mix.walls + mix.diagonals)
+        shape = 2 + randomInt(4);
+    else if (roll < mix.walls + mix.diagonals + mix.rails)
+        shape = 6 + randomInt(2);
+    return 1 + randomInt(mix.graphics) * c_shapeCount + shape;
+}
+
+Color randomColor()
+{
+    // nowhere near the color key
+    Color color;
+    color.r = 40 + randomInt(176);
+    color.g = 40 + randomInt(176);
+    color.b = 40 + randomInt(176);
+    return color;
+}
+
+string mapId(int world, int map)
+{
+    stringstream id;
+    id << "stress " << world << " " << map << ".map";
+    return id.str();
+}
@@ -74,6 +74,40 @@ EditorMap * EditorMap::load(QString file)
             entity->setCenter(x, y);
             entity->setLayer(layerIndex);
             out->addEntity(entity);
+        } else if( props[i].first.compare("trigger", Qt::CaseInsensitive) == 0 ) {
+            // trigger=left,top,width,height,layerIndex,shape,triggerId
+            QStringList triggerProps = props[i].second.split(",");
+            MapTrigger trigger;
+            trigger.geometry = QRect(triggerProps.at(0).toInt(), triggerProps.at(1).toInt(),
+                triggerProps.at(2).toInt(), triggerProps.at(3).toInt());
+            int layerIndex = triggerProps.at(4).toInt();
+            if (triggerProps.at(5).compare("circle", Qt::CaseInsensitive) == 0) {
+                trigger.shape = Map::tgCircle;
+            } else if (triggerProps.at(5).compare("rectangle", Qt::CaseInsensitive) == 0) {
+                trigger.shape = Map::tgRectangle;
+            } else {
+                qDebug() << "Unknown trigger shape: " << triggerProps.at(5);
+                delete out;
+                return NULL;
+            }
+            trigger.id = triggerProps.at(6);
+            out->addTrigger(layerIndex, trigger);
+        } else if( props[i].first.compare("submap", Qt::CaseInsensitive) == 0 ) {
+            // submap=x,y,localId,resourceId
+            QStringList submapProps = props[i].second.split(",");
+            MapSubmap submap;
+            submap.position = QPoint(submapProps.at(0).toInt(), submapProps.at(1).toInt());
+            submap.id = submapProps.at(2);
+            submap.map = EditorMap::load(QDir(EditorResourceManager::mapsDir()).absoluteFilePath(submapProps.at(3)));
+
+            assert(submap.map);
+            if (submap.map == NULL) {
+                qDebug() << "Unable to load submap for EditorMap";
+                delete out;
+                return NULL;
+            }
+
+            out->addSubmap(submap);
         } else if( props[i].first.compare("object", Qt::CaseInsensitive) == 0 ) {
             // object=tileX,tileY,layerIndex,objectId
             QStringList objectProps = props[i].second.split(",");
@@ -105,6 +139,8 @@ EditorMap * EditorMap::load(QString file)
 
 EditorMap::~EditorMap()
 {
+    for (int i=0; i<m_submaps.size(); ++i)
+        delete m_submaps.at(i).map;
 }
 
 void EditorMap::save()
@@ -143,6 +179,14 @@ void EditorMap::save()
     }
     out << "\n";
 
+    out << "# submap declarations. use map coordinates\n";
+    out << "# submap=x,y,localId,resourceId\n";
+    for (int i=0; i<m_submaps.size(); ++i) {
+        MapSubmap submap = m_submaps.at(i);
+        out << "submap=" << submap.position.x() << "," << submap.position.y() << "," << submap.id << "," << submap.map->name() << "\n";
+    }
+    out << "\n";
+
     out << "# entity declarations. use absolute coordinates\n";
     out << "# entity=x,y,layerIndex,entityId\n";
     for (int layerIndex=0; layerIndex<m_layers.size(); ++layerIndex) {
@@ -152,6 +196,21 @@ void EditorMap::save()
             out << "entity=" << entity->centerX() << "," << entity->centerY() << "," << entity->layer() << "," << entity->name() << "\n";
         }
     }
+    out << "\n";
+
+    out << "# trigger declarations. use map coordinates\n";
+    out << "# trigger=left,top,width,height,layerIndex,shape,triggerId\n";
+    out << "# shape is rectangle or circle. a circle fills the middle of its rectangle\n";
+    for (int layerIndex=0; layerIndex<m_layers.size(); ++layerIndex) {
+        QList<MapTrigger> triggers = m_layers.at(layerIndex)->triggers;
+        for (int i=0; i<triggers.size(); ++i) {
+            MapTrigger trigger = triggers.at(i);
+            QRect geometry = trigger.geometry;
+            out << "trigger=" << geometry.left() << "," << geometry.top() << "," << geometry.width() << ","
+                << geometry.height() << "," << layerIndex << ","
+                << (trigger.shape == Map::tgCircle ? "circle" : "rectangle") << "," << trigger.id << "\n";
+        }
+    }
 }
 
 void EditorMap::addObject(MapObject * object)
@@ -194,6 +253,29 @@ void EditorMap::removeEntity(EditorEntity * entity)
     m_layers.at(entity->layer())->entities.removeOne(entity);
 }
 
+void EditorMap::addTrigger(int layerIndex, const MapTrigger & trigger)
+{
+    while (layerIndex >= layerCount())
+        addLayer();
+    m_layers.at(layerIndex)->triggers.append(trigger);
+}
+
+void EditorMap::removeTrigger(int layerIndex, int index)
+{
+    m_layers.at(layerIndex)->triggers.removeAt(index);
+}
+
+void EditorMap::addSubmap(const MapSubmap & submap)
+{
+    m_submaps.append(submap);
+}
+
+void EditorMap::removeSubmap(int index)
+{
+    delete m_submaps.at(index).map;
+    m_submaps.removeAt(index);
+}
+
 void EditorMap::setLeft(int value)
 {
     this->m_left = value;
@@ -381,6 +463,16 @@ bool EditorMap::build(ResourceFile & resources)
 
     mapData.append("M");
 
+    if (! compile(resources, mapData))
+        return false;
+
+    resources.updateResource(m_name.toStdString(), mapData.constData(), mapData.size());
+
+    return true;
+}
+
+bool EditorMap::compile(ResourceFile & resources, QByteArray & mapData)
+{
     // version
     mapData.append((char *) &c_codeVersion, 4);
 
@@ -480,11 +572,69 @@ bool EditorMap::build(ResourceFile & resources)
         }
     }
 
-    int submapCount = 0;
+    // submaps
+    int submapCount = m_submaps.size();
     mapData.append((char *) &submapCount, 4);
+    for (int i=0; i<submapCount; ++i) {
+        MapSubmap submap = m_submaps.at(i);
+        int x = submap.position.x();
+        int y = submap.position.y();
+
+        // the game only knows a map by its own tiles, so anything sticking
+        // out past them would never be found
+        if (x < 0 || y < 0 || x + submap.map->width() > width() || y + submap.map->height() > height()) {
+            qDebug() << "Unable to build map: Submap " << submap.map->name() << " sticks out of " << name();
+            return false;
+        }
+
+        mapData.append((char *) &x, 4);
+        mapData.append((char *) &y, 4);
 
+        int submapIdSize = submap.id.size();
+        mapData.append((char *) &submapIdSize, 4);
+        mapData.append(submap.id);
+
+        QByteArray submapData;
+        bool ok = submap.map->compile(resources, submapData);
+
+        assert(ok);
+        if (! ok) {
+            qDebug() << "Unable to build map: Error building submap " << submap.map->name();
+            return false;
+        }
+
+        int submapDataSize = submapData.size();
+        mapData.append((char *) &submapDataSize, 4);
+        mapData.append(submapData);
+    }
+
+    // triggers
     int triggerCount = 0;
+    for (int z=0; z<layerCount; ++z)
+        triggerCount += m_layers.at(z)->triggers.size();
     mapData.append((char *) &triggerCount, 4);
+    for (int z=0; z<layerCount; ++z) {
+        QList<MapTrigger> triggers = m_layers.at(z)->triggers;
+        for (int i=0; i<triggers.size(); ++i) {
+            MapTrigger trigger = triggers.at(i);
+            int shape = trigger.shape;
+            int left = trigger.geometry.left();
+            int top = trigger.geometry.top();
+            int width = trigger.geometry.width();
+            int height = trigger.geometry.height();
+
+            mapData.append((char *) &shape, 4);
+            mapData.append((char *) &z, 4);
+            mapData.append((char *) &left, 4);
+            mapData.append((char *) &top, 4);
+            mapData.append((char *) &width, 4);
+            mapData.append((char *) &height, 4);
+
+            int triggerIdSize = trigger.id.size();
+            mapData.append((char *) &triggerIdSize, 4);
+            mapData.append(trigger.id);
+        }
+    }
 
     // entities
     int entityCount = 0;
@@ -511,7 +661,5 @@ bool EditorMap::build(ResourceFile & resources)
         }
     }
 
-    resources.updateResource(m_name.toStdString(), mapData.constData(), mapData.size());
-
     return true;
 }
@@ -3,6 +3,7 @@
 
 #include "EditorObject.h"
 #include "ResourceFile.h"
+#include "Map.h"
 
 #include <QString>
 #include <QList>
@@ -39,6 +40,36 @@ public: //variables
         }
     };
 
+    // a region that notices entities coming and going. see Map::Trigger
+    struct MapTrigger {
+        QString id;
+        Map::TriggerShape shape;
+        // in map coordinates
+        QRect geometry;
+
+        MapTrigger() :
+            id(),
+            shape(Map::tgRectangle),
+            geometry()
+        {
+        }
+    };
+
+    // another map, drawn and collided with as part of this one. see Map
+    struct MapSubmap {
+        QString id;
+        EditorMap * map;
+        // top left, in map coordinates
+        QPoint position;
+
+        MapSubmap() :
+            id(),
+            map(NULL),
+            position()
+        {
+        }
+    };
+
     struct MapLayer {
         // layer name
         QString name;
@@ -49,6 +80,8 @@ public: //variables
         QList<MapObject *> objects;
         // list of entities per layer
         QList<EditorEntity *> entities;
+        // list of triggers per layer
+        QList<MapTrigger> triggers;
     };
 
 public: //methods
@@ -102,6 +135,15 @@ public: //methods
     void addEntity(EditorEntity * entity);
     void removeEntity(EditorEntity * entity);
 
+    void addTrigger(int layerIndex, const MapTrigger & trigger);
+    void removeTrigger(int layerIndex, int index);
+
+    // the map takes ownership of submap.map
+    void addSubmap(const MapSubmap & submap);
+    void removeSubmap(int index);
+    inline int submapCount();
+    inline const MapSubmap & submap(int index) const;
+
     inline QString name() const;
 
     // set the parent world of the map
@@ -127,6 +169,7 @@ private: //variables
     int m_tileCountY;
 
     QList<MapLayer *> m_layers;
+    QList<MapSubmap> m_submaps;
 
     QString m_name;
 
@@ -137,6 +180,10 @@ private: //variables
     int m_story;
 private: //methods
     EditorMap();
+
+    // append the compiled map, without the resource type code. submaps go
+    // in whole. returns success
+    bool compile(ResourceFile & resources, QByteArray & mapData);
 };
 
 inline int EditorMap::tileCountX()
@@ -159,6 +206,16 @@ inline const EditorMap::MapLayer * EditorMap::layer(int index) const
     return m_layers.at(index);
 }
 
+inline int EditorMap::submapCount()
+{
+    return m_submaps.size();
+}
+
+inline const EditorMap::MapSubmap & EditorMap::submap(int index) const
+{
+    return m_submaps.at(index);
+}
+
 inline QString EditorMap::name() const
 {
     return m_name;
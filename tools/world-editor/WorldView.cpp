@@ -154,7 +154,7 @@ void WorldView::paintEvent(QPaintEvent * e)
                     for (int objectIndex=0; objectIndex<layer->objects.size(); ++objectIndex) {
                         // object is any EditorObject whose layers overlap layerIndex. How convenient!
                         EditorMap::MapObject * object = layer->objects.at(objectIndex);
-                        drawObject(p, object, layerIndex, map);
+                        drawObject(p, object, layerIndex, map->left(), map->top());
                     }
 
                     // Object being dragged from the objects list
@@ -162,7 +162,7 @@ void WorldView::paintEvent(QPaintEvent * e)
                         if (layerIndex >= m_dragObject->layer &&
                             layerIndex < m_dragObject->layer + m_dragObject->object->layerCount())
                         {
-                            drawObject(p, m_dragObject, layerIndex, m_selectedMap);
+                            drawObject(p, m_dragObject, layerIndex, m_selectedMap->left(), m_selectedMap->top());
                         }
                     }
 
@@ -176,6 +176,8 @@ void WorldView::paintEvent(QPaintEvent * e)
                             *entity->graphic()->toPixmap());
                     }
                 }
+
+                drawSubmaps(p, map, layerIndex, map->left(), map->top());
             }
         }
 
@@ -266,20 +268,41 @@ void WorldView::drawStartBox(QPainter &p, EditorUniverse *universe, QPixmap *pix
     p.drawPixmap(drawX, drawY, arbitraryWidth, arbitraryHeight, *pixmap);
 }
 
-void WorldView::drawObject(QPainter &p, EditorMap::MapObject * object, int layerIndex, EditorMap * map)
+void WorldView::drawObject(QPainter &p, EditorMap::MapObject * object, int layerIndex, int left, int top)
 {
     // paint all the graphics which are at the layer we want
     QList<EditorObject::ObjectGraphic *> * graphics = object->object->graphics()->at(layerIndex);
     for (int i=0; i<graphics->size(); ++i) {
         EditorObject::ObjectGraphic * graphic = graphics->at(i);
         p.drawPixmap(
-            screenX(map->left() + object->tileX * Tile::size + graphic->x),
-            screenY(map->top() + object->tileY * Tile::size + graphic->y),
+            screenX(left + object->tileX * Tile::size + graphic->x),
+            screenY(top + object->tileY * Tile::size + graphic->y),
             graphic->width * m_zoom, graphic->height * m_zoom,
             *graphic->graphic->toPixmap());
     }
 }
 
+void WorldView::drawSubmaps(QPainter &p, EditorMap * map, int layerIndex, int left, int top)
+{
+    for (int submapIndex=0; submapIndex<map->submapCount(); ++submapIndex) {
+        const EditorMap::MapSubmap & submap = map->submap(submapIndex);
+        int submapLeft = left + submap.position.x();
+        int submapTop = top + submap.position.y();
+
+        // skip the ones off screen
+        QRect bounds(submapLeft, submapTop, submap.map->width(), submap.map->height());
+        if (submap.map->submapCount() == 0 && ! screenRect(bounds).intersects(rect()))
+            continue;
+
+        if (layerIndex < submap.map->layerCount()) {
+            const EditorMap::MapLayer * layer = submap.map->layer(layerIndex);
+            for (int objectIndex=0; objectIndex<layer->objects.size(); ++objectIndex)
+                drawObject(p, layer->objects.at(objectIndex), layerIndex, submapLeft, submapTop);
+        }
+        drawSubmaps(p, submap.map, layerIndex, submapLeft, submapTop);
+    }
+}
+
 void WorldView::drawGrid(QPainter &p)
 {
     EditorSettings::GridRenderType gridType = EditorSettings::gridRenderType();
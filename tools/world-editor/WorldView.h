@@ -361,7 +361,10 @@ private: //methods
     void setControlEnableStates();
     void determineCursor();
 
-    void drawObject(QPainter &p, EditorMap::MapObject * object, int layerIndex, EditorMap * owner);
+    // left and top are where the map that owns the object is
+    void drawObject(QPainter &p, EditorMap::MapObject * object, int layerIndex, int left, int top);
+    // draw one layer of the submaps of a map at left, top, and theirs
+    void drawSubmaps(QPainter &p, EditorMap * map, int layerIndex, int left, int top);
 
     void selectMap(EditorMap * map);
     void selectOnly(SelectableItem item);